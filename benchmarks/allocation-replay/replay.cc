@@ -0,0 +1,119 @@
+// Copyright CHERIoT Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "../timing.h"
+#include <algorithm>
+#include <compartment.h>
+#include <debug.hh>
+#include <stdio.h>
+#include <stdlib.h>
+
+using Debug = ConditionalDebug<DEBUG_REPLAY, "Allocation replay benchmark">;
+
+namespace
+{
+	/// The kind of a replayed operation.
+	enum ReplayKind : uint8_t
+	{
+		ReplayAllocate,
+		ReplayFree,
+	};
+
+	/**
+	 * An operation from a trace, generated by
+	 * `scripts/heap_trace_to_replay.py` from the output of `heap_trace_dump`.
+	 */
+	struct ReplayOperation
+	{
+		/// Whether this is an allocation or a free.
+		ReplayKind kind;
+		/// The slot in `objects` that holds the allocation.
+		uint16_t slot;
+		/// The requested size of an allocation, the body size of a free.
+		uint32_t size;
+		/// The number of cycles that the operation took when recorded.
+		uint32_t recordedCycles;
+	};
+
+#include REPLAY_TRACE
+
+	/// The live objects, indexed by the slot numbers in the trace.
+	void *objects[REPLAY_SLOTS];
+} // namespace
+
+/**
+ * Replay the trace with the allocator in this firmware image and report the
+ * number of cycles taken by allocations and frees, alongside the number that
+ * they took when the trace was recorded.  The fragmentation of the heap at
+ * the end of the trace (before any leaked objects are freed) is reported
+ * using `heap_statistics`.
+ */
+int __cheri_compartment("replay") run()
+{
+	// Make sure sail doesn't print annoying log messages in the middle of the
+	// output the first time that allocation happens.
+	free(malloc(16));
+	Debug::Invariant(heap_quarantine_empty() == 0,
+	                 "Call to heap_quarantine_empty failed");
+
+	uint64_t allocateCycles = 0;
+	uint64_t freeCycles     = 0;
+	uint64_t recordedAlloc  = 0;
+	uint64_t recordedFree   = 0;
+	int      allocations    = 0;
+	int      frees          = 0;
+	int      failures       = 0;
+	Timeout  t{UnlimitedTimeout};
+	for (const ReplayOperation &operation : ReplayTrace)
+	{
+		void *&object = objects[operation.slot];
+		if (operation.kind == ReplayAllocate)
+		{
+			auto start = rdcycle();
+			object     = heap_allocate(&t, MALLOC_CAPABILITY, operation.size);
+			allocateCycles += rdcycle() - start;
+			recordedAlloc += operation.recordedCycles;
+			allocations++;
+			if (!__builtin_cheri_tag_get(object))
+			{
+				Debug::log("Allocation of {} bytes failed", operation.size);
+				object = nullptr;
+				failures++;
+			}
+		}
+		else if (object != nullptr)
+		{
+			auto start = rdcycle();
+			heap_free(MALLOC_CAPABILITY, object);
+			freeCycles += rdcycle() - start;
+			recordedFree += operation.recordedCycles;
+			frees++;
+			object = nullptr;
+		}
+	}
+
+	HeapStatistics statistics;
+	heap_statistics(&statistics);
+	for (void *&object : objects)
+	{
+		if (object != nullptr)
+		{
+			heap_free(MALLOC_CAPABILITY, object);
+			object = nullptr;
+		}
+	}
+
+	int operations = sizeof(ReplayTrace) / sizeof(ReplayTrace[0]);
+	printf("#board\toperations\tfailures\talloc_avg\talloc_recorded_avg\t"
+	       "free_avg\tfree_recorded_avg\tfree_bytes\tlargest_free\n");
+	printf(__XSTRING(BOARD) "\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n",
+	       operations,
+	       failures,
+	       static_cast<int>(allocateCycles / std::max(allocations, 1)),
+	       static_cast<int>(recordedAlloc / std::max(allocations, 1)),
+	       static_cast<int>(freeCycles / std::max(frees, 1)),
+	       static_cast<int>(recordedFree / std::max(frees, 1)),
+	       static_cast<int>(statistics.freeBytes),
+	       static_cast<int>(statistics.largestFreeChunk));
+	return 0;
+}
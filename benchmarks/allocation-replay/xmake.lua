@@ -0,0 +1,45 @@
+-- Copyright CHERIoT Contributors.
+-- SPDX-License-Identifier: MIT
+
+set_project("CHERIoT allocation trace replay benchmark");
+sdkdir = "../../sdk"
+includes(sdkdir)
+set_toolchains("cheriot-clang")
+
+option("board")
+    set_default("sail")
+
+-- The trace to replay, generated by scripts/heap_trace_to_replay.py from the
+-- output of heap_trace_dump() in a firmware image built with
+-- --allocator-tracing=y.  The default is a small synthetic trace.
+option("trace")
+    set_default("trace.inc")
+    set_showmenu(true)
+    set_description("Path to the trace to replay")
+
+debugOption("replay");
+compartment("replay")
+    add_deps("crt", "freestanding", "atomic", "stdio", "debug")
+    add_rules("cheriot.component-debug")
+    -- Allow allocating an effectively unbounded amount of memory (more than
+    -- exists), traces may come from many compartments.
+    add_defines("MALLOC_QUOTA=1000000")
+    add_defines("BOARD=" .. tostring(get_config("board")))
+    add_defines("REPLAY_TRACE=\"" .. path.absolute(get_config("trace")) .. "\"")
+    add_files("replay.cc")
+
+-- Firmware image for the benchmark.
+firmware("allocation-replay-benchmark")
+    add_deps("replay")
+    on_load(function(target)
+        target:values_set("board", "$(board)")
+        target:values_set("threads", {
+            {
+                compartment = "replay",
+                priority = 1,
+                entry_point = "run",
+                stack_size = 0x400,
+                trusted_stack_frames = 4
+            },
+        }, {expand = false})
+    end)
@@ -5,6 +5,11 @@
 
 using Debug = ConditionalDebug<DEBUG_ALLOCBENCH, "Allocator benchmark">;
 
+DEFINE_ALLOCATOR_CAPABILITY_WITH_FLAGS(
+  __default_malloc_capability,
+  MALLOC_QUOTA,
+  SIZE_CLASS_CACHE ? AllocatorCapabilitySizeClassCache : 0)
+
 void run(size_t allocSize, size_t allocations, size_t inHeap)
 {
 	auto start = rdcycle();
@@ -22,11 +27,12 @@ void run(size_t allocSize, size_t allocations, size_t inHeap)
 
 	asm volatile("" : : : "memory");
 
-	printf(__XSTRING(BOARD) "\t%ld\t%ld\t%ld\t%ld\n",
+	printf(__XSTRING(BOARD) "\t%ld\t%ld\t%ld\t%ld\t%d\n",
 	       static_cast<int>(allocSize),
 	       allocations,
 	       inHeap,
-	       end - start);
+	       end - start,
+	       SIZE_CLASS_CACHE);
 
 	auto quota = heap_quota_remaining(MALLOC_CAPABILITY);
 	Debug::Invariant(quota == MALLOC_QUOTA,
@@ -62,7 +68,7 @@ int __cheri_compartment("allocbench") run()
 	Debug::Invariant(heap_quarantine_empty() == 0,
 	                 "Call to heap_quarantine_empty failed");
 
-	printf("#board\tsize\tnalloc\tinheap\ttime\n");
+	printf("#board\tsize\tnalloc\tinheap\ttime\tcache\n");
 
 	const size_t MinimumSize = 32;
 
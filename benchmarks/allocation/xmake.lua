@@ -9,12 +9,20 @@ set_toolchains("cheriot-clang")
 option("board")
     set_default("sail")
 
+-- Opt the benchmark's allocator capability into a size-class cache.
+option("size-class-cache")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Use an allocator capability with a size-class cache")
+
 debugOption("allocbench");
 compartment("allocbench")
     add_deps("crt", "freestanding", "atomic", "stdio", "debug")
     -- Allow allocating an effectively unbounded amount of memory (more than exists)
     add_rules("cheriot.component-debug")
     add_defines("MALLOC_QUOTA=1000000")
+    add_defines("CHERIOT_CUSTOM_DEFAULT_MALLOC_CAPABILITY")
+    add_defines("SIZE_CLASS_CACHE=" .. tostring(get_config("size-class-cache")))
     add_defines("BOARD=" .. tostring(get_config("board")))
     add_files("alloc.cc")
 
@@ -0,0 +1,115 @@
+// Copyright CHERIoT Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "../timing.h"
+#include <atomic>
+#include <compartment.h>
+#include <debug.hh>
+#include <futex.h>
+#include <simulator.h>
+#include <stdio.h>
+#include <thread.h>
+
+using Debug = ConditionalDebug<DEBUG_FUTEX_BENCH, "Futex wake benchmark">;
+
+namespace
+{
+	/// The number of wakes to average over for each row of output.
+	constexpr int Iterations = 32;
+
+	/// One futex word per bystander thread.
+	std::atomic<uint32_t> bystanderWords[BYSTANDERS];
+	/// Index of the next bystander word to hand out.
+	std::atomic<int> nextBystander;
+	/// The number of bystanders that are still blocked.
+	std::atomic<int> blockedBystanders;
+
+	/// The futex word that the waiter thread blocks on.
+	std::atomic<uint32_t> target;
+	/// A futex word that no thread ever waits on.
+	uint32_t idle;
+
+	/// Cycle counter value immediately before waking the waiter.
+	int start;
+	/// Cycle counter value when the waiter thread resumed.
+	int end;
+} // namespace
+
+/**
+ * Bystander threads have the highest priority and so run first.  Each blocks
+ * on its own futex word, which is unrelated to the one that the measurement
+ * thread wakes.  They are released, one at a time, by the measurement thread
+ * and then exit, reducing the number of unrelated waiters.
+ */
+int __cheri_compartment("futex_bench") entry_bystander()
+{
+	int index = nextBystander++;
+	Debug::Invariant(index < BYSTANDERS, "Too many bystander threads");
+	blockedBystanders++;
+	bystanderWords[index].wait(0);
+	blockedBystanders--;
+	return 0;
+}
+
+/**
+ * The waiter thread blocks on `target` and records the time at which it was
+ * woken.  It is higher priority than the measurement thread and so runs
+ * immediately after the `futex_wake` call.
+ */
+int __cheri_compartment("futex_bench") entry_waiter()
+{
+	uint32_t last = target;
+	while (true)
+	{
+		target.wait(last);
+		end  = rdcycle();
+		last = target;
+	}
+	return 0;
+}
+
+/**
+ * The measurement thread runs at the lowest priority, so by the time that it
+ * starts every other thread is blocked on a futex.  For each number of
+ * unrelated waiters, it reports the latency from `futex_wake` to the waiter
+ * running and the cost of a `futex_wake` on a word with no waiters.  Both
+ * should remain flat as the number of unrelated waiters changes.
+ */
+int __cheri_compartment("futex_bench") entry_measure()
+{
+	printf("#board\tthreads\tbystanders\twake\tnowaiter\n");
+	for (int waiters = blockedBystanders; waiters >= 0; waiters--)
+	{
+		Debug::Invariant(waiters == blockedBystanders,
+		                 "Expected {} blocked bystanders, found {}",
+		                 waiters,
+		                 blockedBystanders.load());
+		int wakeTotal     = 0;
+		int noWaiterTotal = 0;
+		for (int i = 0; i < Iterations; i++)
+		{
+			start = rdcycle();
+			target++;
+			target.notify_one();
+			wakeTotal += end - start;
+
+			int noWaiterStart = rdcycle();
+			futex_wake(&idle, 1);
+			noWaiterTotal += rdcycle() - noWaiterStart;
+		}
+		printf(__XSTRING(BOARD) "\t%d\t%d\t%d\t%d\n",
+		       static_cast<int>(thread_count()),
+		       waiters,
+		       wakeTotal / Iterations,
+		       noWaiterTotal / Iterations);
+		// Release one bystander.  It is higher priority and so will run and
+		// exit before we return here.
+		if (waiters > 0)
+		{
+			bystanderWords[waiters - 1] = 1;
+			bystanderWords[waiters - 1].notify_one();
+		}
+	}
+	simulation_exit(0);
+	return 0;
+}
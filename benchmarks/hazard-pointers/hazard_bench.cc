@@ -0,0 +1,110 @@
+// Copyright CHERIoT Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "../timing.h"
+#include <algorithm>
+#include <atomic>
+#include <compartment.h>
+#include <debug.hh>
+#include <limits>
+#include <simulator.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread.h>
+
+using Debug = ConditionalDebug<DEBUG_HAZARD_BENCH, "Hazard pointer benchmark">;
+
+namespace
+{
+	/// The number of frees to measure for each row of output.
+	constexpr int Iterations = 64;
+
+	/// The size of the objects that are allocated and freed.
+	constexpr size_t ObjectSize = 32;
+
+	/// The objects that the claimer threads hold ephemeral claims on.
+	void *claimed[CLAIMERS * 2];
+	/// Index of the next claimer.
+	std::atomic<int> nextClaimer;
+	/// The number of claimers that hold their claims.
+	std::atomic<int> readyClaimers;
+	/// Set when the measurement is finished.
+	std::atomic<bool> finished;
+
+	/**
+	 * Allocate and free `Iterations` objects, none of which are claimed, and
+	 * report the average and minimum number of cycles taken by `heap_free`.
+	 * The claimer threads run at the same priority as the measurement thread
+	 * and so some iterations will include a context switch; the minimum
+	 * excludes these.
+	 */
+	void measure(int quarantined)
+	{
+		Timeout t{UnlimitedTimeout};
+		int     total   = 0;
+		int     minimum = std::numeric_limits<int>::max();
+		for (int i = 0; i < Iterations; i++)
+		{
+			void *object = heap_allocate(&t, MALLOC_CAPABILITY, ObjectSize);
+			Debug::Invariant(__builtin_cheri_tag_get(object),
+			                 "Failed to allocate object");
+			int start = rdcycle();
+			heap_free(MALLOC_CAPABILITY, object);
+			int elapsed = rdcycle() - start;
+			total += elapsed;
+			minimum = std::min(minimum, elapsed);
+		}
+		printf(__XSTRING(BOARD) "\t%d\t%d\t%d\t%d\n",
+		       CLAIMERS,
+		       quarantined,
+		       total / Iterations,
+		       minimum);
+	}
+} // namespace
+
+/**
+ * Each claimer thread allocates two objects, holds ephemeral claims on them,
+ * and then spins.  Ephemeral claims are dropped on the next cross-compartment
+ * call, so the claimers must not call anything until the benchmark finishes.
+ */
+int __cheri_compartment("hazard_bench") entry_claimer()
+{
+	int index = nextClaimer++;
+	Debug::Invariant(index < CLAIMERS, "Too many claimer threads");
+	Timeout t{UnlimitedTimeout};
+	void   *first  = heap_allocate(&t, MALLOC_CAPABILITY, ObjectSize);
+	void   *second = heap_allocate(&t, MALLOC_CAPABILITY, ObjectSize);
+	int     ret    = heap_claim_ephemeral(&t, first, second);
+	Debug::Invariant(ret == 0, "Failed to claim objects: {}", ret);
+	claimed[index * 2]     = first;
+	claimed[index * 2 + 1] = second;
+	readyClaimers++;
+	while (!finished) {}
+	return 0;
+}
+
+/**
+ * The measurement thread waits for every claimer to hold its claims and then
+ * reports the cost of `heap_free` with every hazard slot in use, first with
+ * an empty hazard quarantine and then after freeing every claimed object, so
+ * that each free must also recheck all of the objects in the hazard
+ * quarantine.
+ */
+int __cheri_compartment("hazard_bench") entry_measure()
+{
+	while (readyClaimers < CLAIMERS)
+	{
+		Timeout t{1};
+		thread_sleep(&t);
+	}
+	printf("#board\tclaimers\tquarantined\tfree_avg\tfree_min\n");
+	measure(0);
+	for (void *object : claimed)
+	{
+		heap_free(MALLOC_CAPABILITY, object);
+	}
+	measure(CLAIMERS * 2);
+	finished = true;
+	simulation_exit(0);
+	return 0;
+}
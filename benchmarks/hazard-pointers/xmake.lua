@@ -0,0 +1,58 @@
+-- Copyright CHERIoT Contributors.
+-- SPDX-License-Identifier: MIT
+
+set_project("CHERIoT hazard-pointer benchmark");
+sdkdir = "../../sdk"
+includes(sdkdir)
+set_toolchains("cheriot-clang")
+
+-- Support libraries
+includes(path.join(sdkdir, "lib/freestanding"),
+         path.join(sdkdir, "lib/atomic"),
+         path.join(sdkdir, "lib/crt"),
+         path.join(sdkdir, "lib/compartment_helpers"))
+
+option("board")
+    set_default("sail")
+
+-- The number of threads that hold ephemeral claims.  The firmware has one
+-- more thread than this.
+option("claimers")
+    set_default("16")
+    set_showmenu(true)
+    set_description("Number of threads holding ephemeral claims")
+
+debugOption("hazard_bench");
+compartment("hazard_bench")
+    add_deps("crt", "freestanding", "atomic", "stdio", "debug",
+             "compartment_helpers")
+    add_rules("cheriot.component-debug")
+    add_defines("BOARD=" .. tostring(get_config("board")))
+    add_defines("CLAIMERS=" .. tostring(get_config("claimers")))
+    add_files("hazard_bench.cc")
+
+-- Firmware image for the benchmark.
+firmware("hazard-pointer-benchmark")
+    add_deps("hazard_bench")
+    on_load(function(target)
+        target:values_set("board", "$(board)")
+        local threads = {
+            {
+                compartment = "hazard_bench",
+                priority = 1,
+                entry_point = "entry_measure",
+                stack_size = 0x400,
+                trusted_stack_frames = 4
+            },
+        }
+        for i = 1, tonumber(get_config("claimers")) do
+            table.insert(threads, {
+                compartment = "hazard_bench",
+                priority = 1,
+                entry_point = "entry_claimer",
+                stack_size = 0x200,
+                trusted_stack_frames = 4
+            })
+        end
+        target:values_set("threads", threads, {expand = false})
+    end)
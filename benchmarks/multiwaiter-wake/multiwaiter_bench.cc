@@ -0,0 +1,186 @@
+// Copyright CHERIoT Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "../timing.h"
+#include <atomic>
+#include <compartment.h>
+#include <debug.hh>
+#include <futex.h>
+#include <limits>
+#include <multiwaiter.h>
+#include <simulator.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using Debug =
+  ConditionalDebug<DEBUG_MULTIWAITER_BENCH, "Multiwaiter wake benchmark">;
+
+static_assert(WAITERS <= 32, "Wake order is tracked in a 32-bit mask");
+
+namespace
+{
+	/// The number of wakes to average over for each row of output.
+	constexpr int Iterations = 32;
+
+	/// The number of buckets in the scheduler's multiwaiter index.
+	constexpr size_t IndexBuckets = 16;
+
+	/**
+	 * Returns the multiwaiter index bucket for a futex word.  This mirrors
+	 * `futex_address_hash` in the scheduler, so that the benchmark can choose
+	 * futex words that collide.
+	 */
+	size_t bucket_for(const uint32_t *word)
+	{
+		ptraddr_t key = __builtin_cheri_address_get(word);
+		return ((key >> 2) ^ (key >> 6) ^ (key >> 10)) & (IndexBuckets - 1);
+	}
+
+	/// The futex word that every waiter waits on, in addition to its own.
+	uint32_t shared;
+
+	/**
+	 * Candidate futex words.  Every aligned run of `IndexBuckets` words
+	 * contains exactly one word in each bucket, so this contains at least
+	 * `WAITERS + 1` words in the same bucket as `shared`.
+	 */
+	alignas(IndexBuckets * sizeof(uint32_t)) uint32_t
+	  candidates[(WAITERS + 2) * IndexBuckets];
+
+	/**
+	 * Returns the `n`th word in `candidates` that is in the same index bucket
+	 * as `shared`.
+	 */
+	uint32_t *colliding_word(int n)
+	{
+		for (uint32_t &word : candidates)
+		{
+			if ((bucket_for(&word) == bucket_for(&shared)) && (n-- == 0))
+			{
+				return &word;
+			}
+		}
+		Debug::Invariant(false, "Not enough colliding futex words");
+		return nullptr;
+	}
+
+	/// Each waiter's own futex word, all in the same bucket as `shared`.
+	uint32_t *ownWords[WAITERS];
+	/// Index of the next waiter.
+	std::atomic<int> nextWaiter;
+
+	/// The index of the waiter that most recently woke.
+	int lastWoken = -1;
+	/// Cycle counter value immediately before a wake.
+	int start;
+	/// Cycle counter value when the last waiter resumed.
+	int end;
+} // namespace
+
+/**
+ * Waiter threads are higher priority than the measurement thread and so run
+ * first.  Each blocks on a multiwaiter that watches both `shared` and its own
+ * futex word, all of which are in the same bucket of the scheduler's
+ * multiwaiter index.  When woken, each records the time and its index and
+ * then waits again.
+ */
+int __cheri_compartment("multiwaiter_bench") entry_waiter()
+{
+	int index = nextWaiter++;
+	Debug::Invariant(index < WAITERS, "Too many waiter threads");
+	// Word 0 is left for the measurement of wakes with no waiter.
+	ownWords[index] = colliding_word(index + 1);
+	MultiWaiter mw;
+	Timeout     t{UnlimitedTimeout};
+	int         ret = multiwaiter_create(&t, MALLOC_CAPABILITY, &mw, 2);
+	Debug::Invariant(ret == 0, "Failed to create multiwaiter: {}", ret);
+	while (true)
+	{
+		EventWaiterSource events[] = {{&shared, 0}, {ownWords[index], 0}};
+		Timeout           forever{UnlimitedTimeout};
+		ret = multiwaiter_wait(&forever, mw, events, 2);
+		end = rdcycle();
+		Debug::Invariant(ret == 0, "Multiwaiter wait failed: {}", ret);
+		lastWoken = index;
+	}
+	return 0;
+}
+
+/**
+ * The measurement thread runs at the lowest priority, so by the time that it
+ * starts every waiter is blocked with two entries in the same bucket of the
+ * multiwaiter index.  It reports:
+ *
+ *  - `nowaiter`: the cost of waking a word in that bucket with no waiters.
+ *  - `own`: the latency from waking one waiter's own word to it running.
+ *  - `shared_one`: the latency from waking one waiter on `shared` to it
+ *    running.  Waiters have equal priority and so must be woken in FIFO
+ *    order, which is checked.
+ *  - `shared_all`: the time taken to wake every waiter on `shared` and for
+ *    all of them to run.
+ */
+int __cheri_compartment("multiwaiter_bench") entry_measure()
+{
+	printf("#board\twaiters\ttest\tcycles\n");
+	auto report = [](const char *test, int cycles) {
+		printf(__XSTRING(BOARD) "\t%d\t%s\t%d\n", WAITERS, test, cycles);
+	};
+
+	uint32_t *idle  = colliding_word(0);
+	int       total = 0;
+	for (int i = 0; i < Iterations; i++)
+	{
+		int noWaiterStart = rdcycle();
+		int woken         = futex_wake(idle, 1);
+		total += rdcycle() - noWaiterStart;
+		Debug::Invariant(woken == 0, "Wake with no waiters woke {}", woken);
+	}
+	report("nowaiter", total / Iterations);
+
+	total = 0;
+	for (int i = 0; i < Iterations; i++)
+	{
+		int target = i % WAITERS;
+		start      = rdcycle();
+		futex_wake(ownWords[target], 1);
+		total += end - start;
+		Debug::Invariant(lastWoken == target,
+		                 "Waking waiter {} woke waiter {}",
+		                 target,
+		                 lastWoken);
+	}
+	report("own", total / Iterations);
+
+	constexpr int      SharedWakes = WAITERS * 2;
+	constexpr uint32_t AllWaiters =
+	  (WAITERS == 32) ? ~0U : ((1U << WAITERS) - 1);
+	uint32_t seen = 0;
+	total         = 0;
+	for (int i = 0; i < SharedWakes; i++)
+	{
+		start     = rdcycle();
+		int woken = futex_wake(&shared, 1);
+		total += end - start;
+		Debug::Invariant(woken == 1, "Waking one waiter woke {}", woken);
+		seen |= 1U << lastWoken;
+		// Each waiter waits again at the back of the queue after it is woken,
+		// so every run of `WAITERS` wakes must wake each waiter once.
+		if (((i + 1) % WAITERS) == 0)
+		{
+			Debug::Invariant(seen == AllWaiters,
+			                 "Equal-priority waiters woken out of order: {}",
+			                 seen);
+			seen = 0;
+		}
+	}
+	report("shared_one", total / SharedWakes);
+
+	start     = rdcycle();
+	int woken = futex_wake(&shared, std::numeric_limits<uint32_t>::max());
+	report("shared_all", rdcycle() - start);
+	Debug::Invariant(
+	  woken == WAITERS, "Waking all waiters woke {} of {}", woken, WAITERS);
+
+	simulation_exit(0);
+	return 0;
+}
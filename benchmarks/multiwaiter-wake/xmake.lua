@@ -0,0 +1,56 @@
+-- Copyright CHERIoT Contributors.
+-- SPDX-License-Identifier: MIT
+
+set_project("CHERIoT multiwaiter wake benchmark");
+sdkdir = "../../sdk"
+includes(sdkdir)
+set_toolchains("cheriot-clang")
+
+-- Support libraries
+includes(path.join(sdkdir, "lib/freestanding"),
+         path.join(sdkdir, "lib/atomic"),
+         path.join(sdkdir, "lib/crt"))
+
+option("board")
+    set_default("sail")
+
+-- The number of threads blocked on multiwaiters.  The firmware has one more
+-- thread than this.
+option("waiters")
+    set_default("16")
+    set_showmenu(true)
+    set_description("Number of threads blocked on multiwaiters")
+
+debugOption("multiwaiter_bench");
+compartment("multiwaiter_bench")
+    add_deps("crt", "freestanding", "atomic", "stdio", "debug")
+    add_rules("cheriot.component-debug")
+    add_defines("BOARD=" .. tostring(get_config("board")))
+    add_defines("WAITERS=" .. tostring(get_config("waiters")))
+    add_files("multiwaiter_bench.cc")
+
+-- Firmware image for the benchmark.
+firmware("multiwaiter-wake-benchmark")
+    add_deps("multiwaiter_bench")
+    on_load(function(target)
+        target:values_set("board", "$(board)")
+        local threads = {
+            {
+                compartment = "multiwaiter_bench",
+                priority = 1,
+                entry_point = "entry_measure",
+                stack_size = 0x400,
+                trusted_stack_frames = 4
+            },
+        }
+        for i = 1, tonumber(get_config("waiters")) do
+            table.insert(threads, {
+                compartment = "multiwaiter_bench",
+                priority = 2,
+                entry_point = "entry_waiter",
+                stack_size = 0x300,
+                trusted_stack_frames = 4
+            })
+        end
+        target:values_set("threads", threads, {expand = false})
+    end)
@@ -0,0 +1,246 @@
+// Copyright CHERIoT Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "../timing.h"
+#include <algorithm>
+#include <compartment.h>
+#include <debug.hh>
+#include <stdio.h>
+#include <stdlib.h>
+
+using Debug = ConditionalDebug<DEBUG_REVOCATION_BENCH, "Revocation benchmark">;
+
+namespace
+{
+	/// The name of the revoker in this build, reported in every row.
+	constexpr const char *RevokerName =
+#if defined(TEMPORAL_SAFETY) && defined(SOFTWARE_REVOKER)
+	  "software";
+#elif defined(TEMPORAL_SAFETY)
+	  "hardware";
+#elif defined(CHERIOT_FAKE_REVOKER)
+	  "fake";
+#else
+	  "none";
+#endif
+
+	/// The number of times that each latency measurement is repeated.
+	constexpr int Iterations = 8;
+
+	/**
+	 * The heap is filled in blocks of this fraction of its size, which bounds
+	 * the number of live blocks.
+	 */
+	constexpr size_t HeapBlocks = 64;
+
+	/// The maximum number of objects that are live at once.
+	constexpr size_t MaxObjects = 512;
+
+	/// The live objects.
+	void *objects[MaxObjects];
+
+	/// The number of entries in `objects` that are in use.
+	size_t liveObjects;
+
+	/**
+	 * Allocate up to `count` objects of `size` bytes without blocking.
+	 * Returns the number that were allocated.
+	 */
+	size_t fill(size_t size, size_t count)
+	{
+		Timeout t{0};
+		size_t  allocated = 0;
+		count             = std::min(count, MaxObjects - liveObjects);
+		for (; allocated < count; allocated++)
+		{
+			void *object = heap_allocate(&t, MALLOC_CAPABILITY, size);
+			if (!__builtin_cheri_tag_get(object))
+			{
+				break;
+			}
+			objects[liveObjects++] = object;
+		}
+		return allocated;
+	}
+
+	/**
+	 * Free every live object and wait for the quarantine to drain, so that
+	 * each measurement starts from an empty quarantine.
+	 */
+	void release()
+	{
+		while (liveObjects > 0)
+		{
+			heap_free(MALLOC_CAPABILITY, objects[--liveObjects]);
+		}
+		Debug::Invariant(heap_quarantine_empty() == 0,
+		                 "Call to heap_quarantine_empty failed");
+	}
+
+	/**
+	 * Print a row of output.  `cycles` and `maximum` are the average and
+	 * largest number of cycles for the measured operation, `waits` is the
+	 * number of allocations that blocked waiting for revocation during the
+	 * measurement.  The statistics for the last complete revocation pass are
+	 * reported only with the software revoker and are zero otherwise.
+	 */
+	void report(const char *test,
+	            size_t      occupancy,
+	            size_t      size,
+	            size_t      count,
+	            int         cycles,
+	            int         maximum,
+	            size_t      waits)
+	{
+		HeapStatistics statistics;
+		heap_statistics(&statistics);
+		printf(__XSTRING(BOARD) "\t%s\t%s\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t"
+		                        "%d\t%d\n",
+		       RevokerName,
+		       test,
+		       static_cast<int>(statistics.heapSize),
+		       static_cast<int>(occupancy),
+		       static_cast<int>(size),
+		       static_cast<int>(count),
+		       cycles,
+		       maximum,
+		       static_cast<int>(waits),
+		       static_cast<int>(statistics.revocationPassTicks),
+		       static_cast<int>(statistics.revocationPassScanned),
+		       static_cast<int>(statistics.revocationPassSkipped),
+		       static_cast<int>(statistics.revocationPassCycles));
+	}
+
+	/// Returns the number of allocations that have waited for revocation.
+	size_t revocation_waits()
+	{
+		HeapStatistics statistics;
+		heap_statistics(&statistics);
+		return statistics.revocationWaits;
+	}
+
+	/**
+	 * Measure the time taken for `heap_quarantine_flush` to reclaim a single
+	 * small object, which is dominated by the time taken for revocation
+	 * passes, with `occupancy` percent of the heap holding live objects.
+	 */
+	void measure_flush(size_t heapSize, size_t occupancy)
+	{
+		size_t blockSize = heapSize / HeapBlocks;
+		size_t blocks    = fill(blockSize, HeapBlocks * occupancy / 100);
+		int    total     = 0;
+		int    maximum   = 0;
+		for (int i = 0; i < Iterations; i++)
+		{
+			heap_free(MALLOC_CAPABILITY, malloc(32));
+			int start = rdcycle();
+			Debug::Invariant(heap_quarantine_empty() == 0,
+			                 "Call to heap_quarantine_empty failed");
+			int elapsed = rdcycle() - start;
+			total += elapsed;
+			maximum = std::max(maximum, elapsed);
+		}
+		report("flush",
+		       blocks * 100 / HeapBlocks,
+		       32,
+		       1,
+		       total / Iterations,
+		       maximum,
+		       0);
+		release();
+	}
+
+	/**
+	 * Measure the throughput of `heap_quarantine_flush` when a quarter of the
+	 * heap is in quarantine as objects of `size` bytes.
+	 */
+	void measure_throughput(size_t heapSize, size_t size)
+	{
+		size_t count = fill(size, heapSize / 4 / size);
+		while (liveObjects > 0)
+		{
+			heap_free(MALLOC_CAPABILITY, objects[--liveObjects]);
+		}
+		int start = rdcycle();
+		Debug::Invariant(heap_quarantine_empty() == 0,
+		                 "Call to heap_quarantine_empty failed");
+		int elapsed = rdcycle() - start;
+		report("throughput", 0, size, count, elapsed, elapsed, 0);
+	}
+
+	/**
+	 * Measure the latency from freeing an object to being able to reuse its
+	 * memory when the heap is otherwise full, so the allocation must block in
+	 * the allocator until a revocation pass has finished.
+	 */
+	void measure_reuse(size_t heapSize)
+	{
+		size_t blockSize = heapSize / HeapBlocks;
+		fill(blockSize, HeapBlocks);
+		size_t waits      = revocation_waits();
+		int    total      = 0;
+		int    maximum    = 0;
+		int    iterations = 0;
+		for (; (iterations < Iterations) && (liveObjects > 0); iterations++)
+		{
+			Timeout t{UnlimitedTimeout};
+			void  *&object = objects[liveObjects - 1];
+			int     start  = rdcycle();
+			heap_free(MALLOC_CAPABILITY, object);
+			object      = heap_allocate(&t, MALLOC_CAPABILITY, blockSize);
+			int elapsed = rdcycle() - start;
+			Debug::Invariant(__builtin_cheri_tag_get(object),
+			                 "Failed to reuse freed memory");
+			total += elapsed;
+			maximum = std::max(maximum, elapsed);
+		}
+		report("reuse",
+		       liveObjects * 100 / HeapBlocks,
+		       blockSize,
+		       1,
+		       total / std::max(iterations, 1),
+		       maximum,
+		       revocation_waits() - waits);
+		release();
+	}
+} // namespace
+
+/**
+ * Measure the cost of temporal safety with the revoker in this firmware image:
+ *
+ *  - `flush`: the time to reclaim one freed object, as the fraction of the
+ *    heap that holds live objects increases.
+ *  - `throughput`: the time to reclaim a quarter of the heap freed as objects
+ *    of different sizes.
+ *  - `reuse`: the time from freeing an object to reallocating its memory when
+ *    the heap is full, which stalls the allocation until revocation finishes.
+ *
+ * Every row has the same columns, so that the output of different builds can
+ * be compared directly.
+ */
+int __cheri_compartment("revocation_bench") run()
+{
+	// Make sure sail doesn't print annoying log messages in the middle of the
+	// output the first time that allocation happens.
+	free(malloc(16));
+	Debug::Invariant(heap_quarantine_empty() == 0,
+	                 "Call to heap_quarantine_empty failed");
+
+	HeapStatistics statistics;
+	heap_statistics(&statistics);
+	size_t heapSize = statistics.heapSize;
+
+	printf("#board\trevoker\ttest\theap_size\toccupancy\tsize\tcount\t"
+	       "cycles_avg\tcycles_max\trevocation_waits\tpass_ticks\t"
+	       "pass_scanned\tpass_skipped\tpass_cycles\n");
+	for (size_t occupancy : {0, 25, 50, 75})
+	{
+		measure_flush(heapSize, occupancy);
+	}
+	for (size_t size : {32, 256, 2048})
+	{
+		measure_throughput(heapSize, size);
+	}
+	measure_reuse(heapSize);
+	return 0;
+}
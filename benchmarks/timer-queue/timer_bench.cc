@@ -0,0 +1,125 @@
+// Copyright CHERIoT Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "../timing.h"
+#include <atomic>
+#include <compartment.h>
+#include <debug.hh>
+#include <futex.h>
+#include <simulator.h>
+#include <stdio.h>
+#include <thread.h>
+
+using Debug = ConditionalDebug<DEBUG_TIMER_BENCH, "Timer queue benchmark">;
+
+namespace
+{
+	/// The number of one-tick sleeps to average over for each row of output.
+	constexpr int Iterations = 16;
+
+	/**
+	 * The timeout used by bystanders.  This is much longer than the
+	 * benchmark runs for, so bystanders always expire after the measurement
+	 * thread.  This is the worst case for a sorted-list insert, which walks
+	 * from the tail.
+	 */
+	constexpr Ticks BystanderTimeout = 1000000;
+
+	/// One futex word per bystander thread.
+	uint32_t bystanderWords[BYSTANDERS];
+	/// Index of the next bystander word to hand out.
+	std::atomic<int> nextBystander;
+	/// The number of bystanders that are still blocked.
+	std::atomic<int> blockedBystanders;
+
+	/// Set by the measurement thread before it sleeps.
+	std::atomic<bool> spinnerShouldRecord;
+	/// The first cycle-counter value seen by the spinner after it was asked.
+	std::atomic<int> firstSpin;
+	/// The most recent cycle-counter value seen by the spinner.
+	std::atomic<int> lastSpin;
+} // namespace
+
+/**
+ * Bystander threads have the highest priority and so run first.  Each blocks
+ * on its own futex word with a long (distinct) timeout, so that every
+ * bystander is in the scheduler's timer queue.  They are released, one at a
+ * time, by the measurement thread and then exit.
+ */
+int __cheri_compartment("timer_bench") entry_bystander()
+{
+	int index = nextBystander++;
+	Debug::Invariant(index < BYSTANDERS, "Too many bystander threads");
+	blockedBystanders++;
+	Timeout t{BystanderTimeout + index};
+	futex_timed_wait(&t, &bystanderWords[index], 0, FutexNone);
+	blockedBystanders--;
+	return 0;
+}
+
+/**
+ * The spinner runs at the lowest priority whenever the measurement thread is
+ * asleep, recording the cycle counter.  The first value that it records after
+ * the measurement thread blocks bounds the cost of suspending with a timeout
+ * (including the timer-queue insert).  The last value that it records before
+ * being preempted bounds the start of the timer interrupt that expires the
+ * measurement thread.
+ */
+int __cheri_compartment("timer_bench") entry_spinner()
+{
+	while (true)
+	{
+		int now = rdcycle();
+		if (spinnerShouldRecord.exchange(false))
+		{
+			firstSpin = now;
+		}
+		lastSpin = now;
+	}
+	return 0;
+}
+
+/**
+ * The measurement thread repeatedly sleeps for one tick while a varying number
+ * of bystanders are in the timer queue.  It reports the cost of going to sleep
+ * and the latency from the last instruction that the spinner ran to the
+ * measurement thread resuming, which includes timer expiry.  Both should stay
+ * flat (or grow logarithmically) as the number of sleeping threads grows.
+ */
+int __cheri_compartment("timer_bench") entry_measure()
+{
+	printf("#board\tthreads\tsleepers\tsuspend\texpiry\n");
+	for (int sleepers = blockedBystanders; sleepers >= 0; sleepers--)
+	{
+		Debug::Invariant(sleepers == blockedBystanders,
+		                 "Expected {} blocked bystanders, found {}",
+		                 sleepers,
+		                 blockedBystanders.load());
+		int suspendTotal = 0;
+		int expiryTotal  = 0;
+		for (int i = 0; i < Iterations; i++)
+		{
+			Timeout t{1};
+			spinnerShouldRecord = true;
+			int start           = rdcycle();
+			thread_sleep(&t, ThreadSleepNoEarlyWake);
+			int end = rdcycle();
+			suspendTotal += firstSpin - start;
+			expiryTotal += end - lastSpin;
+		}
+		printf(__XSTRING(BOARD) "\t%d\t%d\t%d\t%d\n",
+		       static_cast<int>(thread_count()),
+		       sleepers,
+		       suspendTotal / Iterations,
+		       expiryTotal / Iterations);
+		// Release one bystander.  It is higher priority and so will run and
+		// exit before we return here.
+		if (sleepers > 0)
+		{
+			bystanderWords[sleepers - 1] = 1;
+			futex_wake(&bystanderWords[sleepers - 1], 1);
+		}
+	}
+	simulation_exit(0);
+	return 0;
+}
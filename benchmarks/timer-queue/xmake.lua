@@ -0,0 +1,63 @@
+-- Copyright CHERIoT Contributors.
+-- SPDX-License-Identifier: MIT
+
+set_project("CHERIoT timer-queue benchmark");
+sdkdir = "../../sdk"
+includes(sdkdir)
+set_toolchains("cheriot-clang")
+
+-- Support libraries
+includes(path.join(sdkdir, "lib/freestanding"),
+         path.join(sdkdir, "lib/atomic"),
+         path.join(sdkdir, "lib/crt"))
+
+option("board")
+    set_default("sail")
+
+-- The number of threads that block with long timeouts.  The firmware has
+-- two more threads than this.
+option("bystanders")
+    set_default("8")
+    set_showmenu(true)
+    set_description("Number of threads blocked with long timeouts")
+
+debugOption("timer_bench");
+compartment("timer_bench")
+    add_deps("crt", "freestanding", "atomic", "stdio", "debug")
+    add_rules("cheriot.component-debug")
+    add_defines("BOARD=" .. tostring(get_config("board")))
+    add_defines("BYSTANDERS=" .. tostring(get_config("bystanders")))
+    add_files("timer_bench.cc")
+
+-- Firmware image for the benchmark.
+firmware("timer-queue-benchmark")
+    add_deps("timer_bench")
+    on_load(function(target)
+        target:values_set("board", "$(board)")
+        local threads = {
+            {
+                compartment = "timer_bench",
+                priority = 1,
+                entry_point = "entry_spinner",
+                stack_size = 0x200,
+                trusted_stack_frames = 4
+            },
+            {
+                compartment = "timer_bench",
+                priority = 2,
+                entry_point = "entry_measure",
+                stack_size = 0x400,
+                trusted_stack_frames = 4
+            },
+        }
+        for i = 1, tonumber(get_config("bystanders")) do
+            table.insert(threads, {
+                compartment = "timer_bench",
+                priority = 3,
+                entry_point = "entry_bystander",
+                stack_size = 0x200,
+                trusted_stack_frames = 4
+            })
+        end
+        target:values_set("threads", threads, {expand = false})
+    end)
@@ -0,0 +1,36 @@
+-- Copyright CHERIoT Contributors.
+-- SPDX-License-Identifier: MIT
+
+set_project("CHERIoT zeroing benchmark");
+sdkdir = "../../sdk"
+includes(sdkdir)
+set_toolchains("cheriot-clang")
+
+-- Support libraries
+includes(path.join(sdkdir, "lib/freestanding"),
+         path.join(sdkdir, "lib/atomic"),
+         path.join(sdkdir, "lib/crt"))
+
+option("board")
+    set_default("sail")
+
+compartment("zeroing")
+    add_defines("BOARD=" .. tostring(get_config("board")))
+    add_files("zeroing.cc")
+
+-- Firmware image for the benchmark.
+firmware("zeroing-benchmark")
+    add_deps("crt", "freestanding", "atomic", "stdio", "debug")
+    add_deps("zeroing")
+    on_load(function(target)
+        target:values_set("board", "$(board)")
+        target:values_set("threads", {
+            {
+                compartment = "zeroing",
+                priority = 1,
+                entry_point = "run",
+                stack_size = 0x800,
+                trusted_stack_frames = 3
+            }
+        }, {expand = false})
+    end)
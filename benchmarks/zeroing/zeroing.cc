@@ -0,0 +1,81 @@
+// Copyright CHERIoT Contributors.
+// SPDX-License-Identifier: MIT
+
+#include "../timing.h"
+#include <compartment.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+	/// The largest buffer that is zeroed or copied.
+	constexpr size_t MaxSize = 4096;
+
+	/// Buffers used for `memset` and `memcpy`.
+	alignas(sizeof(void *)) char buffer[MaxSize + sizeof(void *)];
+	alignas(sizeof(void *)) char source[MaxSize + sizeof(void *)];
+
+	/**
+	 * Run `fn` with interrupts disabled and return the number of cycles that
+	 * it took.
+	 */
+	template<typename Fn>
+	int measure(Fn &&fn)
+	{
+		return CHERI::with_interrupts_disabled([&]() {
+			int start = rdcycle();
+			fn();
+			return rdcycle() - start;
+		});
+	}
+} // namespace
+
+/**
+ * Report the cost of each variant of the zeroing and copy kernels for a
+ * range of sizes:
+ *
+ *  - `memset` with zero on a capability-aligned buffer, which uses the
+ *    unrolled capability-width kernel above a small threshold.
+ *  - `memset` with zero on a misaligned buffer, which adds the alignment
+ *    prologue and epilogue.
+ *  - `memset` with a non-zero value, which uses the 32-bit word loop and
+ *    serves as a baseline.
+ *  - `memcpy` of a capability-aligned buffer.
+ *  - `heap_free` of an object of this size, which zeroes it in the
+ *    allocator (inline for small objects, with `memset` for large ones).
+ *
+ * The switcher's stack zeroing uses the same kernel and is measured by the
+ * `stack-usage` benchmark.
+ */
+int __cheri_compartment("zeroing") run()
+{
+	// Make sure sail doesn't print annoying log messages in the middle of the
+	// output the first time that allocation happens.
+	free(malloc(16));
+	Timeout t{UnlimitedTimeout};
+
+	printf("#board\tsize\tzero\tzero_unaligned\tfill\tcopy\tfree\n");
+	for (size_t size = 8; size <= MaxSize; size <<= 1)
+	{
+		int zero      = measure([&]() { memset(buffer, 0, size); });
+		int unaligned = measure([&]() { memset(buffer + 1, 0, size); });
+		int fill      = measure([&]() { memset(buffer, 0x5a, size); });
+		int copy      = measure([&]() { memcpy(buffer, source, size); });
+
+		void *object = heap_allocate(&t, MALLOC_CAPABILITY, size);
+		int   freed  = -1;
+		if (__builtin_cheri_tag_get(object))
+		{
+			freed = measure([&]() { heap_free(MALLOC_CAPABILITY, object); });
+		}
+		printf(__XSTRING(BOARD) "\t%d\t%d\t%d\t%d\t%d\t%d\n",
+		       static_cast<int>(size),
+		       zero,
+		       unaligned,
+		       fill,
+		       copy,
+		       freed);
+	}
+	return 0;
+}
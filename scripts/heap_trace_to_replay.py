@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+# Copyright CHERIoT Contributors.
+# SPDX-License-Identifier: MIT
+
+"""
+Convert the output of `heap_trace_dump` (captured from the UART of a firmware
+image built with --allocator-tracing=y) into a trace that can be replayed by
+the `benchmarks/allocation-replay` benchmark.
+
+The allocator records chunk addresses.  This script assigns each live
+allocation a slot index so that the replay does not need to search for the
+matching allocation when it frees an object.  Frees of objects whose
+allocation is not in the captured trace (because it happened before the ring
+buffer was last dumped, or was overwritten) are dropped.
+"""
+
+import argparse, re, sys
+
+# Lines from the trace, after the debug prefix.  Numbers are printed either
+# as decimal or as 0x-prefixed hex.
+begin_re = re.compile(r'Allocator trace.*?: begin records=(\d+) dropped=(\d+)')
+record_re = re.compile(r'Allocator trace.*?: ([af]) (\S+) (\S+) (\S+) (\S+)')
+
+def parse(lines):
+    """
+    Yield (operation, owner, address, size, cycles) tuples for each record.
+    """
+    for line in lines:
+        m = begin_re.search(line)
+        if m:
+            if int(m.group(2)) != 0:
+                sys.stderr.write(f"Warning: {m.group(2)} records were "
+                                 "overwritten before the trace was dumped\n")
+            continue
+        m = record_re.search(line)
+        if m:
+            yield (m.group(1),) + tuple(int(x, 0) for x in m.groups()[1:])
+
+def convert(records):
+    """
+    Returns the list of (operation, size, slot, cycles) tuples to replay and
+    the number of slots needed.
+    """
+    live = {}
+    free_slots = []
+    slots = 0
+    dropped = 0
+    replay = []
+    for (op, owner, address, size, cycles) in records:
+        if op == 'a':
+            if address in live:
+                sys.stderr.write(f"Warning: 0x{address:x} allocated twice\n")
+                free_slots.append(live.pop(address))
+            if free_slots:
+                slot = free_slots.pop()
+            else:
+                slot = slots
+                slots += 1
+            live[address] = slot
+            replay.append(('ReplayAllocate', size, slot, cycles))
+        else:
+            slot = live.pop(address, None)
+            if slot is None:
+                dropped += 1
+                continue
+            free_slots.append(slot)
+            replay.append(('ReplayFree', size, slot, cycles))
+    if dropped:
+        sys.stderr.write(f"Dropped {dropped} frees of objects allocated "
+                         "before the start of the trace\n")
+    return (replay, max(slots, 1))
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().split('\n')[0])
+    parser.add_argument('log', nargs='?', type=argparse.FileType('r'),
+                        default=sys.stdin,
+                        help='UART output containing the trace (default: stdin)')
+    parser.add_argument('-o', '--output', type=argparse.FileType('w'),
+                        default=sys.stdout,
+                        help='File to write the replay trace to (default: stdout)')
+    args = parser.parse_args()
+    (replay, slots) = convert(parse(args.log))
+    out = args.output
+    out.write(f"// Generated by scripts/heap_trace_to_replay.py from "
+              f"{len(replay)} operations.\n")
+    out.write(f"#define REPLAY_SLOTS {slots}\n")
+    out.write("static const ReplayOperation ReplayTrace[] = {\n")
+    for (op, size, slot, cycles) in replay:
+        out.write(f"  {{{op}, {slot}, {size}, {cycles}}},\n")
+    out.write("};\n")
+
+if __name__ == '__main__':
+    main()
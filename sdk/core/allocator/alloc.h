@@ -57,6 +57,8 @@ using BIndex = uint32_t;
 using Binmap = uint32_t;
 static_assert(NSmallBins < utils::bytes2bits(sizeof(Binmap)));
 static_assert(NTreeBins < utils::bytes2bits(sizeof(Binmap)));
+static_assert(NSmallBins == HEAP_STATISTICS_SMALL_BINS);
+static_assert(NTreeBins == HEAP_STATISTICS_TREE_BINS);
 
 // Convert small size header into the actual size in bytes.
 static inline constexpr size_t head2size(SmallSize h)
@@ -850,9 +852,110 @@ class TChunkAssertions
 	static_assert(offsetof(TChunk, mchunk) == 0);
 };
 
+/**
+ * A cache of freed small chunks belonging to a single allocator capability,
+ * grouped by chunk size.
+ *
+ * Chunks enter a cache from `MState::mspace_free`, after they have been
+ * painted in the revocation bitmap and zeroed, exactly as if they were going
+ * into quarantine.  Each records the revocation epoch that must finish before
+ * it may be reused.  Each size class is a FIFO threaded through the bodies of
+ * the cached chunks and epochs are monotonic, so the head of a class is always
+ * the first chunk to become reusable.  Cached chunks remain marked as in use
+ * and are accounted as quarantined memory.
+ */
+struct SizeClassCache
+{
+	/// The number of size classes, one per `MallocAlignment` step.
+	static constexpr size_t Classes = 16;
+
+	/// The size of the largest chunk (including the header) held in a cache.
+	static constexpr size_t MaxChunkSize =
+	  MinChunkSize + (Classes - 1) * MallocAlignment;
+
+	/// The maximum number of chunks held in each size class.
+	static constexpr size_t Depth = 4;
+
+	/**
+	 * The metadata stored in the body of a cached chunk.
+	 */
+	struct Entry
+	{
+		/// The encoded address of the next chunk in this size class.
+		uint16_t encodedNext;
+		/// Padding, always zero.
+		uint16_t reserved;
+		/// The epoch that must have finished before this chunk is reused.
+		uint32_t epoch;
+	};
+	static_assert(sizeof(Entry) == MinRequest,
+	              "Cache entries must fit in the smallest chunk");
+
+	/// The owner identifier of the capability using this cache, 0 if unused.
+	uint16_t owner;
+	/// The encoded addresses of the oldest chunk in each size class.
+	uint16_t heads[Classes];
+	/// The encoded addresses of the youngest chunk in each size class.
+	uint16_t tails[Classes];
+	/// The number of chunks in each size class.
+	uint8_t counts[Classes];
+
+	/**
+	 * Returns true if a chunk of `chunkSize` bytes can be held in a cache.
+	 */
+	static bool is_cacheable(size_t chunkSize)
+	{
+		return (chunkSize >= MinChunkSize) && (chunkSize <= MaxChunkSize);
+	}
+
+	/**
+	 * Returns the size class for a cacheable chunk size.
+	 */
+	static size_t class_index(size_t chunkSize)
+	{
+		return (chunkSize - MinChunkSize) >> MallocAlignShift;
+	}
+
+	/**
+	 * Returns true if this cache holds no chunks.
+	 */
+	bool is_empty() const
+	{
+		for (uint8_t count : counts)
+		{
+			if (count != 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Returns the number of bytes in the chunks held in this cache.
+	 */
+	size_t cached_bytes() const
+	{
+		size_t cached = 0;
+		for (size_t ix = 0; ix < Classes; ix++)
+		{
+			cached += counts[ix] * (MinChunkSize + (ix << MallocAlignShift));
+		}
+		return cached;
+	}
+};
+
 class MState
 {
 	public:
+	/**
+	 * Called, if set, when the amount of memory in quarantine may have
+	 * changed how urgently revocation is needed.  There is one revoker for
+	 * every heap region, so the allocator sets this to a function that tells
+	 * the revoker the pressure across all of them.
+	 */
+	static inline void (*revokerPressureUpdate)() = nullptr;
+
 	CHERI::Capability<void> heapStart;
 
 	/**
@@ -861,6 +964,18 @@ class MState
 	 */
 	Capability<void *> hazardQuarantine;
 
+	/**
+	 * Space for a snapshot of the valid hazard pointers, sorted by base
+	 * address.  This is the same size as the hazard pointer array and is
+	 * filled by `hazard_snapshot_take`.
+	 */
+	Capability<void *> hazardSnapshot;
+
+	/**
+	 * The number of entries in `hazardSnapshot`.
+	 */
+	size_t hazardSnapshotCount = 0;
+
 	using RingSentinel = ds::linked_list::Sentinel<ChunkFreeLink>;
 	/*
 	 * Rings for each small bin size.  Use smallbin_at() for access to
@@ -916,11 +1031,130 @@ class MState
 	size_t heapFreeSize;
 	size_t heapQuarantineSize;
 
+	/**
+	 * With incremental zeroing, the chunk that has been removed from the
+	 * finished quarantine ring and is partially zeroed, or nullptr.  This is
+	 * still painted and counted in `heapQuarantineSize`.
+	 */
+	MChunkHeader *zeroingChunk = nullptr;
+
+	/**
+	 * The number of bytes at the start of the body of `zeroingChunk` that
+	 * have been zeroed.
+	 */
+	size_t zeroingOffset = 0;
+
+	/**
+	 * The number of revocation passes that were started because the
+	 * quarantine crossed a configured watermark.
+	 */
+	size_t watermarkKicks = 0;
+
 	/**
 	 * The number of entries currently in the `hazardQuarantine` array.
 	 */
 	size_t hazardQuarantineOccupancy = 0;
 
+	/**
+	 * The number of allocator capabilities that may have size-class caches.
+	 */
+	static constexpr size_t SizeClassCacheSlots = 4;
+
+	/**
+	 * Size-class caches for allocator capabilities that have opted in.  Use
+	 * `size_class_cache_get` to access these.
+	 */
+	SizeClassCache sizeClassCaches[SizeClassCacheSlots];
+
+	/**
+	 * The number of regions that the heap is divided into for the owner
+	 * index.  Each allocator capability records the regions in which it owns,
+	 * or has claimed, chunks in a bitmap with one bit per region, so that
+	 * `heap_free_all` needs to visit only those regions.  The bitmap is
+	 * shared between all heap regions, so each gets an equal share of it.
+	 */
+	static constexpr size_t OwnerIndexRegions = 64 / HeapRegions;
+
+	/**
+	 * Log2 of the size of an owner-index region.
+	 */
+	uint8_t ownerIndexShift;
+
+	/**
+	 * For each owner-index region, the offset from `heapStart` (in units of
+	 * `MallocAlignment`) of the header of the chunk that contains the first
+	 * byte of the region.  This gives `heap_free_all` somewhere to start
+	 * walking chunks in the middle of the heap.
+	 */
+	uint16_t ownerIndexChunks[OwnerIndexRegions];
+
+	/**
+	 * Summary of the blocks of this region that may hold capabilities, used
+	 * by the software revoker to skip the rest.  A block's bit is cleared
+	 * only while the block is entirely within a chunk on the free lists,
+	 * whose body is zero apart from the free-list links (which point only to
+	 * free chunks and so never need revoking).  It is set again before any
+	 * part of the block leaves the free lists.
+	 */
+	SoftwareRevokerTagSummary tagSummary;
+
+	/**
+	 * Initialise `tagSummary` to cover `size` bytes from `heapStart`, with
+	 * every block marked as possibly holding capabilities.
+	 */
+	void tag_summary_init(size_t size)
+	{
+		if constexpr (Revocation::UsesTagSummary)
+		{
+			// Use the smallest power-of-two block size that covers the heap.
+			size_t blockSize = (size + REVOKER_TAG_SUMMARY_BLOCKS - 1) /
+			                   REVOKER_TAG_SUMMARY_BLOCKS;
+			tagSummary.base       = heapStart.address();
+			tagSummary.blockShift = std::max<size_t>(
+			  MallocAlignShift,
+			  blockSize <= 1 ? 0 : BitsInSizeT - __builtin_clz(blockSize - 1));
+			tagSummary.blocks =
+			  (size + (size_t(1) << tagSummary.blockShift) - 1) >>
+			  tagSummary.blockShift;
+			memset(tagSummary.bits, 0xff, sizeof(tagSummary.bits));
+		}
+	}
+
+	/**
+	 * Update `tagSummary` for the chunk at `header`.  If
+	 * `mayHoldCapabilities` is true, mark every block that the chunk
+	 * overlaps, otherwise clear the blocks that are entirely within it.
+	 */
+	void tag_summary_update(MChunkHeader *header, bool mayHoldCapabilities)
+	{
+		if constexpr (Revocation::UsesTagSummary)
+		{
+			size_t    shift = tagSummary.blockShift;
+			ptraddr_t start =
+			  CHERI::Capability{header}.address() - tagSummary.base;
+			ptraddr_t end =
+			  CHERI::Capability{header->cell_next()}.address() -
+			  tagSummary.base;
+			size_t round = mayHoldCapabilities ? 0 : (size_t(1) << shift) - 1;
+			size_t first = (start + round) >> shift;
+			size_t last  = mayHoldCapabilities
+			                 ? (end + (size_t(1) << shift) - 1) >> shift
+			                 : end >> shift;
+			for (size_t block = first; block < last; block++)
+			{
+				uint32_t bit = 1U << (block % 32);
+				if (mayHoldCapabilities)
+				{
+					tagSummary.bits[block / 32] |= bit;
+				}
+				else
+				{
+					tagSummary.bits[block / 32] &= ~bit;
+				}
+			}
+		}
+	}
+
 	/**
 	 * Returns true if there are no objects in the `hazardQuarantine` array.
 	 */
@@ -1018,6 +1252,14 @@ class MState
 		quarantinePendingRing.reset();
 		quarantineFinishedSentinel.reset();
 		heapQuarantineSize = 0;
+		zeroingChunk       = nullptr;
+		zeroingOffset      = 0;
+		watermarkKicks     = 0;
+
+		for (auto &cache : sizeClassCaches)
+		{
+			cache = {};
+		}
 	}
 
 	/**
@@ -1071,6 +1313,15 @@ class MState
 
 		auto p = MChunkHeader::make(base, size);
 
+		// Use the smallest power-of-two region size that covers the heap.
+		size_t regionSize =
+		  (size + OwnerIndexRegions - 1) / OwnerIndexRegions;
+		ownerIndexShift = std::max<size_t>(
+		  MallocAlignShift,
+		  regionSize <= 1 ? 0 : BitsInSizeT - __builtin_clz(regionSize - 1));
+		owner_index_cover(p, CHERI::Capability{p}.address());
+		tag_summary_init(size);
+
 		heapTotalSize += size;
 		heapFreeSize += p->size_get();
 		insert_chunk(p, p->size_get());
@@ -1131,13 +1382,18 @@ class MState
 	 * object.  This allows it to be skipped when freeing all objects allocated
 	 * with a given quota.
 	 *
+	 * If `cache` is not null, an exactly sized chunk from that size-class
+	 * cache will be used in preference to searching the free lists, if one
+	 * has completed revocation.
+	 *
 	 * @return User pointer if request can be satisfied, or a tag type
 	 * representing the error otherwise.
 	 */
-	AllocationResult mspace_dispatch(size_t   bytes,
-	                                 size_t  &quota,
-	                                 uint16_t identifier,
-	                                 bool     isSealed = false)
+	AllocationResult mspace_dispatch(size_t          bytes,
+	                                 size_t         &quota,
+	                                 uint16_t        identifier,
+	                                 bool            isSealed = false,
+	                                 SizeClassCache *cache    = nullptr)
 	{
 		if (!hazard_quarantine_is_empty())
 		{
@@ -1169,8 +1425,23 @@ class MState
 			           quota);
 			return AllocationFailureQuotaExceeded{};
 		}
-		CHERI::Capability<void> ret{mspace_memalign(
-		  alignSize, -CHERI::representable_alignment_mask(bytes))};
+		CHERI::Capability<void> ret{nullptr};
+		if (cache != nullptr)
+		{
+			ret = size_class_cache_take(*cache, pad_request(alignSize), quota);
+		}
+		if (ret == nullptr)
+		{
+			ret = mspace_memalign(alignSize,
+			                      -CHERI::representable_alignment_mask(bytes));
+		}
+		// Memory held in size-class caches is unavailable to anyone else.
+		// Give it back and retry before reporting failure.
+		if ((ret == nullptr) && size_class_caches_flush())
+		{
+			ret = mspace_memalign(alignSize,
+			                      -CHERI::representable_alignment_mask(bytes));
+		}
 		if (ret == nullptr)
 		{
 			auto neededSize = alignSize + sizeof(MChunkHeader);
@@ -1244,9 +1515,10 @@ class MState
 
 	/**
 	 * Returns
-	 * the size of the allocation associated with `chunk`.
+	 * the size of the allocation associated with `chunk`.  This depends only
+	 * on the chunk and so may be used for chunks in any heap region.
 	 */
-	size_t chunk_body_size(MChunkHeader &chunk) const
+	static size_t chunk_body_size(MChunkHeader &chunk)
 	{
 		size_t    bodySize = chunk.size_get() - sizeof(MChunkHeader);
 		ptraddr_t base     = chunk.body().address();
@@ -1268,27 +1540,167 @@ class MState
 	}
 
 	/**
-	 * Check whether `allocation` is in the hazard list.  Returns true if it is.
+	 * Returns the size of the smallest chunk, including its header, that can
+	 * hold an allocation of `bytes`, or 0 if no chunk can.  Chunks that need
+	 * extra alignment padding for a precise capability may be larger.
+	 */
+	static size_t chunk_size(size_t bytes)
+	{
+		size_t alignSize =
+		  (CHERI::representable_length(bytes) + MallocAlignMask) &
+		  ~MallocAlignMask;
+		return (alignSize == 0) ? 0 : pad_request(alignSize);
+	}
+
+	/**
+	 * Try to grow the in-use `chunk` in place so that its body can hold
+	 * `bytes`, by absorbing the free chunk that follows it.  Any space beyond
+	 * what is needed is split off and returned to the free bins.  The
+	 * additional space is charged to `quota`.
+	 *
+	 * Returns a capability to the body of the chunk, bounded in the same way
+	 * as a fresh allocation, on success.  Returns null and leaves the heap
+	 * unmodified if the next chunk is not free or is too small, if the quota
+	 * is insufficient, or if the (fixed) base of `chunk` is not aligned
+	 * enough for a precise capability of the new size.
+	 *
+	 * The absorbed memory came from a free chunk and so is already zeroed,
+	 * apart from the free-list linkages and the header, which are cleared
+	 * here.
+	 */
+	CHERI::Capability<void>
+	mspace_grow(MChunkHeader &chunk, size_t bytes, size_t &quota)
+	{
+		size_t alignSize =
+		  (CHERI::representable_length(bytes) + MallocAlignMask) &
+		  ~MallocAlignMask;
+		CHERI::Capability<void> body{chunk.body()};
+		if ((alignSize == 0) ||
+		    ((body.address() & ~CHERI::representable_alignment_mask(bytes)) !=
+		     0))
+		{
+			return nullptr;
+		}
+		size_t        nb       = pad_request(alignSize);
+		size_t        size     = chunk.size_get();
+		MChunkHeader *next     = chunk.cell_next();
+		size_t        nextSize = next->size_get();
+		if (next->is_in_use() || (size + nextSize < nb))
+		{
+			return nullptr;
+		}
+		size_t merged = size + nextSize;
+		size_t grown  = (merged - nb >= MinChunkSize) ? nb : merged;
+		if (grown - size > quota)
+		{
+			return nullptr;
+		}
+
+		unlink_chunk(MChunk::from_header(next), nextSize);
+		heapFreeSize -= nextSize;
+		ds::linked_list::unsafe_remove_link(&chunk, next);
+		next->clear();
+		owner_index_cover(&chunk, CHERI::Capability{next}.address());
+		// next is no longer a header. Clear the shadow bit.
+		revoker.shadow_paint_single(CHERI::Capability{next}.address(), false);
+		chunk.mark_in_use();
+		if (grown != merged)
+		{
+			auto r = chunk_split(&chunk, grown);
+			r->mark_free();
+			insert_chunk(r, r->size_get());
+			heapFreeSize += r->size_get();
+			ok_free_chunk(r);
+		}
+		quota -= grown - size;
+		ok_in_use_chunk(&chunk);
+
+		size_t bodySize = grown - sizeof(MChunkHeader);
+		body.bounds() =
+		  CHERI::is_precise_range(body.address(), bodySize) ? bodySize
+		                                                    : alignSize;
+		return body;
+	}
+
+	/**
+	 * Take a snapshot of the valid hazard pointers, sorted by base address,
+	 * for use by `hazard_pointer_check`.
 	 *
 	 * This must be called in between `hazard_list_begin` and the guard going
-	 * out of scope.
+	 * out of scope.  Threads cannot successfully publish new hazards while
+	 * the guard is held.  Hazards that are cleared after the snapshot is
+	 * taken only keep objects in the hazard quarantine until the next
+	 * recheck.
 	 */
-	bool hazard_pointer_check(Capability<void> allocation)
+	void hazard_snapshot_take()
 	{
-		// It is now safe to walk the hazard list.
 		Capability<void *> hazards =
 		  const_cast<void **>(SHARED_OBJECT_WITH_PERMISSIONS(
 		    void *, allocator_hazard_pointers, true, false, true, false));
 		size_t pointers = hazards.length() / sizeof(void *);
+		size_t count    = 0;
 		for (size_t i = 0; i < pointers; i++)
 		{
-			Capability hazardPointer{hazards[i]};
-			if (hazardPointer.is_valid() &&
-			    hazardPointer.is_subset_of(allocation))
+			Capability<void> hazard{hazards[i]};
+			if (!hazard.is_valid())
+			{
+				continue;
+			}
+			// Insertion sort.  There are two slots per thread and most are
+			// usually empty, so this is cheaper than anything cleverer.
+			size_t j = count++;
+			for (; (j > 0) &&
+			       (Capability<void>{hazardSnapshot[j - 1]}.base() >
+			        hazard.base());
+			     j--)
+			{
+				hazardSnapshot[j] = hazardSnapshot[j - 1];
+			}
+			hazardSnapshot[j] = hazard;
+		}
+		hazardSnapshotCount = count;
+	}
+
+	/**
+	 * Check whether `allocation` is in the hazard list.  Returns true if it is.
+	 *
+	 * This must be called in between `hazard_list_begin` and the guard going
+	 * out of scope, after `hazard_snapshot_take`.  This binary searches the
+	 * snapshot for the first hazard whose base is in `allocation` and then
+	 * checks only hazards that start within `allocation`.
+	 */
+	bool hazard_pointer_check(Capability<void> allocation)
+	{
+		if (hazardSnapshotCount == 0)
+		{
+			return false;
+		}
+		ptraddr_t base  = allocation.base();
+		ptraddr_t top   = allocation.top();
+		size_t    lower = 0;
+		size_t    upper = hazardSnapshotCount;
+		while (lower < upper)
+		{
+			size_t middle = lower + (upper - lower) / 2;
+			if (Capability<void>{hazardSnapshot[middle]}.base() < base)
 			{
-				Debug::log("Found hazard pointer for {} (thread: {})",
-				           allocation,
-				           ((i / 2) + 1));
+				lower = middle + 1;
+			}
+			else
+			{
+				upper = middle;
+			}
+		}
+		for (size_t i = lower; i < hazardSnapshotCount; i++)
+		{
+			Capability<void> hazardPointer{hazardSnapshot[i]};
+			if (hazardPointer.base() > top)
+			{
+				break;
+			}
+			if (hazardPointer.is_subset_of(allocation))
+			{
+				Debug::log("Found hazard pointer for {}", allocation);
 				return true;
 			}
 		}
@@ -1308,6 +1720,7 @@ class MState
 	{
 		size_t insert            = 0;
 		bool   foundSkippedValue = false;
+		hazard_snapshot_take();
 		for (size_t i = 0; i < hazardQuarantineOccupancy; i++)
 		{
 			Capability ptr = hazardQuarantine[i];
@@ -1353,10 +1766,14 @@ class MState
 	 * Free a chunk.  The `bodySize` parameter specifies the size of the
 	 * allocated space that must be zeroed.  This must be calculated by the
 	 * caller and so is provided here to avoid recalculating it.
+	 *
+	 * If `cache` is not null, the chunk is placed in that size-class cache
+	 * instead of the quarantine if it is small enough and there is space.
 	 */
-	int mspace_free(MChunkHeader &chunk,
-	                size_t        bodySize,
-	                bool          skipHazardCheck = false)
+	int mspace_free(MChunkHeader   &chunk,
+	                size_t          bodySize,
+	                bool            skipHazardCheck = false,
+	                SizeClassCache *cache           = nullptr)
 	{
 		// Expand the bounds of the freed object to the whole heap and set the
 		// address that we're looking at to the base of the requested
@@ -1421,7 +1838,12 @@ class MState
 		 */
 		auto epoch = revoker.system_epoch_get();
 
-		capaligned_zero(mem, bodySize);
+		// With incremental zeroing, this is deferred until the chunk leaves
+		// quarantine (or enters a size-class cache).
+		if constexpr (!IncrementalZeroing)
+		{
+			capaligned_zero(mem, bodySize);
+		}
 
 		/*
 		 * We do not need to store lists for odd epochs (that is, things freed
@@ -1431,11 +1853,16 @@ class MState
 		epoch += epoch & 1;
 
 		/*
-		 * Enqueue this chunk to quarantine.  Its header is still marked as
-		 * being allocated.
+		 * Enqueue this chunk to quarantine, or to the freeing capability's
+		 * size-class cache, which defers reuse until the same epoch has
+		 * finished.  Its header is still marked as being allocated.
 		 */
-		quarantine_pending_push(epoch, &chunk);
-		heapQuarantineSize += chunk.size_get();
+		size_t chunkSize = chunk.size_get();
+		if ((cache == nullptr) || !size_class_cache_put(*cache, chunk, epoch))
+		{
+			quarantine_pending_push(epoch, &chunk);
+		}
+		heapQuarantineSize += chunkSize;
 
 		/*
 		 * Perhaps there has been some progress on revocation.  Dequeue 3 times.
@@ -1500,6 +1927,146 @@ class MState
 		return mspace_qtbin_deqn(4) > 0;
 	}
 
+	/**
+	 * Assign a size-class cache to the allocator capability with the owner
+	 * identifier `owner`.  Returns a non-zero handle for use with
+	 * `size_class_cache_get`, or zero if all caches are in use.  A cache is
+	 * released, and may be assigned to another capability, whenever it
+	 * becomes empty.
+	 */
+	uint8_t size_class_cache_acquire(uint16_t owner)
+	{
+		for (size_t i = 0; i < SizeClassCacheSlots; i++)
+		{
+			if (sizeClassCaches[i].owner == 0)
+			{
+				sizeClassCaches[i].owner = owner;
+				return i + 1;
+			}
+		}
+		return 0;
+	}
+
+	/**
+	 * Returns the size-class cache for a handle returned from
+	 * `size_class_cache_acquire`, or nullptr if `handle` is zero.
+	 */
+	SizeClassCache *size_class_cache_get(uint8_t handle)
+	{
+		if (handle == 0)
+		{
+			return nullptr;
+		}
+		Debug::Assert(handle <= SizeClassCacheSlots,
+		              "Invalid size-class cache handle {}",
+		              handle);
+		return &sizeClassCaches[handle - 1];
+	}
+
+	/**
+	 * Empty `cache` and release it.  Chunks whose revocation epoch has
+	 * finished are returned to the free lists, the rest are moved to the
+	 * quarantine.
+	 *
+	 * Returns true if any chunks were removed from the cache.
+	 */
+	bool size_class_cache_flush(SizeClassCache &cache)
+	{
+		bool flushed = false;
+		for (size_t ix = 0; ix < SizeClassCache::Classes; ix++)
+		{
+			while (cache.counts[ix] > 0)
+			{
+				auto [header, epoch] = size_class_cache_pop(cache, ix);
+				if (revoker.has_revocation_finished_for_epoch(epoch))
+				{
+					size_t size = header->size_get();
+					heapQuarantineSize -= size;
+					heapFreeSize += size;
+					revoker.shadow_paint_range<false>(header->body().address(),
+					                                  header->cell_next());
+					mspace_free_internal(header);
+				}
+				else
+				{
+					// Cached chunks are not in epoch order with respect to
+					// the quarantine rings, so requeue them for the current
+					// epoch, which is no earlier than theirs.
+					auto current = revoker.system_epoch_get();
+					current += current & 1;
+					quarantine_pending_push(current, header);
+				}
+				flushed = true;
+			}
+		}
+		cache.owner = 0;
+		return flushed;
+	}
+
+	/**
+	 * Empty and release every size-class cache.
+	 *
+	 * Returns true if any chunks were removed from a cache.
+	 */
+	bool size_class_caches_flush()
+	{
+		bool flushed = false;
+		for (auto &cache : sizeClassCaches)
+		{
+			flushed |= size_class_cache_flush(cache);
+		}
+		return flushed;
+	}
+
+	/**
+	 * Returns the owner-index region that contains `header`.
+	 */
+	size_t owner_index_region(MChunkHeader *header)
+	{
+		return (CHERI::Capability{header}.address() - heapStart.address()) >>
+		       ownerIndexShift;
+	}
+
+	/**
+	 * Returns the address of the first byte of owner-index region `region`.
+	 */
+	ptraddr_t owner_index_region_base(size_t region)
+	{
+		return heapStart.address() + (region << ownerIndexShift);
+	}
+
+	/**
+	 * Returns the header of the chunk that contains the first byte of
+	 * owner-index region `region`.
+	 */
+	MChunkHeader *owner_index_chunk(size_t region)
+	{
+		CHERI::Capability<MChunkHeader> header{heapStart.cast<MChunkHeader>()};
+		header.address() += ptraddr_t(ownerIndexChunks[region])
+		                    << MallocAlignShift;
+		return header;
+	}
+
+	/**
+	 * Returns true if `header` is a chunk that has been freed but not yet
+	 * returned to the free lists: it is in quarantine or in a size-class
+	 * cache.  Such chunks are still marked as in use but their bodies are
+	 * painted and their `claims` field must not be treated as a claim list.
+	 * This depends only on the chunk and the shadow bitmap and so may be used
+	 * for chunks in any heap region.
+	 */
+	static bool is_quarantined(MChunkHeader *header)
+	{
+		if constexpr (HasTemporalSafety)
+		{
+			// The sentinel at the end of the heap has no body.
+			return header->is_in_use() &&
+			       (header->size_get() > sizeof(MChunkHeader)) &&
+			       revoker.shadow_bit_get(header->body().address());
+		}
+		return false;
+	}
+
 	private:
 	/**
 	 * @brief helper to perform operation on a range of capability words
@@ -1526,12 +2093,153 @@ class MState
 		return false;
 	}
 
+	/**
+	 * Encode the address of a chunk in a size-class cache as a 16-bit offset
+	 * of its body from the start of the heap.
+	 */
+	uint16_t size_class_cache_encode(MChunkHeader *header)
+	{
+		ptraddr_t offset = header->body().address() - heapStart.address();
+		return offset >> MallocAlignShift;
+	}
+
+	/**
+	 * Decode a value returned from `size_class_cache_encode`.
+	 */
+	MChunkHeader *size_class_cache_decode(uint16_t encoded)
+	{
+		CHERI::Capability<void> body{heapStart};
+		body.address() += static_cast<ptraddr_t>(encoded) << MallocAlignShift;
+		return MChunkHeader::from_body(body);
+	}
+
+	/**
+	 * Remove the oldest chunk from size class `ix` of `cache`, which must not
+	 * be empty.  Returns the chunk header, with the cache metadata zeroed, and
+	 * the epoch that must finish before it can be reused.
+	 */
+	std::pair<MChunkHeader *, uint32_t>
+	size_class_cache_pop(SizeClassCache &cache, size_t ix)
+	{
+		auto    *header = size_class_cache_decode(cache.heads[ix]);
+		auto    *entry  = header->body<SizeClassCache::Entry>().get();
+		uint32_t epoch  = entry->epoch;
+		cache.heads[ix] = entry->encodedNext;
+		if (--cache.counts[ix] == 0)
+		{
+			cache.heads[ix] = cache.tails[ix] = 0;
+		}
+		static_assert(sizeof(*entry) == sizeof(uintptr_t));
+		*reinterpret_cast<uintptr_t *>(entry) = 0;
+		return {header, epoch};
+	}
+
+	/**
+	 * Try to take a chunk of exactly `chunkSize` bytes from `cache`.  This
+	 * succeeds only if the oldest chunk of that size has completed
+	 * revocation and the chunk fits in `quota`.  Returns the body of the
+	 * chunk, which is marked as in use and entirely zeroed, or nullptr.
+	 */
+	CHERI::Capability<void>
+	size_class_cache_take(SizeClassCache &cache, size_t chunkSize, size_t quota)
+	{
+		if (!SizeClassCache::is_cacheable(chunkSize) || (chunkSize > quota))
+		{
+			return nullptr;
+		}
+		size_t ix = SizeClassCache::class_index(chunkSize);
+		if (cache.counts[ix] == 0)
+		{
+			return nullptr;
+		}
+		auto *oldest = size_class_cache_decode(cache.heads[ix]);
+		if (!revoker.has_revocation_finished_for_epoch(
+		      oldest->body<SizeClassCache::Entry>()->epoch))
+		{
+			return nullptr;
+		}
+		auto [header, epoch] = size_class_cache_pop(cache, ix);
+		if (cache.is_empty())
+		{
+			cache.owner = 0;
+		}
+		heapQuarantineSize -= chunkSize;
+		revoker.shadow_paint_range<false>(header->body().address(),
+		                                  header->cell_next());
+		ok_malloced_chunk(header, chunkSize);
+		return header->body();
+	}
+
+	/**
+	 * Try to add a freed chunk, which has been painted and zeroed (unless
+	 * incremental zeroing is enabled, in which case this zeroes it), to
+	 * `cache`, to be reused after `epoch` has finished.  Returns false if the
+	 * chunk is too large or its size class is full.
+	 */
+	bool size_class_cache_put(SizeClassCache &cache,
+	                          MChunkHeader   &chunk,
+	                          uint32_t        epoch)
+	{
+		size_t size = chunk.size_get();
+		if (!SizeClassCache::is_cacheable(size))
+		{
+			return false;
+		}
+		size_t ix = SizeClassCache::class_index(size);
+		if (cache.counts[ix] >= SizeClassCache::Depth)
+		{
+			return false;
+		}
+		if constexpr (IncrementalZeroing)
+		{
+			// Cached chunks are handed out again without leaving quarantine.
+			capaligned_zero(chunk.body(), size - sizeof(MChunkHeader));
+		}
+		auto    *entry   = chunk.body<SizeClassCache::Entry>().get();
+		entry->epoch     = epoch;
+		uint16_t encoded = size_class_cache_encode(&chunk);
+		if (cache.counts[ix] == 0)
+		{
+			cache.heads[ix] = encoded;
+		}
+		else
+		{
+			size_class_cache_decode(cache.tails[ix])
+			  ->body<SizeClassCache::Entry>()
+			  ->encodedNext = encoded;
+		}
+		cache.tails[ix] = encoded;
+		cache.counts[ix]++;
+		return true;
+	}
+
+	/**
+	 * Zero a capability-aligned range.  Small ranges (most freed chunks are
+	 * only a few capabilities long) are zeroed inline, two capabilities per
+	 * iteration.  Larger ranges use `memset`, whose zero path is the
+	 * unrolled capability-width kernel that the switcher also uses to zero
+	 * stacks, and which amortises the cost of the library call.
+	 */
 	static void capaligned_zero(void *start, size_t size)
 	{
-		capaligned_range_do(start, size, [](void **word) {
+		Debug::Assert((size & (sizeof(void *) - 1)) == 0,
+		              "Cap range is not aligned");
+		if (size >= CapalignedZeroInlineLimit)
+		{
+			memset(start, 0, size);
+			return;
+		}
+		void **word = static_cast<void **>(start);
+		void **end  = word + size / sizeof(void *);
+		for (; word + 2 <= end; word += 2)
+		{
+			word[0] = nullptr;
+			word[1] = nullptr;
+		}
+		if (word != end)
+		{
 			*word = nullptr;
-			return false;
-		});
+		}
 	}
 
 	/**
@@ -1901,6 +2609,25 @@ class MState
 		{
 			ok_treebin(i);
 		}
+		// Check that the owner index refers to the chunk containing the start
+		// of each region.
+		for (size_t region = 0; (region < OwnerIndexRegions) &&
+		                        (owner_index_region_base(region) <
+		                         heapStart.top() - sizeof(MChunkHeader));
+		     region++)
+		{
+			MChunkHeader *header = owner_index_chunk(region);
+			MChunkHeader *next   = header->cell_next();
+			ptraddr_t     base   = owner_index_region_base(region);
+			Debug::Assert(
+			  (CHERI::Capability{header}.address() <= base) &&
+			    (CHERI::Capability{next}.address() > base),
+			  "Owner index for region {} refers to chunk {}, which does not "
+			  "contain {}",
+			  region,
+			  header,
+			  base);
+		}
 	}
 
 	private:
@@ -1915,6 +2642,7 @@ class MState
 		auto   bin = smallbin_at(i);
 		Debug::Assert(
 		  size >= MinChunkSize, "Size {} is not a small chunk size", size);
+		tag_summary_update(p, false);
 		if (!is_smallmap_marked(i))
 		{
 			smallmap_mark(i);
@@ -1941,6 +2669,7 @@ class MState
 		BIndex i       = small_index(s);
 		auto   bin     = smallbin_at(i);
 
+		tag_summary_update(pHeader, true);
 		Debug::Assert(!ds::linked_list::is_singleton(&p->ring),
 		              "Chunk {} is circularly referenced",
 		              p);
@@ -2000,6 +2729,7 @@ class MState
 		p->metadata_clear();
 
 		MChunkHeader *pHeader = MChunkHeader::from_body(p);
+		tag_summary_update(pHeader, true);
 		Debug::Assert(pHeader->size_get() == small_index2size(i),
 		              "Chunk {} is has size {} but is in bin for size {}",
 		              pHeader,
@@ -2019,6 +2749,7 @@ class MState
 		TChunk **head;
 		BIndex   i = compute_tree_index(s);
 		head       = treebin_at(i);
+		tag_summary_update(xHeader, false);
 
 		if (!is_treemap_marked(i))
 		{
@@ -2091,6 +2822,7 @@ class MState
 	{
 		TChunk *xp = x->parent;
 		TChunk *r;
+		tag_summary_update(MChunkHeader::from_body(x), true);
 		if (!ds::linked_list::is_singleton(&x->mchunk.ring))
 		{
 			TChunk *f = TChunk::from_ring(x->mchunk.ring.cell_next());
@@ -2282,7 +3014,7 @@ class MState
 				 * The remainder is big enough to to used by another
 				 * allocation, place it into the free list.
 				 */
-				auto r = vHeader->split(nb);
+				auto r = chunk_split(vHeader, nb);
 				insert_chunk(r, rsize);
 			}
 
@@ -2409,6 +3141,7 @@ class MState
 			unlink_chunk(MChunk::from_header(prev), prev->size_get());
 			ds::linked_list::unsafe_remove_link(prev, p);
 			p->clear();
+			owner_index_cover(prev, CHERI::Capability{p}.address());
 			// p is no longer a header. Clear the shadow bit.
 			revoker.shadow_paint_single(CHERI::Capability{p}.address(), false);
 			p = prev;
@@ -2421,6 +3154,7 @@ class MState
 			unlink_chunk(MChunk::from_header(next), next->size_get());
 			ds::linked_list::unsafe_remove_link(p, next);
 			next->clear();
+			owner_index_cover(p, CHERI::Capability{next}.address());
 			// next is no longer a header. Clear the shadow bit.
 			revoker.shadow_paint_single(CHERI::Capability{next}.address(),
 			                            false);
@@ -2432,6 +3166,18 @@ class MState
 		ok_free_chunk(p);
 	}
 
+	/**
+	 * Report a possible change in revocation pressure through
+	 * `revokerPressureUpdate`.
+	 */
+	static void revoker_pressure_notify()
+	{
+		if (revokerPressureUpdate != nullptr)
+		{
+			revokerPressureUpdate();
+		}
+	}
+
 	/**
 	 * Move a pending quarantine ring whose epoch is now past onto the finished
 	 * quarantine ring.
@@ -2453,6 +3199,7 @@ class MState
 			return;
 		}
 
+		revoker_pressure_notify();
 		if (!revoker.has_revocation_finished_for_epoch(
 		      quarantinePendingEpoch[oldestPendingIx]))
 		{
@@ -2462,11 +3209,9 @@ class MState
 		auto qring = quarantine_pending_get(oldestPendingIx);
 
 		/*
-		 * If and when we support consolidation in quarantine, it may happen
-		 * that this ring is empty, because everything that was here got
-		 * consolidated with younger chunks.  Until then, this is_empty()
-		 * check is somewhat redundant, but take_all() behaves poorly on
-		 * empty rings, so best to have it.
+		 * This ring may be empty, because everything that was here got
+		 * consolidated with younger chunks, and take_all() behaves poorly on
+		 * empty rings.
 		 */
 		if (!qring->is_empty())
 		{
@@ -2505,10 +3250,126 @@ class MState
 			quarantinePendingEpoch[youngestPendingIx] = epoch;
 		}
 
+		if constexpr (HasTemporalSafety)
+		{
+			uint16_t tag   = quarantine_tag(epoch);
+			header         = quarantine_coalesce(header, tag);
+			header->claims = tag;
+		}
 		quarantine_pending_get(youngestPendingIx)
 		  ->append_emplace(&(new (header->body()) MChunk())->ring);
 	}
 
+	/**
+	 * Returns the tag stored in the `claims` field of chunks pushed onto the
+	 * pending quarantine ring for `epoch`.  Freed chunks never have claims,
+	 * so the field is otherwise unused while they are in quarantine.  Ring
+	 * epochs are even, so setting the low bit ensures that the tag is never
+	 * zero.  Tagged chunks are recognised with the help of the shadow bitmap,
+	 * so chunks are tagged only when there is temporal safety.
+	 */
+	static uint16_t quarantine_tag(size_t epoch)
+	{
+		return static_cast<uint16_t>(epoch) | 1;
+	}
+
+	/**
+	 * Returns true if `header` is a chunk on a quarantine ring, tagged with
+	 * `tag`.  The bodies of quarantined chunks are painted in the shadow
+	 * bitmap, which distinguishes them from live chunks whose `claims` field
+	 * happens to have the same value.  Chunks in size-class caches are
+	 * painted but untagged and so are never matched.
+	 */
+	bool quarantine_is_tagged(MChunkHeader *header, uint16_t tag)
+	{
+		return header->is_in_use() && (header->claims == tag) &&
+		       revoker.shadow_bit_get(header->body().address());
+	}
+
+	/**
+	 * Remove a quarantined chunk from whichever quarantine ring it is on.
+	 */
+	void quarantine_unlink(MChunkHeader *header)
+	{
+		MChunk *chunk = MChunk::from_header(header);
+		ds::linked_list::unsafe_remove(&chunk->ring);
+		chunk->metadata_clear();
+	}
+
+	/**
+	 * Merge `header`, which is about to be pushed onto the quarantine ring
+	 * tagged with `tag`, with any physically adjacent chunks that were pushed
+	 * for the same epoch.  Returns the header of the merged chunk, which is
+	 * not on any ring.
+	 *
+	 * Merged chunks are removed from their rings and the result is pushed
+	 * onto the youngest ring.  If a stale chunk from a much older epoch
+	 * matches the (16-bit) tag, this only delays its reuse: it is never
+	 * released before the epoch of the chunk being pushed.
+	 *
+	 * The shadow bits of the absorbed headers are already set, as are those
+	 * of the quarantined bodies, so the merged chunk's body remains entirely
+	 * painted.  The absorbed headers are zeroed, so the merged body is zero
+	 * apart from the ring linkage, as `mspace_qtbin_deqn` expects (unless
+	 * incremental zeroing is enabled, in which case it zeroes the whole body).
+	 */
+	MChunkHeader *quarantine_coalesce(MChunkHeader *header, uint16_t tag)
+	{
+		MChunkHeader *next = header->cell_next();
+		if (quarantine_is_tagged(next, tag))
+		{
+			quarantine_unlink(next);
+			ds::linked_list::unsafe_remove_link(header, next);
+			next->clear();
+			owner_index_cover(header, CHERI::Capability{next}.address());
+		}
+
+		MChunkHeader *prev = header->cell_prev();
+		if ((prev != header) && quarantine_is_tagged(prev, tag))
+		{
+			quarantine_unlink(prev);
+			ds::linked_list::unsafe_remove_link(prev, header);
+			header->clear();
+			owner_index_cover(prev, CHERI::Capability{header}.address());
+			header = prev;
+		}
+
+		return header;
+	}
+
+	/**
+	 * Record that `header` is the chunk that contains the first byte of each
+	 * owner-index region that starts between `from` and the end of the chunk.
+	 * This must be called whenever a header is created or absorbed into its
+	 * predecessor.
+	 */
+	void owner_index_cover(MChunkHeader *header, ptraddr_t from)
+	{
+		ptraddr_t     base    = heapStart.address();
+		ptraddr_t     address = CHERI::Capability{header}.address();
+		MChunkHeader *next    = header->cell_next();
+		ptraddr_t     end     = CHERI::Capability{next}.address();
+		size_t        region =
+		  (from - base + (size_t(1) << ownerIndexShift) - 1) >> ownerIndexShift;
+		for (; (region < OwnerIndexRegions) &&
+		       (owner_index_region_base(region) < end);
+		     region++)
+		{
+			ownerIndexChunks[region] = (address - base) >> MallocAlignShift;
+		}
+	}
+
+	/**
+	 * Split a chunk at `offset`, keeping the owner index up to date.  See
+	 * `MChunkHeader::split`.
+	 */
+	MChunkHeader *chunk_split(MChunkHeader *p, size_t offset)
+	{
+		auto r = p->split(offset);
+		owner_index_cover(r, CHERI::Capability{r}.address());
+		return r;
+	}
+
 	/**
 	 * @brief Start revocation if this MState has accumulated enough things in
 	 * quarantine or the free space is too low.
@@ -2538,53 +3399,140 @@ class MState
 		{
 			shouldKick = heapQuarantineSize > heapFreeSize / 4 * 3;
 		}
+		if (!Force && !shouldKick && revocation_watermark_exceeded())
+		{
+			// Start a pass before an allocation has to wait for one.  Count
+			// only the kicks that start a pass, not those during one.
+			if ((revoker.system_epoch_get() & 1) == 0)
+			{
+				watermarkKicks++;
+			}
+			shouldKick = true;
+		}
 		if (Force || shouldKick)
 		{
+			revoker_pressure_notify();
 			revoker.system_bg_revoker_kick();
 		}
 
 		return 1;
 	}
 
+	/**
+	 * Returns true if the quarantine has crossed one of the configured
+	 * proactive revocation watermarks.
+	 */
+	bool revocation_watermark_exceeded()
+	{
+		if constexpr (RevocationWatermarkPercent != 0)
+		{
+			if (heapQuarantineSize >
+			    heapTotalSize / 100 * RevocationWatermarkPercent)
+			{
+				return true;
+			}
+		}
+		if constexpr (RevocationWatermarkBytes != 0)
+		{
+			if (heapQuarantineSize > RevocationWatermarkBytes)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/**
+	 * With incremental zeroing, zero up to `budget` bytes of the body of
+	 * `zeroingChunk`, continuing from `zeroingOffset`, and deduct the number
+	 * zeroed from `budget`.  Returns true if the whole body is now zero.
+	 */
+	bool zeroing_continue(size_t &budget)
+	{
+		size_t bodySize = zeroingChunk->size_get() - sizeof(MChunkHeader);
+		size_t length   = std::min(budget, bodySize - zeroingOffset);
+		capaligned_zero(
+		  ds::pointer::offset<void>(zeroingChunk->body().get(), zeroingOffset),
+		  length);
+		zeroingOffset += length;
+		budget -= length;
+		return zeroingOffset == bodySize;
+	}
+
 	/**
 	 * @brief Try to dequeue the quarantine list multiple times.
 	 *
+	 * With incremental zeroing, each dequeued chunk is zeroed first, and a
+	 * single call zeroes at most `IncrementalZeroingSlice` bytes.  A chunk
+	 * that is not completely zeroed is kept in `zeroingChunk` and finished
+	 * by later calls.
+	 *
 	 * @param loops how many times do we try to dequeue
+	 *
+	 * @return the number of chunks dequeued, plus one if a chunk was
+	 * partially zeroed, so that a non-zero result always indicates progress.
 	 */
 	int mspace_qtbin_deqn(size_t loops)
 	{
-		int  dequeued   = 0;
-		auto quarantine = quarantine_finished_get();
+		int    dequeued   = 0;
+		auto   quarantine = quarantine_finished_get();
+		size_t budget     = IncrementalZeroingSlice;
 
 		for (size_t i = 0; i < loops; i++)
 		{
-			/*
-			 * If we're out of nodes on the finished ring, try grabbing some
-			 * from the pending rings.
-			 */
-			if (quarantine->is_empty())
+			if (IncrementalZeroing && (budget == 0))
 			{
-				quarantine_pending_to_finished();
+				break;
+			}
+			MChunkHeader *foreHeader = zeroingChunk;
+			if (foreHeader == nullptr)
+			{
+				/*
+				 * If we're out of nodes on the finished ring, try grabbing
+				 * some from the pending rings.
+				 */
 				if (quarantine->is_empty())
 				{
-					break;
+					quarantine_pending_to_finished();
+					if (quarantine->is_empty())
+					{
+						break;
+					}
 				}
-			}
 
-			MChunk       *fore       = MChunk::from_ring(quarantine->first());
-			MChunkHeader *foreHeader = MChunkHeader::from_body(fore);
+				MChunk *fore = MChunk::from_ring(quarantine->first());
+				foreHeader   = MChunkHeader::from_body(fore);
 
-			/*
-			 * Detach from quarantine and zero the ring linkage; the rest of
-			 * this chunk, apart from its header, is also zero, thanks to the
-			 * capaligned_zero() done in mspace_free() before the chunk was
-			 * put into quarantine.  mspace_free_internal() will either rebuild
-			 * this cons cell, if it cannot consolidate backwards, or it will
-			 * discard the idea that this is a link cell at all by detaching
-			 * and clearing fore's header.
-			 */
-			ds::linked_list::unsafe_remove(&fore->ring);
-			fore->metadata_clear();
+				/*
+				 * Detach from quarantine and zero the ring linkage; the rest
+				 * of this chunk, apart from its header, is also zero, thanks
+				 * to the capaligned_zero() done in mspace_free() before the
+				 * chunk was put into quarantine (or, with incremental
+				 * zeroing, will be zeroed below).  mspace_free_internal() will
+				 * either rebuild this cons cell, if it cannot consolidate
+				 * backwards, or it will discard the idea that this is a link
+				 * cell at all by detaching and clearing fore's header.
+				 */
+				ds::linked_list::unsafe_remove(&fore->ring);
+				fore->metadata_clear();
+				foreHeader->claims = 0;
+			}
+
+			if constexpr (IncrementalZeroing)
+			{
+				if (zeroingChunk == nullptr)
+				{
+					zeroingChunk  = foreHeader;
+					zeroingOffset = 0;
+				}
+				if (!zeroing_continue(budget))
+				{
+					// Out of budget for this call, finish it next time.
+					dequeued++;
+					break;
+				}
+				zeroingChunk = nullptr;
+			}
 
 			heapQuarantineSize -= foreHeader->size_get();
 			heapFreeSize += foreHeader->size_get();
@@ -2670,7 +3618,7 @@ class MState
 
 				if (rsize >= MinChunkSize)
 				{
-					auto r = p->split(nb);
+					auto r = chunk_split(p, nb);
 					insert_small_chunk(r, rsize);
 				}
 				p->mark_in_use();
@@ -2768,7 +3716,7 @@ class MState
 			 * at that length, it will offset by -sizeof(MChunkHeader), since
 			 * headers always measure lengths inclusive of themselves!
 			 */
-			auto r = p->split(alignpad);
+			auto r = chunk_split(p, alignpad);
 			/*
 			 * XXX Were we to not use the general mspace_malloc above, but
 			 * have a raw, free MChunk* from the free pool here, we could
@@ -2790,7 +3738,7 @@ class MState
 		auto size = p->size_get();
 		if (size >= nb + MinChunkSize)
 		{
-			auto r = p->split(nb);
+			auto r = chunk_split(p, nb);
 			/*
 			 * XXX Were we to not use the general mspace_malloc above, but
 			 * have a raw, free MChunk* from the free pool here, we could
@@ -2817,6 +3765,128 @@ class MState
 		ABORT();
 	}
 
+	public:
+	/**
+	 * Add the state of this heap region to the fields of `statistics` that
+	 * describe the state of the heap, which the caller must have zeroed.
+	 * Sizes are summed over regions, the largest free chunk and quarantine
+	 * epochs are the maximum over regions.  The latency histograms are not
+	 * maintained by the `MState` and are left untouched.
+	 */
+	void statistics_collect(HeapStatistics &statistics)
+	{
+		static_assert(QuarantineRings == HEAP_STATISTICS_QUARANTINE_RINGS);
+		size_t largest = statistics.largestFreeChunk;
+		auto   sumRing = [](RingSentinel *ring) {
+			size_t bytes = 0;
+			ring->search([&](ChunkFreeLink *&p) {
+				bytes +=
+				  MChunkHeader::from_body(MChunk::from_ring(p))->size_get();
+				return false;
+			});
+			return bytes;
+		};
+
+		statistics.heapSize += heapTotalSize;
+		statistics.freeBytes += heapFreeSize;
+		statistics.quarantinedBytes += heapQuarantineSize;
+
+		for (BIndex i = 0; i < NSmallBins; i++)
+		{
+			size_t bytes = sumRing(smallbin_at(i));
+			statistics.smallBinFreeBytes[i] += bytes;
+			if (bytes != 0)
+			{
+				largest = std::max(largest, small_index2size(i));
+			}
+		}
+
+		for (BIndex i = 0; i < NTreeBins; i++)
+		{
+			statistics.treeBinFreeBytes[i] +=
+			  treebin_free_bytes(*treebin_at(i), largest);
+		}
+		statistics.largestFreeChunk = largest;
+
+		for (size_t ix = 0; ix < QuarantineRings; ix++)
+		{
+			statistics.quarantinePendingBytes[ix] +=
+			  sumRing(quarantine_pending_get(ix));
+			size_t &epoch = statistics.quarantinePendingEpoch[ix];
+			epoch         = std::max<size_t>(epoch, quarantinePendingEpoch[ix]);
+		}
+		statistics.quarantineFinishedBytes +=
+		  sumRing(quarantine_finished_get());
+		if (zeroingChunk != nullptr)
+		{
+			statistics.quarantineZeroingBytes += zeroingChunk->size_get();
+		}
+
+		for (auto &cache : sizeClassCaches)
+		{
+			statistics.cachedBytes += cache.cached_bytes();
+		}
+
+		statistics.hazardQuarantineOccupancy += hazardQuarantineOccupancy;
+		statistics.hazardQuarantineCapacity +=
+		  hazardQuarantine.length() / sizeof(void *);
+		statistics.revocationWatermarkKicks += watermarkKicks;
+	}
+
+	private:
+	/**
+	 * Returns the number of free bytes in the tree rooted at `root`, updating
+	 * `largest` if the tree contains a chunk larger than it.
+	 *
+	 * This is a non-recursive pre-order walk, in the same style as `ok_tree`,
+	 * so that its stack usage does not depend on the depth of the tree.
+	 */
+	size_t treebin_free_bytes(TChunk *root, size_t &largest)
+	{
+		size_t bytes = 0;
+		if (root == nullptr)
+		{
+			return bytes;
+		}
+		TChunk *t    = root;
+		TChunk *from = t->parent;
+		while (true)
+		{
+			if (from == t->parent)
+			{
+				// Came from the parent: count this node and its ring of
+				// equal-sized chunks, then descend as leftwards as we can.
+				size_t size  = MChunkHeader::from_body(t)->size_get();
+				size_t count = 1;
+				t->ring_search([&](MChunk *) {
+					count++;
+					return false;
+				});
+				bytes += size * count;
+				largest = std::max(largest, size);
+				if (t->leftmost_child() != nullptr)
+				{
+					from = t;
+					t    = t->leftmost_child();
+					continue;
+				}
+			}
+			else if ((from == t->child[0]) && (t->child[1] != nullptr))
+			{
+				from = t;
+				t    = t->child[1];
+				continue;
+			}
+			if (t->is_root())
+			{
+				break;
+			}
+			from = t;
+			t    = t->parent;
+		}
+		return bytes;
+	}
+
 #if HEAP_RENDER
 	public:
 	/**
@@ -2944,6 +4014,30 @@ class MState
 			}
 		}
 
+		for (auto &cache : sizeClassCaches)
+		{
+			if (cache.owner == 0)
+			{
+				continue;
+			}
+			RenderDebug::log("  size-class cache for owner={}:", cache.owner);
+			for (size_t ix = 0; ix < SizeClassCache::Classes; ix++)
+			{
+				uint16_t encoded = cache.heads[ix];
+				for (size_t i = 0; i < cache.counts[ix]; i++)
+				{
+					auto header = size_class_cache_decode(encoded);
+					auto entry  = header->body<SizeClassCache::Entry>();
+					RenderDebug::log("   cached {} size={} epoch={}",
+					                 toAddr(header),
+					                 header->size_get(),
+					                 entry->epoch);
+					measuredQuarantined += header->size_get();
+					encoded = entry->encodedNext;
+				}
+			}
+		}
+
 		auto measuredTotal = measuredAllocated + measuredFree;
 
 		RenderDebug::log(
@@ -23,6 +23,64 @@ constexpr size_t MStateSanityInterval = 128;
 
 constexpr size_t MallocAlignShift = 3;
 
+/**
+ * If true, freed chunks are zeroed when they leave quarantine, in slices of
+ * at most `IncrementalZeroingSlice` bytes, rather than when they are freed.
+ */
+constexpr bool IncrementalZeroing = HEAP_INCREMENTAL_ZEROING;
+
+/**
+ * The maximum number of bytes that a single quarantine-processing step zeroes
+ * with incremental zeroing.  This bounds the time for which zeroing holds
+ * the allocator lock.
+ */
+constexpr size_t IncrementalZeroingSlice = 1024;
+
+/**
+ * Ranges at least this long are zeroed with `memset`, which uses the
+ * unrolled capability-width kernel, rather than with an inline loop.  Below
+ * this, the cost of the library call dominates.
+ */
+constexpr size_t CapalignedZeroInlineLimit = 64;
+
+/**
+ * Quarantine watermarks for proactive revocation.  A background revocation
+ * pass is started when the quarantine of a heap region holds more than
+ * `RevocationWatermarkPercent` percent of the region, or more than
+ * `RevocationWatermarkBytes` bytes, in addition to the built-in heuristics.
+ * Zero disables a watermark.
+ */
+constexpr size_t RevocationWatermarkPercent = HEAP_REVOCATION_WATERMARK_PERCENT;
+constexpr size_t RevocationWatermarkBytes   = HEAP_REVOCATION_WATERMARK_BYTES;
+static_assert(RevocationWatermarkPercent <= 100,
+              "Revocation watermark must be a percentage of the heap");
+
+/**
+ * The number of threads blocked on a full heap that are tracked with their
+ * request size, so that a free wakes only the threads that it may be able to
+ * satisfy.  Further threads fall back to waiting for any free.
+ */
+constexpr size_t BlockedAllocationSlots = 8;
+
+/**
+ * The number of allocator capabilities that can hold a reservation (see
+ * `heap_reserve`) at the same time.
+ */
+constexpr size_t ReservationSlots = 4;
+
+/**
+ * The maximum number of slabs (each holding 31 claims) that the allocator can
+ * use for claims.  Slabs are not charged to any quota, so this bounds the heap
+ * memory that claims can hold when slabs are only sparsely used.
+ */
+constexpr size_t ClaimPoolSlabs = 16;
+
+/**
+ * The number of frees that `heap_free_deferred` can queue while another thread
+ * holds the allocator lock.  When the queue is full, deferred frees block.
+ */
+constexpr size_t PendingFreeSlots = 8;
+
 constexpr size_t MallocAlignment = 1U << MallocAlignShift;
 constexpr size_t MallocAlignMask = MallocAlignment - 1;
 
@@ -48,3 +106,22 @@ constexpr StackCheckMode StackMode =
 #	define STACK_CHECK(expected)                                              \
 		StackUsageCheck<StackMode, expected, __PRETTY_FUNCTION__> stackCheck
 #endif
+
+/**
+ * The number of heap regions that the allocator manages.  Region 0 is the
+ * `heap` region that the loader provides.  Boards may provide additional
+ * regions (for example, a bank of slower memory) as devices named
+ * `heap_region1` to `heap_region3`.  Allocations may request a region with a
+ * placement hint (see `ALLOCATE_PLACEMENT_REGION`).
+ */
+constexpr size_t HeapRegions =
+#if DEVICE_EXISTS(heap_region3)
+  4
+#elif DEVICE_EXISTS(heap_region2)
+  3
+#elif DEVICE_EXISTS(heap_region1)
+  2
+#else
+  1
+#endif
+  ;
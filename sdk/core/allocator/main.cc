@@ -31,8 +31,136 @@ __attribute__((section(".sealing_key2"))) Capability<SKeyStruct>
 using namespace CHERI;
 
 Revocation::Revoker revoker;
+
+#if defined(TEMPORAL_SAFETY) && defined(SOFTWARE_REVOKER)
+/**
+ * The authorisation to register tag summaries and heap region scan ranges
+ * with the software revoker.
+ */
+DECLARE_AND_DEFINE_STATIC_SEALED_VALUE(
+  struct SoftwareRevokerTagSummaryAuthority,
+  software_revoker,
+  TagSummaryKey,
+  tagSummaryAuthority,
+  0);
+
+static_assert(HeapRegions - 1 <= REVOKER_SCAN_RANGES,
+              "The software revoker cannot scan every heap region");
+#endif
+
 namespace
 {
+	// the global memory space
+	MState *gm;
+
+	/**
+	 * The memory spaces for each heap region.  The first is `gm`, the others
+	 * are null if the board does not provide the corresponding region or if
+	 * it could not be used.
+	 */
+	MState *mspaces[HeapRegions];
+
+	/**
+	 * The number of threads blocked in `wait_for_background_revoker`.  The
+	 * revoker runs at maximum pressure while this is non-zero.
+	 */
+	size_t revocationWaiters;
+
+	/**
+	 * Tell the revoker how urgent revocation is, as the percentage of all
+	 * heap regions that is in quarantine.  A synchronous revoker scans more
+	 * memory per tick as this grows.  While any thread is blocked waiting for
+	 * revocation, the pressure stays at the maximum.  Installed as
+	 * `MState::revokerPressureUpdate`.
+	 */
+	void revoker_pressure_update()
+	{
+		if (revocationWaiters > 0)
+		{
+			revoker.pressure_set(REVOKER_PRESSURE_MAX);
+			return;
+		}
+		size_t quarantined = 0;
+		size_t total       = 0;
+		for (MState *region : mspaces)
+		{
+			if (region != nullptr)
+			{
+				quarantined += region->heapQuarantineSize;
+				total += region->heapTotalSize;
+			}
+		}
+		revoker.pressure_set(quarantined / (total / 100 + 1));
+	}
+
+	/**
+	 * Returns the heap region that contains `address`, or nullptr if it is
+	 * not in any heap region.
+	 */
+	MState *region_for(ptraddr_t address)
+	{
+		for (MState *region : mspaces)
+		{
+			if ((region != nullptr) &&
+			    (address >= region->heapStart.base()) &&
+			    (address < region->heapStart.top()))
+			{
+				return region;
+			}
+		}
+		return nullptr;
+	}
+
+	/**
+	 * Returns the index of `region` in `mspaces`.
+	 */
+	size_t region_index(MState *region)
+	{
+		size_t index = 0;
+		while (mspaces[index] != region)
+		{
+			index++;
+		}
+		return index;
+	}
+
+	/**
+	 * Returns the bit in an owner-index bitmap (see
+	 * `PrivateAllocatorCapabilityState::ownerRegions`) for the owner-index
+	 * region that contains `chunk`.  Each heap region has
+	 * `MState::OwnerIndexRegions` consecutive bits.
+	 */
+	size_t owner_index_bit(MChunkHeader *chunk)
+	{
+		MState *region = region_for(Capability{chunk}.address());
+		return (region_index(region) * MState::OwnerIndexRegions) +
+		       region->owner_index_region(chunk);
+	}
+
+	/**
+	 * Given a pointer that is probably in an allocation in any heap region,
+	 * try to find the start of that allocation.  Returns the header if this
+	 * is a valid pointer into an allocation, nullptr otherwise.
+	 */
+	MChunkHeader *allocation_start(ptraddr_t address)
+	{
+		MState *region = region_for(address);
+		return (region == nullptr) ? nullptr
+		                           : region->allocation_start(address);
+	}
+
+	/**
+	 * Returns the header of the chunk whose body is `allocation`.  The header
+	 * is derived from the capability for the heap region, not from
+	 * `allocation`, which is bounded to the body.
+	 */
+	MChunkHeader *allocation_header(Capability<void> allocation)
+	{
+		Capability heap{region_for(allocation.address())->heapStart};
+		heap.address() = allocation.address();
+		return MChunkHeader::from_body(heap);
+	}
+
 	/**
 	 * Internal view of an allocator capability.
 	 *
@@ -46,15 +174,151 @@ namespace
 		size_t quota;
 		/// A unique identifier for this pool.
 		uint16_t identifier;
+		/// Flags from `AllocatorCapabilityFlags`.
+		uint16_t flags;
+		/**
+		 * Handle for the size-class cache last used by this capability, zero
+		 * if it has not had one.  The cache may since have been released, see
+		 * `size_class_cache`.
+		 */
+		uint8_t sizeClassCache;
+		/**
+		 * Handle for the reservation held by this capability (one more than
+		 * its index in `reservations`), zero if it does not have one.
+		 */
+		uint8_t reservation;
+		/**
+		 * Bitmap of the owner-index regions (see `MState::OwnerIndexRegions`)
+		 * that may contain chunks that this capability owns or has claimed.
+		 * Bits are set when allocating or claiming and are cleared only by
+		 * `heap_free_all`, so this may over-approximate.
+		 */
+		uint64_t ownerRegions;
+
+		/**
+		 * Returns the size-class cache for this capability, or nullptr if it
+		 * does not have one.  Caches are released when they become empty.  If
+		 * `acquire` is true, a capability that has opted in to caching takes
+		 * a free cache if it does not hold one.
+		 */
+		SizeClassCache *size_class_cache(bool acquire = false)
+		{
+			if ((flags & AllocatorCapabilitySizeClassCache) == 0)
+			{
+				return nullptr;
+			}
+			SizeClassCache *cache = gm->size_class_cache_get(sizeClassCache);
+			if ((cache != nullptr) && (cache->owner == identifier))
+			{
+				return cache;
+			}
+			sizeClassCache =
+			  acquire ? gm->size_class_cache_acquire(identifier) : 0;
+			return gm->size_class_cache_get(sizeClassCache);
+		}
+
+		/**
+		 * Record that this capability owns, or holds a claim on, `chunk`.
+		 * The header is used only for its address and so may be derived from
+		 * a capability that is bounded to the body.
+		 */
+		void owner_index_add(MChunkHeader *chunk)
+		{
+			ownerRegions |= uint64_t(1) << owner_index_bit(chunk);
+		}
 	};
+	static_assert(HeapRegions * MState::OwnerIndexRegions <=
+	                utils::bytes2bits(
+	                  sizeof(PrivateAllocatorCapabilityState::ownerRegions)),
+	              "Owner-index bitmap is too small for the number of regions");
 
 	static_assert(sizeof(PrivateAllocatorCapabilityState) <=
 	              sizeof(AllocatorCapabilityState));
 	static_assert(alignof(PrivateAllocatorCapabilityState) <=
 	              alignof(AllocatorCapabilityState));
+	static_assert(offsetof(PrivateAllocatorCapabilityState, flags) ==
+	                offsetof(AllocatorCapabilityState, flags),
+	              "Flags must be where DEFINE_ALLOCATOR_CAPABILITY puts them");
 
-	// the global memory space
-	MState *gm;
+	/**
+	 * Memory reserved for an allocator capability with `heap_reserve`.
+	 * Reservations are not tied to particular chunks.  Instead, allocations
+	 * with other capabilities fail if they would leave less free memory than
+	 * the unused parts of all reservations.
+	 */
+	struct Reservation
+	{
+		/// The capability that holds this reservation, nullptr if unused.
+		PrivateAllocatorCapabilityState *capability;
+		/// The number of bytes reserved.
+		size_t bytes;
+		/**
+		 * The number of bytes, including headers, in chunks that `capability`
+		 * has allocated since the reservation was made and still owns.
+		 * Claims are charged to the quota but are not drawn from the
+		 * reservation.
+		 */
+		size_t used;
+
+		/**
+		 * Returns the number of reserved bytes that the capability has not
+		 * used.
+		 */
+		size_t unused()
+		{
+			return (used < bytes) ? bytes - used : 0;
+		}
+	};
+
+	/// Reservations, indexed by `PrivateAllocatorCapabilityState::reservation`.
+	Reservation reservations[ReservationSlots];
+
+	/**
+	 * Record that `capability` has allocated a chunk, or grown one, by
+	 * `bytes`.  This draws on its reservation, if it has one.
+	 */
+	void reservation_charge(PrivateAllocatorCapabilityState &capability,
+	                        size_t                           bytes)
+	{
+		if (capability.reservation != 0)
+		{
+			reservations[capability.reservation - 1].used += bytes;
+		}
+	}
+
+	/**
+	 * Record that `capability` no longer owns a chunk of `bytes`.  Chunks
+	 * allocated before the reservation was made were never drawn from it, so
+	 * this never takes the use below zero.
+	 */
+	void reservation_refund(PrivateAllocatorCapabilityState &capability,
+	                        size_t                           bytes)
+	{
+		if (capability.reservation != 0)
+		{
+			size_t &used = reservations[capability.reservation - 1].used;
+			used -= std::min(used, bytes);
+		}
+	}
+
+	/**
+	 * Returns the number of reserved bytes that have not been used, excluding
+	 * any reservation held by `capability`.
+	 */
+	size_t
+	reservations_unused(PrivateAllocatorCapabilityState *capability = nullptr)
+	{
+		size_t unused = 0;
+		for (auto &reservation : reservations)
+		{
+			if ((reservation.capability != nullptr) &&
+			    (reservation.capability != capability))
+			{
+				unused += reservation.unused();
+			}
+		}
+		return unused;
+	}
 
 	/**
 	 * A global lock for the allocator.  This is acquired in public API
@@ -104,26 +368,109 @@ namespace
 		      void *, allocator_hazard_pointers, true, false, true, false)}
 		    .length();
 
+		// The hazard quarantine and the hazard snapshot are each the same
+		// size as the hazard pointer array.
+		size_t reservedSize = msize + 2 * hazardQuarantineSize;
+
 		m.bounds()            = sizeof(*m);
 		m->heapStart          = tbase;
 		m->heapStart.bounds() = tsize;
-		m->heapStart.address() += msize + hazardQuarantineSize;
+		m->heapStart.address() += reservedSize;
 		m->init_bins();
 
 		// Carve off the front of the heap space to use for the hazard
-		// quarantine.
+		// quarantine and the snapshot of hazard pointers.
 		Capability hazardQuarantine = tbase;
 		hazardQuarantine.address() += msize;
 		hazardQuarantine.bounds() = hazardQuarantineSize;
 		m->hazardQuarantine       = hazardQuarantine.cast<void *>();
 
+		Capability hazardSnapshot = tbase;
+		hazardSnapshot.address() += msize + hazardQuarantineSize;
+		hazardSnapshot.bounds() = hazardQuarantineSize;
+		m->hazardSnapshot       = hazardSnapshot.cast<void *>();
+
 		m->mspace_firstchunk_add(
-		  ds::pointer::offset<void>(tbase.get(), msize + hazardQuarantineSize),
-		  tsize - msize - hazardQuarantineSize);
+		  ds::pointer::offset<void>(tbase.get(), reservedSize),
+		  tsize - reservedSize);
+
+#if defined(TEMPORAL_SAFETY) && defined(SOFTWARE_REVOKER)
+		if (!revoker.tag_summary_add(STATIC_SEALED_VALUE(tagSummaryAuthority),
+		                             &m->tagSummary))
+		{
+			Debug::log<DebugLevel::Warning>(
+			  "Failed to register tag summary for heap at {}", tbase);
+		}
+#endif
 
 		return m;
 	}
 
+	/**
+	 * Set up the memory space for the additional heap region `index`, which
+	 * the board provides as the device `heap_region<index>`.  The region is
+	 * ignored if it overlaps the loader's state (globals, stacks, and so on)
+	 * or the primary heap, if the shadow bitmap does not cover it, or if the
+	 * revoker cannot add it to the memory that it sweeps.
+	 */
+	void heap_region_add(size_t index, volatile void *region)
+	{
+		Capability heap{const_cast<void *>(region)};
+		ptraddr_t  loaderBase = LA_ABS(__revoker_scan_start);
+		ptraddr_t  loaderTop  = LA_ABS(__export_mem_heap_end);
+		if (!heap.is_valid() ||
+		    ((heap.top() > loaderBase) && (heap.base() < loaderTop)))
+		{
+			Debug::log<DebugLevel::Warning>(
+			  "Heap region {} ({}) overlaps loader state or the primary heap, "
+			  "ignoring it",
+			  index,
+			  heap);
+			return;
+		}
+		if (HasTemporalSafety &&
+		    !revoker.shadow_covers(heap.base(), heap.top()))
+		{
+			Debug::log<DebugLevel::Warning>(
+			  "Heap region {} ({}) is not covered by the shadow bitmap, "
+			  "ignoring it",
+			  index,
+			  heap);
+			return;
+		}
+#if defined(TEMPORAL_SAFETY) && defined(SOFTWARE_REVOKER)
+		if (!revoker.scan_range_add(STATIC_SEALED_VALUE(tagSummaryAuthority),
+		                            heap))
+		{
+			Debug::log<DebugLevel::Warning>(
+			  "Failed to add heap region {} ({}) to the revoker, ignoring it",
+			  index,
+			  heap);
+			return;
+		}
+#elif defined(TEMPORAL_SAFETY)
+		// The hardware revoker sweeps the single range that the allocator
+		// gives it at boot, which covers only loader state and the primary
+		// heap.
+		Debug::log<DebugLevel::Warning>(
+		  "Heap region {} ({}) is not swept by the hardware revoker, "
+		  "ignoring it",
+		  index,
+		  heap);
+		return;
+#endif
+		// The loader zeroes only the primary heap.
+		memset(heap, 0, heap.bounds());
+		mspaces[index] = mstate_init(heap, heap.bounds());
+		if (mspaces[index] == nullptr)
+		{
+			Debug::log<DebugLevel::Warning>(
+			  "Heap region {} ({}) is too small or misaligned, ignoring it",
+			  index,
+			  heap);
+		}
+	}
+
 	void check_gm()
 	{
 		if (gm == nullptr)
@@ -137,17 +484,136 @@ namespace
 			                                   /*loadMutable*/ true));
 
 			revoker.init();
+			MState::revokerPressureUpdate = revoker_pressure_update;
 			gm = mstate_init(heap, heap.bounds());
 			Debug::Assert(gm != nullptr, "gm should not be null");
+			mspaces[0] = gm;
+#if DEVICE_EXISTS(heap_region1)
+			heap_region_add(
+			  1,
+			  MMIO_CAPABILITY_WITH_PERMISSIONS(void,
+			                                   heap_region1,
+			                                   /*load*/ true,
+			                                   /*store*/ true,
+			                                   /*capabilities*/ true,
+			                                   /*loadMutable*/ true));
+#endif
+#if DEVICE_EXISTS(heap_region2)
+			heap_region_add(
+			  2,
+			  MMIO_CAPABILITY_WITH_PERMISSIONS(void,
+			                                   heap_region2,
+			                                   /*load*/ true,
+			                                   /*store*/ true,
+			                                   /*capabilities*/ true,
+			                                   /*loadMutable*/ true));
+#endif
+#if DEVICE_EXISTS(heap_region3)
+			heap_region_add(
+			  3,
+			  MMIO_CAPABILITY_WITH_PERMISSIONS(void,
+			                                   heap_region3,
+			                                   /*load*/ true,
+			                                   /*store*/ true,
+			                                   /*capabilities*/ true,
+			                                   /*loadMutable*/ true));
+#endif
 		}
 	}
 
 	/**
 	 * Futex value to allow a thread to wait for another thread to free an
-	 * object.
+	 * object.  This is used only when all of `blockedAllocations` are in use.
 	 */
 	cheriot::atomic<int32_t> freeFutex = -1;
 
+	/**
+	 * A thread that is blocked waiting for memory to be freed.
+	 */
+	struct BlockedAllocation
+	{
+		/// States of `futex`.
+		enum State : uint32_t
+		{
+			/// The record is not in use.
+			Free,
+			/// A thread is waiting on this record.
+			Waiting,
+			/// The thread has been woken but has not yet released the record.
+			Woken,
+		};
+
+		/**
+		 * The number of bytes that the thread is trying to allocate, or zero
+		 * if it is waiting for quota.  Quota can be returned by frees with
+		 * any capability (for example, when the last claim is dropped) and so
+		 * threads waiting for quota are woken by every free.
+		 */
+		size_t bytes;
+
+		/// The order in which the threads started waiting.
+		uint32_t sequence;
+
+		/**
+		 * The state of this record, which the thread waits on.  This is set
+		 * to `Waiting` and `Woken` with the lock held, and back to `Free` by
+		 * the waiting thread, which may not hold the lock.
+		 */
+		cheriot::atomic<uint32_t> futex;
+	};
+
+	/// Threads blocked on a full heap, with their request sizes.
+	BlockedAllocation blockedAllocations[BlockedAllocationSlots];
+
+	/// The number of records in `blockedAllocations` that are not free.
+	cheriot::atomic<uint32_t> blockedAllocationCount;
+
+	/// The sequence number for the next record in `blockedAllocations`.
+	uint32_t blockedAllocationSequence;
+
+	/**
+	 * Record that the current thread is about to block waiting for `bytes` to
+	 * be freed (or for quota, if `bytes` is zero).  Returns nullptr if all of
+	 * the records are in use.  Must be called with the lock held.
+	 */
+	BlockedAllocation *blocked_allocation_add(size_t bytes)
+	{
+		for (auto &waiter : blockedAllocations)
+		{
+			if (waiter.futex.load() == BlockedAllocation::Free)
+			{
+				waiter.bytes    = bytes;
+				waiter.sequence = blockedAllocationSequence++;
+				waiter.futex    = BlockedAllocation::Waiting;
+				blockedAllocationCount++;
+				return &waiter;
+			}
+		}
+		return nullptr;
+	}
+
+	/**
+	 * Release a record returned by `blocked_allocation_add` once the thread
+	 * has stopped waiting.  This does not require the lock.
+	 */
+	void blocked_allocation_remove(BlockedAllocation *waiter)
+	{
+		waiter->futex = BlockedAllocation::Free;
+		blockedAllocationCount--;
+	}
+
+	/**
+	 * The number of times that allocations have blocked waiting for a
+	 * revocation pass, reported by `heap_statistics`.
+	 */
+	size_t revocationWaits;
+
+	/**
+	 * The number of times that allocations have blocked waiting for memory to
+	 * be freed, reported by `heap_statistics`.
+	 */
+	size_t heapFullWaits;
+
 	/**
 	 * Helper that returns true if the timeout value permits sleeping.
 	 *
@@ -176,6 +642,92 @@ namespace
 		return g.try_lock(timeout);
 	}
 
+	/**
+	 * The operations that are recorded in the allocation trace.  The values
+	 * are the characters used to identify them when the trace is dumped.
+	 */
+	enum class TraceOperation : uint8_t
+	{
+		Allocate = 'a',
+		Free     = 'f',
+	};
+
+#if HEAP_TRACE
+	/**
+	 * A single entry in the allocation trace.
+	 */
+	struct TraceRecord
+	{
+		/// The number of cycles that the operation took, saturating.
+		uint32_t cycles;
+		/// The address of the chunk header.
+		ptraddr_t address;
+		/// The requested size for allocations, the body size for frees.
+		uint32_t size;
+		/// The identifier of the allocator capability used.
+		uint16_t owner;
+		/// The operation that this records.
+		TraceOperation operation;
+	};
+
+	/**
+	 * The number of records in the trace ring buffer.  When the buffer is
+	 * full, new records overwrite the oldest.
+	 */
+	constexpr size_t TraceRecords = 256;
+
+	/// Ring buffer of the most recent allocator operations.
+	TraceRecord traceBuffer[TraceRecords];
+
+	/**
+	 * The number of records written since the trace was last dumped.  The
+	 * next record is written at `traceWritten % TraceRecords`.
+	 */
+	size_t traceWritten;
+#endif
+
+	/**
+	 * Returns the start time for an operation that will be recorded with
+	 * `trace_record`.  This avoids reading the cycle counter if tracing is
+	 * not enabled.
+	 */
+	__always_inline uint64_t trace_start()
+	{
+#if HEAP_TRACE
+		return rdcycle64();
+#else
+		return 0;
+#endif
+	}
+
+	/**
+	 * Append a record to the allocation trace, if tracing is enabled.  This
+	 * must be called with the lock held.
+	 */
+	__always_inline void
+	trace_record([[maybe_unused]] TraceOperation operation,
+	             [[maybe_unused]] MChunkHeader  *chunk,
+	             [[maybe_unused]] size_t         size,
+	             [[maybe_unused]] uint16_t       owner,
+	             [[maybe_unused]] uint64_t       start)
+	{
+#if HEAP_TRACE
+		uint64_t cycles = rdcycle64() - start;
+		traceBuffer[traceWritten++ % TraceRecords] = {
+		  static_cast<uint32_t>(std::min<uint64_t>(cycles, UINT32_MAX)),
+		  Capability{chunk}.address(),
+		  static_cast<uint32_t>(size),
+		  owner,
+		  operation};
+#endif
+	}
+
+	/**
+	 * Perform the frees queued by `heap_free_deferred`.  Defined with the
+	 * queue, below.
+	 */
+	void pending_frees_drain();
+
 	/**
 	 * Wait for the background revoker, if the revoker supports
 	 * interrupt-driven notifications.
@@ -198,7 +750,13 @@ namespace
 		g.unlock();
 		// Wait for the interrupt to fire, then try to reacquire the lock if
 		// the epoch is passed.
-		return r.wait_for_completion(timeout, epoch) && g.try_lock(timeout);
+		if (!r.wait_for_completion(timeout, epoch) || !g.try_lock(timeout))
+		{
+			return false;
+		}
+		// Perform any frees that were queued while we slept.
+		pending_frees_drain();
+		return true;
 	}
 
 	/**
@@ -227,8 +785,16 @@ namespace
 		 * synchronous unit of work (usually one, sometimes two) per tick so
 		 * that we avoid monopolizing the allocator lock.
 		 */
-		while (!r.has_revocation_finished_for_epoch(epoch))
+		// Threads are waiting for this pass, so scan as fast as possible until
+		// the last of them leaves.
+		revocationWaiters++;
+		revoker_pressure_update();
+		while (true)
 		{
+			if (r.has_revocation_finished_for_epoch(epoch))
+			{
+				break;
+			}
 			/*
 			 * If we have finished an epoch and aren't yet done with the target
 			 * epoch, kick off another round of revocation.  The synchronous
@@ -241,52 +807,229 @@ namespace
 				r.system_bg_revoker_kick();
 			}
 
-			if (g.yield(timeout) < 0)
+			// `yield` returns with the lock dropped if it cannot sleep or
+			// cannot reacquire the lock before the timeout expires.
+			g.yield(timeout);
+			if (!g)
 			{
-				/* Unable to sleep; bail out */
+				// The waiter count and the pressure are protected by the
+				// lock, so take it to update them before bailing out, even
+				// though the timeout has expired.  The lock is never held
+				// across a sleep, so this does not wait for long.
+				g.lock();
+				revocationWaiters--;
+				revoker_pressure_update();
+				g.unlock();
 				return false;
 			}
+			// Frees queued while we slept will go into quarantine for the
+			// pass that we are waiting for, so don't leave them queued.
+			pending_frees_drain();
 		}
+		revocationWaiters--;
+		revoker_pressure_update();
 		return true;
 	}
 
 	/**
-	 * Malloc implementation.  Allocates `bytes` bytes of memory.  If `timeout`
-	 * is greater than zero, may block for that many ticks.  If `timeout` is the
-	 * maximum value permitted by the type, may block indefinitely.
-	 *
-	 * Memory is allocated against the quota in `capability`, which must be
-	 * unsealed by the caller.
-	 *
-	 * The lock guard own the lock on entry. It will drop the lock if a
-	 * transient error occurs and attempt to reacquire it. If the lock cannot be
-	 * reacquired during the permitted timeout then this returns nullptr.
-	 *
-	 * If `isSealedAllocation` is true, then the allocation is marked as sealed
-	 * and excluded during `heap_free_all`.
+	 * Returns the number of free bytes in all heap regions.
 	 */
-	void *malloc_internal(size_t                           bytes,
-	                      LockGuard<decltype(lock)>      &&g,
-	                      PrivateAllocatorCapabilityState *capability,
-	                      Timeout                         *timeout,
-	                      bool     isSealedAllocation = false,
-	                      uint32_t flags              = AllocateWaitAny)
+	size_t heap_free_size()
+	{
+		size_t freeSize = 0;
+		for (MState *region : mspaces)
+		{
+			if (region != nullptr)
+			{
+				freeSize += region->heapFreeSize;
+			}
+		}
+		return freeSize;
+	}
+
+	/**
+	 * Returns true if allocating a chunk of `chunkSize` bytes, including its
+	 * header, on behalf of `capability` would leave enough free memory for
+	 * the unused parts of the reservations of all other capabilities.  This
+	 * counts free bytes and so does not account for fragmentation.
+	 */
+	bool reservations_permit(PrivateAllocatorCapabilityState *capability,
+	                         size_t                           chunkSize)
+	{
+		size_t reserved = reservations_unused(capability);
+		if (reserved == 0)
+		{
+			return true;
+		}
+		// Memory in size-class caches is accounted as quarantined, not free,
+		// and so is never counted as available here.
+		size_t freeSize = heap_free_size();
+		return (freeSize >= reserved) && (freeSize - reserved >= chunkSize);
+	}
+
+	/**
+	 * Returns true if the hazard quarantines of all heap regions are empty.
+	 */
+	bool hazard_quarantines_empty()
+	{
+		for (MState *region : mspaces)
+		{
+			if ((region != nullptr) && !region->hazard_quarantine_is_empty())
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Returns the order in which to prefer allocation failures from different
+	 * heap regions when reporting them to `malloc_internal`.  A failure that
+	 * waiting for revocation can fix is better than one that needs any thread
+	 * to free memory, which is better than one that needs the caller's quota
+	 * to be replenished, which is better than one that can never succeed.
+	 */
+	int allocation_failure_rank(const MState::AllocationResult &result)
+	{
+		if (std::holds_alternative<MState::AllocationFailureRevocationNeeded>(
+		      result))
+		{
+			return 3;
+		}
+		if (std::holds_alternative<MState::AllocationFailureHeapFull>(result))
+		{
+			return 2;
+		}
+		if (std::holds_alternative<MState::AllocationFailureQuotaExceeded>(
+		      result))
+		{
+			return 1;
+		}
+		return 0;
+	}
+
+	/**
+	 * Try to allocate `bytes` bytes from each of the heap regions that the
+	 * placement hint in `flags` permits, in order of preference, stopping at
+	 * the first that succeeds.
+	 *
+	 * If none succeeds, returns the failure that gives the caller the best
+	 * chance of succeeding by waiting (see `allocation_failure_rank`).  If
+	 * that failure indicates that revocation is needed, `failedRegion` is set
+	 * to the region whose quarantine holds enough memory.
+	 */
+	__always_inline MState::AllocationResult
+	placement_dispatch(size_t                           bytes,
+	                   PrivateAllocatorCapabilityState *capability,
+	                   bool                             isSealedAllocation,
+	                   uint32_t                         flags,
+	                   MState                         *&failedRegion)
+	{
+		MState::AllocationResult ret = MState::AllocationFailurePermanent{};
+
+		// Memory reserved for other capabilities is not available.  Wait for
+		// memory to be freed, as if the heap were full.
+		if (!reservations_permit(capability, MState::chunk_size(bytes)))
+		{
+			return MState::AllocationFailureHeapFull{};
+		}
+
+		auto tryRegion = [&](MState *region) {
+			// Size-class caches live only in the primary region.
+			auto result = region->mspace_dispatch(
+			  bytes,
+			  capability->quota,
+			  capability->identifier,
+			  isSealedAllocation,
+			  region == gm ? capability->size_class_cache() : nullptr);
+			bool succeeded = std::holds_alternative<Capability<void>>(result);
+			if (succeeded)
+			{
+				reservation_charge(
+				  *capability,
+				  allocation_header(std::get<Capability<void>>(result))
+				    ->size_get());
+			}
+			if (succeeded || (allocation_failure_rank(result) >
+			                  allocation_failure_rank(ret)))
+			{
+				ret          = result;
+				failedRegion = region;
+			}
+			return succeeded;
+		};
+		int preferred = ALLOCATE_PLACEMENT_REGION_GET(flags);
+		if (preferred >= 0)
+		{
+			MState *region = (static_cast<size_t>(preferred) < HeapRegions)
+			                   ? mspaces[preferred]
+			                   : nullptr;
+			if (((region != nullptr) && tryRegion(region)) ||
+			    (flags & AllocatePlacementStrict))
+			{
+				return ret;
+			}
+		}
+		for (int i = 0; i < static_cast<int>(HeapRegions); i++)
+		{
+			if ((i != preferred) && (mspaces[i] != nullptr) &&
+			    tryRegion(mspaces[i]))
+			{
+				break;
+			}
+		}
+		return ret;
+	}
+
+	/**
+	 * Malloc implementation.  Allocates `bytes` bytes of memory.  If `timeout`
+	 * is greater than zero, may block for that many ticks.  If `timeout` is the
+	 * maximum value permitted by the type, may block indefinitely.
+	 *
+	 * Memory is allocated against the quota in `capability`, which must be
+	 * unsealed by the caller.
+	 *
+	 * The lock guard own the lock on entry. It will drop the lock if a
+	 * transient error occurs and attempt to reacquire it. If the lock cannot be
+	 * reacquired during the permitted timeout then this returns nullptr.
+	 *
+	 * If `isSealedAllocation` is true, then the allocation is marked as sealed
+	 * and excluded during `heap_free_all`.
+	 */
+	void *malloc_internal(size_t                           bytes,
+	                      LockGuard<decltype(lock)>      &&g,
+	                      PrivateAllocatorCapabilityState *capability,
+	                      Timeout                         *timeout,
+	                      bool     isSealedAllocation = false,
+	                      uint32_t flags              = AllocateWaitAny)
 	{
 		check_gm();
+		uint64_t start = trace_start();
 
 		do
 		{
-			auto ret = gm->mspace_dispatch(bytes,
-			                               capability->quota,
-			                               capability->identifier,
-			                               isSealedAllocation);
+			// Frees queued while this thread waited for memory or for
+			// revocation may be enough to satisfy the allocation.
+			pending_frees_drain();
+			MState *failedRegion = nullptr;
+			auto    ret          = placement_dispatch(
+			  bytes, capability, isSealedAllocation, flags, failedRegion);
 			if (std::holds_alternative<Capability<void>>(ret))
 			{
-				return std::get<Capability<void>>(ret);
+				Capability<void> allocation = std::get<Capability<void>>(ret);
+				MChunkHeader    *chunk = MChunkHeader::from_body(allocation);
+				capability->owner_index_add(chunk);
+				trace_record(TraceOperation::Allocate,
+				             chunk,
+				             bytes,
+				             capability->identifier,
+				             start);
+				return allocation;
 			}
 			// If the call is non-blocking (`flags` is
 			// `AllocateWaitNone`, or `timeout` is 0), fail now.
-			if (flags == AllocateWaitNone || !may_block(timeout))
+			if (((flags & AllocateWaitAny) == AllocateWaitNone) ||
+			    !may_block(timeout))
 			{
 				return nullptr;
 			}
@@ -307,17 +1050,19 @@ namespace
 				// retry immediately, otherwise yield.
 				//
 				// It may take us several rounds through here to succeed or
-				// discover fragmentation-induced futility, since we do not,
-				// presently, consolidate chunks in quarantine and each chunk
-				// requires individual attention to merge back into the free
-				// pool (and consolidate with neighbors), and each round here
-				// moves at most O(1) chunks out of quarantine.
-				if (!gm->quarantine_dequeue())
+				// discover fragmentation-induced futility, since each round
+				// here moves at most O(1) chunks out of quarantine.  Adjacent
+				// chunks freed in the same epoch are consolidated when they
+				// enter quarantine, but chunks from different epochs require
+				// individual attention to merge back into the free pool (and
+				// consolidate with neighbors).
+				if (!failedRegion->quarantine_dequeue())
 				{
 					Debug::log("Quarantine has enough memory to satisfy "
 					           "allocation, kicking revoker");
 
 					revoker.system_bg_revoker_kick();
+					revocationWaits++;
 
 					if (!wait_for_background_revoker(
 					      timeout, needsRevocation->waitingEpoch, g))
@@ -325,6 +1070,16 @@ namespace
 						return nullptr;
 					}
 				}
+				else if constexpr (IncrementalZeroing)
+				{
+					// Dequeuing may have zeroed a slice of a large chunk.
+					// Let other threads take the lock between slices.
+					g.unlock();
+					if (!reacquire_lock(timeout, g))
+					{
+						return nullptr;
+					}
+				}
 				continue;
 			}
 			// If the heap is full, wait for someone to free an allocation and
@@ -350,22 +1105,40 @@ namespace
 				Debug::log("Not enough free space to handle {}-byte "
 				           "allocation, sleeping",
 				           bytes);
-				// Use the current free space as the sleep futex value.  This
-				// means that the `wait` call will fail if the amount of free
-				// memory changes between dropping the lock and waiting, unless
-				// a matched number of allocations and frees happen (in which
-				// case, we're happy to sleep because we still can't manage
-				// this allocation).
-				auto expected = gm->heapFreeSize;
-				freeFutex     = expected;
+				heapFullWaits++;
+				// Record the size of this allocation, so that frees wake this
+				// thread only if they may have freed enough memory for it.
+				// The record's futex is set with the lock held and so a free
+				// between dropping the lock and waiting makes `wait` return
+				// immediately.
+				auto *waiter =
+				  blocked_allocation_add(isHeapFullFailure ? bytes : 0);
+				// If there are no records left, use the current free space as
+				// the sleep futex value.  This means that the `wait` call will
+				// fail if the amount of free memory changes between dropping
+				// the lock and waiting, unless a matched number of
+				// allocations and frees happen (in which case, we're happy to
+				// sleep because we still can't manage this allocation).
+				auto expected = heap_free_size();
+				if (waiter == nullptr)
+				{
+					freeFutex = expected;
+				}
 				// If there are things on the hazard list, wake after one tick
 				// and see if they have gone away.  Otherwise, wait until we
 				// have some newly freed objects.
-				Timeout t{gm->hazard_quarantine_is_empty() ? timeout->remaining
-				                                           : 1};
+				Timeout t{hazard_quarantines_empty() ? timeout->remaining : 1};
 				// Drop the lock while yielding
 				g.unlock();
-				freeFutex.wait(&t, expected);
+				if (waiter != nullptr)
+				{
+					waiter->futex.wait(&t, BlockedAllocation::Waiting);
+					blocked_allocation_remove(waiter);
+				}
+				else
+				{
+					freeFutex.wait(&t, expected);
+				}
 				timeout->elapse(t.elapsed);
 				Debug::log("Woke from futex wake");
 				if (!reacquire_lock(timeout, g))
@@ -413,6 +1186,183 @@ namespace
 		return state;
 	}
 
+	/**
+	 * A pool of fixed-size slots of `SlotSize` bytes for allocator-internal
+	 * objects.  This avoids the per-object header, and the bin search, of
+	 * allocating each object as a separate chunk.
+	 *
+	 * Slots are carved from slabs, which are chunks in the primary heap
+	 * region that are owned by the allocator itself (owner identifier zero,
+	 * so no allocator capability can free them).  The first slot of each slab
+	 * holds a `SlabHeader` with a bitmap of the free slots.  Slabs are linked
+	 * by their offsets from the start of the heap, in the same encoding as
+	 * claims.  A slab is returned to the heap when it becomes empty, unless
+	 * it is the first in the list, so that a single object being allocated
+	 * and freed repeatedly does not allocate a slab each time.
+	 *
+	 * Slabs are not charged to any quota, so at most `MaxSlabs` exist at a
+	 * time.  Otherwise, a capability that kept one slot in each of many slabs
+	 * could fill the heap with slabs while being charged only for its slots.
+	 *
+	 * Slots are reused immediately, without quarantine.  This is safe only
+	 * for objects that never escape the allocator, so that no capability to
+	 * a slot can outlive its use.
+	 */
+	template<size_t SlotSize, size_t MaxSlabs>
+	class SlabPool
+	{
+		static_assert((SlotSize & MallocAlignMask) == 0,
+		              "Slots must be a multiple of the allocation alignment");
+		static_assert(MaxSlabs <= std::numeric_limits<uint16_t>::max(),
+		              "Slab count must fit in 16 bits");
+
+		/// The header in the first slot of each slab.
+		struct SlabHeader
+		{
+			/// Bitmap of free slots.  Slot 0, the header, is never free.
+			uint32_t freeMap;
+			/// The encoded offset of the next slab, zero for the last.
+			uint16_t next;
+		};
+		static_assert(sizeof(SlabHeader) <= SlotSize);
+
+		/// The number of slots in a slab, one for each bit in `freeMap`.
+		static constexpr size_t Slots = utils::bytes2bits(sizeof(uint32_t));
+
+		/// The size of a slab.
+		static constexpr size_t SlabSize = Slots * SlotSize;
+
+		/// The free map for a slab with no allocated slots.
+		static constexpr uint32_t AllFree = ~uint32_t(1);
+
+		/// The encoded offset of the first slab, zero if there are none.
+		uint16_t slabs;
+
+		/// The number of slabs in the list starting at `slabs`.
+		uint16_t slabCount;
+
+		/**
+		 * Returns a capability to the slab at `encoded`, derived from the
+		 * heap capability and bounded to the slab.
+		 */
+		static Capability<SlabHeader> slab_decode(uint16_t encoded)
+		{
+			Capability<SlabHeader> slab{gm->heapStart.cast<SlabHeader>()};
+			slab.address() += encoded << MallocAlignShift;
+			slab.bounds() = SlabSize;
+			return slab;
+		}
+
+		/**
+		 * Returns the encoded offset of `slab`, which must be in the
+		 * primary heap region.
+		 */
+		static uint16_t slab_encode(Capability<SlabHeader> slab)
+		{
+			ptraddr_t offset = slab.address() - gm->heapStart.address();
+			Debug::Assert(
+			  (offset >> MallocAlignShift) <=
+			    std::numeric_limits<uint16_t>::max(),
+			  "Slab at offset {} cannot be encoded",
+			  offset);
+			return offset >> MallocAlignShift;
+		}
+
+		public:
+		/**
+		 * Allocate a slot on behalf of `capability`.  Returns a capability
+		 * bounded to the slot, or nullptr if there is no free slot and a new
+		 * slab cannot be allocated immediately.  A new slab must not eat into
+		 * the reservations of other capabilities.  The contents of the slot
+		 * are undefined.
+		 */
+		Capability<void> allocate(PrivateAllocatorCapabilityState &capability)
+		{
+			Capability<SlabHeader> slab;
+			for (uint16_t encoded = slabs; encoded != 0; encoded = slab->next)
+			{
+				slab = slab_decode(encoded);
+				if (slab->freeMap != 0)
+				{
+					break;
+				}
+			}
+			if ((slab == nullptr) || (slab->freeMap == 0))
+			{
+				if (slabCount == MaxSlabs)
+				{
+					Debug::log<DebugLevel::Warning>(
+					  "Slab pool is at its limit of {} slabs", MaxSlabs);
+					return nullptr;
+				}
+				if (!reservations_permit(&capability,
+				                         MState::chunk_size(SlabSize)))
+				{
+					return nullptr;
+				}
+				// Slabs are not charged to any quota: each slot is charged
+				// to the capability on whose behalf it is allocated.
+				size_t unlimited = std::numeric_limits<size_t>::max();
+				auto   space = gm->mspace_dispatch(SlabSize, unlimited, 0);
+				if (!std::holds_alternative<Capability<void>>(space))
+				{
+					return nullptr;
+				}
+				slab = slab_decode(slab_encode(
+				  std::get<Capability<void>>(space).cast<SlabHeader>()));
+				slab->freeMap = AllFree;
+				slab->next    = slabs;
+				slabs         = slab_encode(slab);
+				slabCount++;
+			}
+			size_t index = ctz(slab->freeMap);
+			slab->freeMap &= ~(uint32_t(1) << index);
+			Capability<void> slot{slab.cast<void>()};
+			slot.address() += index * SlotSize;
+			slot.bounds() = SlotSize;
+			return slot;
+		}
+
+		/**
+		 * Return a slot that was allocated with `allocate` to the pool.
+		 */
+		void free(void *object)
+		{
+			ptraddr_t address = Capability{object}.address();
+			uint16_t *link    = &slabs;
+			while (*link != 0)
+			{
+				auto      slab = slab_decode(*link);
+				ptraddr_t base = slab.address();
+				if ((address < base) || (address >= base + SlabSize))
+				{
+					link = &slab->next;
+					continue;
+				}
+				size_t index = (address - base) / SlotSize;
+				Debug::Assert((index != 0) &&
+				                !(slab->freeMap & (uint32_t(1) << index)),
+				              "Freeing slot {} of slab {}, which is not in use",
+				              index,
+				              slab);
+				slab->freeMap |= uint32_t(1) << index;
+				if ((slab->freeMap == AllFree) && (link != &slabs))
+				{
+					// The slab capability is bounded to the body, so derive
+					// the header from the heap capability.
+					*link = slab->next;
+					slabCount--;
+					Capability<void> heap{gm->heapStart};
+					heap.address() = base;
+					auto *chunk    = MChunkHeader::from_body(heap);
+					gm->mspace_free(*chunk, MState::chunk_body_size(*chunk));
+				}
+				return;
+			}
+			Debug::Assert(false, "Freeing {}, which is not in a slab", object);
+		}
+	};
+
 	/**
 	 * Object representing a claim.  When a heap object is claimed, an instance
 	 * of this structure exists to track the reference count per claimer.
@@ -474,6 +1424,35 @@ namespace
 			return encodedNext;
 		}
 
+		/**
+		 * Returns true if this is not a claim but a marker that stands in for
+		 * the list of claims on a chunk whose claims are in a `ClaimIndex`.
+		 * Markers have no owner.
+		 */
+		[[nodiscard]] bool is_index_marker() const
+		{
+			return allocatorIdentifier == 0;
+		}
+
+		/**
+		 * Returns the encoded offset of the claim index that this marker
+		 * refers to.  Markers do not need a reference count and so store the
+		 * offset in its place.
+		 */
+		[[nodiscard]] uint16_t index_get() const
+		{
+			return referenceCount;
+		}
+
+		/**
+		 * Set the encoded offset of the claim index that this marker refers
+		 * to.
+		 */
+		void index_set(uint16_t encodedIndex)
+		{
+			referenceCount = encodedIndex;
+		}
+
 		/**
 		 * Claims list iterator.  This wraps a next pointer and so can be used
 		 * both to inspect a value and update it.
@@ -559,39 +1538,37 @@ namespace
 
 		/**
 		 * Allocate a new claim.  This will fail if space is not immediately
-		 * available.
+		 * available.  Claims are allocated from `claimPool`, whose slabs are
+		 * in the primary heap region, so that they can be encoded as offsets
+		 * from its start.  The capability is charged for the claim's slot.
 		 *
 		 * Returns a pointer to the new allocation on success, nullptr on
 		 * failure.
 		 */
 		static Claim *create(PrivateAllocatorCapabilityState &capability,
-		                     uint16_t                         next)
-		{
-			auto space = gm->mspace_dispatch(
-			  sizeof(Claim), capability.quota, capability.identifier);
-			if (!std::holds_alternative<Capability<void>>(space))
-			{
-				return nullptr;
-			}
-			return new (std::get<Capability<void>>(space))
-			  Claim(capability.identifier, next);
-		}
+		                     uint16_t                         next);
 
 		/**
 		 * Destroy a claim, which must have been allocated with `capability`.
+		 * Claims never escape the allocator and so their slots are reused
+		 * without quarantine.
 		 */
 		static void destroy(PrivateAllocatorCapabilityState &capability,
-		                    Claim                           *claim)
-		{
-			Capability heap{gm->heapStart};
-			heap.address() = Capability{claim}.address();
-			auto chunk     = MChunkHeader::from_body(heap);
-			capability.quota += chunk->size_get();
-			// We could skip quarantine for these objects, since we know that
-			// they haven't escaped, but they're small so it's probably not
-			// worthwhile.
-			gm->mspace_free(*chunk, sizeof(Claim));
-		}
+		                    Claim                           *claim);
+
+		/**
+		 * Allocate a marker for the claim index at the encoded offset
+		 * `encodedIndex`, on behalf of `capability`.  Markers are not charged
+		 * to any quota.  Returns nullptr on failure.
+		 */
+		static Claim *
+		create_index_marker(PrivateAllocatorCapabilityState &capability,
+		                    uint16_t                         encodedIndex);
+
+		/**
+		 * Destroy a marker allocated with `create_index_marker`.
+		 */
+		static void destroy_index_marker(Claim *marker);
 
 		/**
 		 * Add a reference.  If this would overflow, the reference is pinned
@@ -655,13 +1632,310 @@ namespace
 	static_assert(sizeof(Claim) <= (1 << MallocAlignShift),
 	              "Claims should fit in the smallest possible allocation");
 
+	/// The pool from which claims are allocated.
+	SlabPool<MallocAlignment, ClaimPoolSlabs> claimPool;
+
+	Claim *Claim::create(PrivateAllocatorCapabilityState &capability,
+	                     uint16_t                         next)
+	{
+		if (capability.quota < MallocAlignment)
+		{
+			return nullptr;
+		}
+		Capability<void> slot = claimPool.allocate(capability);
+		if (slot == nullptr)
+		{
+			return nullptr;
+		}
+		capability.quota -= MallocAlignment;
+		return new (slot) Claim(capability.identifier, next);
+	}
+
+	void Claim::destroy(PrivateAllocatorCapabilityState &capability,
+	                    Claim                           *claim)
+	{
+		capability.quota += MallocAlignment;
+		claimPool.free(claim);
+	}
+
+	Claim *
+	Claim::create_index_marker(PrivateAllocatorCapabilityState &capability,
+	                           uint16_t                         encodedIndex)
+	{
+		Capability<void> slot = claimPool.allocate(capability);
+		if (slot == nullptr)
+		{
+			return nullptr;
+		}
+		auto *marker = new (slot) Claim(0, 0);
+		marker->index_set(encodedIndex);
+		return marker;
+	}
+
+	void Claim::destroy_index_marker(Claim *marker)
+	{
+		claimPool.free(marker);
+	}
+
 	/**
-	 * Find a claim if one exists.  Returns a reference to the next pointer
-	 * that refers to this claim.
+	 * An index of the claims on a heavily shared chunk, sorted by owner so
+	 * that a claim can be found with a binary search rather than by walking
+	 * the list.  Chunks start with a list of claims (the compact encoding in
+	 * `MChunkHeader::claims`) and are converted to an index when the list
+	 * reaches `ClaimIndexThreshold` claims.  The chunk's `claims` field then
+	 * refers to a marker (see `Claim::is_index_marker`) that refers to the
+	 * index.  The chunk returns to the compact encoding when its last claim
+	 * is dropped.
+	 *
+	 * Indexes are chunks in the primary heap region owned by the allocator
+	 * itself, like claim slabs.  They are not charged to a quota because
+	 * their size is bounded by the number of claims, which are.
 	 */
-	std::pair<uint16_t &, Claim *> claim_find(uint16_t      owner,
-	                                          MChunkHeader &chunk)
+	struct ClaimIndex
 	{
+		/// An entry in the index.
+		struct Entry
+		{
+			/// The owner of the claim.
+			uint16_t owner;
+			/// The encoded offset of the claim.
+			uint16_t claim;
+		};
+
+		/// The number of entries in use.
+		uint16_t count;
+		/// The number of entries that the index has space for.
+		uint16_t capacity;
+
+		/// Returns the entries, which follow the header.
+		Entry *entries()
+		{
+			return reinterpret_cast<Entry *>(this + 1);
+		}
+
+		/**
+		 * Returns the position of the first entry whose owner is not less
+		 * than `owner`.
+		 */
+		size_t lower_bound(uint16_t owner)
+		{
+			size_t low  = 0;
+			size_t high = count;
+			while (low < high)
+			{
+				size_t middle = (low + high) / 2;
+				if (entries()[middle].owner < owner)
+				{
+					low = middle + 1;
+				}
+				else
+				{
+					high = middle;
+				}
+			}
+			return low;
+		}
+
+		/**
+		 * Returns the claim owned by `owner`, or nullptr if there is none.
+		 * Sets `position` to the position of its entry.
+		 */
+		Claim *find(uint16_t owner, size_t &position)
+		{
+			position = lower_bound(owner);
+			if ((position < count) && (entries()[position].owner == owner))
+			{
+				return Claim::from_encoded_offset(entries()[position].claim);
+			}
+			return nullptr;
+		}
+
+		/**
+		 * Insert `claim`, which must not already be present.  There must be
+		 * space for another entry.
+		 */
+		void insert(Claim *claim)
+		{
+			size_t position = lower_bound(claim->owner());
+			for (size_t i = count; i > position; i--)
+			{
+				entries()[i] = entries()[i - 1];
+			}
+			entries()[position] = {claim->owner(), claim->encode_address()};
+			count++;
+		}
+
+		/// Remove the entry at `position`.
+		void remove(size_t position)
+		{
+			count--;
+			for (size_t i = position; i < count; i++)
+			{
+				entries()[i] = entries()[i + 1];
+			}
+		}
+	};
+
+	/**
+	 * The number of claims on a chunk at which its list of claims is
+	 * converted to a `ClaimIndex`.  Below this, walking the list is as fast
+	 * as a binary search and needs no extra memory.
+	 */
+	constexpr size_t ClaimIndexThreshold = 4;
+
+	/// The number of entries in a newly created `ClaimIndex`.
+	constexpr uint16_t ClaimIndexInitialCapacity = 4 * ClaimIndexThreshold;
+
+	/**
+	 * Returns the claim index at the encoded offset `encoded`, bounded to
+	 * the chunk that holds it.
+	 */
+	ClaimIndex *claim_index_decode(uint16_t encoded)
+	{
+		Capability<void> heap{gm->heapStart};
+		heap.address() += encoded << MallocAlignShift;
+		auto                  *header = MChunkHeader::from_body(heap);
+		Capability<ClaimIndex> index{heap.cast<ClaimIndex>()};
+		index.bounds() = MState::chunk_body_size(*header);
+		return index;
+	}
+
+	/**
+	 * Returns the encoded offset of a claim index, in the same encoding as
+	 * claims.
+	 */
+	uint16_t claim_index_encode(ClaimIndex *index)
+	{
+		return (Capability{index}.address() - gm->heapStart.address()) >>
+		       MallocAlignShift;
+	}
+
+	/**
+	 * Allocate an empty claim index with space for `capacity` entries, on
+	 * behalf of `capability`.  Returns nullptr if this cannot be done
+	 * immediately or would eat into the reservations of other capabilities.
+	 */
+	ClaimIndex *
+	claim_index_allocate(PrivateAllocatorCapabilityState &capability,
+	                     uint16_t                         capacity)
+	{
+		size_t bytes =
+		  sizeof(ClaimIndex) + capacity * sizeof(ClaimIndex::Entry);
+		if (!reservations_permit(&capability, MState::chunk_size(bytes)))
+		{
+			return nullptr;
+		}
+		size_t unlimited = std::numeric_limits<size_t>::max();
+		auto   space     = gm->mspace_dispatch(bytes, unlimited, 0);
+		if (!std::holds_alternative<Capability<void>>(space))
+		{
+			return nullptr;
+		}
+		auto *index     = std::get<Capability<void>>(space).cast<ClaimIndex>();
+		index->count    = 0;
+		index->capacity = capacity;
+		return index;
+	}
+
+	/**
+	 * Free a claim index.
+	 */
+	void claim_index_free(ClaimIndex *index)
+	{
+		Capability<void> heap{gm->heapStart};
+		heap.address() = Capability{index}.address();
+		auto *chunk    = MChunkHeader::from_body(heap);
+		gm->mspace_free(*chunk, MState::chunk_body_size(*chunk));
+	}
+
+	/**
+	 * Returns the claim index for `chunk` if its claims are indexed, nullptr
+	 * if they are in a list.  If `marker` is not null, it is set to the
+	 * marker that refers to the index.
+	 */
+	ClaimIndex *claim_index_get(MChunkHeader &chunk, Claim **marker = nullptr)
+	{
+		Claim *head = Claim::from_encoded_offset(chunk.claims);
+		if ((head == nullptr) || !head->is_index_marker())
+		{
+			return nullptr;
+		}
+		if (marker != nullptr)
+		{
+			*marker = head;
+		}
+		return claim_index_decode(head->index_get());
+	}
+
+	/**
+	 * Convert the list of claims on `chunk` to an index, on behalf of
+	 * `capability`.  Returns the index, or nullptr (leaving the list
+	 * unmodified) if there is not enough memory.
+	 */
+	ClaimIndex *claim_index_create(PrivateAllocatorCapabilityState &capability,
+	                               MChunkHeader                    &chunk)
+	{
+		ClaimIndex *index =
+		  claim_index_allocate(capability, ClaimIndexInitialCapacity);
+		if (index == nullptr)
+		{
+			return nullptr;
+		}
+		Claim *marker =
+		  Claim::create_index_marker(capability, claim_index_encode(index));
+		if (marker == nullptr)
+		{
+			claim_index_free(index);
+			return nullptr;
+		}
+		for (Claim::Iterator i{&chunk.claims}, end; i != end; ++i)
+		{
+			index->insert(*i);
+		}
+		chunk.claims = marker->encode_address();
+		return index;
+	}
+
+	/**
+	 * Add `claim`, which was made with `capability`, to the index referred to
+	 * by `marker`, growing the index if it is full.  Returns false if there
+	 * is not enough memory to grow it.
+	 */
+	bool claim_index_insert(PrivateAllocatorCapabilityState &capability,
+	                        Claim                           *marker,
+	                        ClaimIndex                      *index,
+	                        Claim                           *claim)
+	{
+		if (index->count == index->capacity)
+		{
+			ClaimIndex *grown =
+			  claim_index_allocate(capability, index->capacity * 2);
+			if (grown == nullptr)
+			{
+				return false;
+			}
+			for (size_t i = 0; i < index->count; i++)
+			{
+				grown->entries()[i] = index->entries()[i];
+			}
+			grown->count = index->count;
+			claim_index_free(index);
+			marker->index_set(claim_index_encode(grown));
+			index = grown;
+		}
+		index->insert(claim);
+		return true;
+	}
+
+	/**
+	 * Find a claim in the list of claims on `chunk`, which must not be
+	 * indexed.  Returns a reference to the next pointer that refers to this
+	 * claim, and sets `length` to the number of claims that were visited.
+	 */
+	std::pair<uint16_t &, Claim *>
+	claim_list_find(uint16_t owner, MChunkHeader &chunk, size_t &length)
+	{
+		length = 0;
 		for (Claim::Iterator i{&chunk.claims}, end; i != end; ++i)
 		{
 			Claim *claim = *i;
@@ -669,10 +1943,25 @@ namespace
 			{
 				return {*i.pointer(), claim};
 			}
+			length++;
 		}
 		return {chunk.claims, nullptr};
 	}
 
+	/**
+	 * Find the claim on `chunk` owned by `owner`, if one exists.
+	 */
+	Claim *claim_find(uint16_t owner, MChunkHeader &chunk)
+	{
+		if (ClaimIndex *index = claim_index_get(chunk))
+		{
+			size_t position;
+			return index->find(owner, position);
+		}
+		size_t length;
+		return claim_list_find(owner, chunk, length).second;
+	}
+
 	/**
 	 * Add a claim to a chunk, owned by `owner`.  This returns true if the
 	 * claim was successfully added, false otherwise.
@@ -680,7 +1969,23 @@ namespace
 	bool claim_add(PrivateAllocatorCapabilityState &owner, MChunkHeader &chunk)
 	{
 		Debug::log("Adding claim for {}", owner.identifier);
-		auto [next, claim] = claim_find(owner.identifier, chunk);
+		Claim      *marker = nullptr;
+		ClaimIndex *index  = claim_index_get(chunk, &marker);
+		Claim      *claim;
+		size_t      length   = 0;
+		uint16_t   *next     = &chunk.claims;
+		size_t      position = 0;
+		if (index != nullptr)
+		{
+			claim = index->find(owner.identifier, position);
+		}
+		else
+		{
+			auto [link, found] =
+			  claim_list_find(owner.identifier, chunk, length);
+			next  = &link;
+			claim = found;
+		}
 		if (claim)
 		{
 			Debug::log("Adding second claim");
@@ -698,7 +2003,22 @@ namespace
 			}
 			owner.quota -= size;
 		}
-		claim = Claim::create(owner, next);
+		// Convert long lists to an index.  If that fails, keep the list.
+		if ((index == nullptr) && (length >= ClaimIndexThreshold))
+		{
+			index = claim_index_create(owner, chunk);
+			if (index != nullptr)
+			{
+				marker = Claim::from_encoded_offset(chunk.claims);
+			}
+		}
+		claim = Claim::create(owner, (index == nullptr) ? *next : 0);
+		if ((claim != nullptr) && (index != nullptr) &&
+		    !claim_index_insert(owner, marker, index, claim))
+		{
+			Claim::destroy(owner, claim);
+			claim = nullptr;
+		}
 		if (claim != nullptr)
 		{
 			Debug::log("Allocated new claim");
@@ -708,8 +2028,13 @@ namespace
 			{
 				chunk.ownerID = 0;
 				claim->reference_add();
+				reservation_refund(owner, size);
+			}
+			if (index == nullptr)
+			{
+				*next = claim->encode_address();
 			}
-			next = claim->encode_address();
+			owner.owner_index_add(&chunk);
 			return true;
 		}
 		// If we failed to allocate the claim object, undo adding this to our
@@ -734,7 +2059,23 @@ namespace
 	{
 		Debug::log(
 		  "Trying to drop claim with {} ({})", owner.identifier, &owner);
-		auto [next, claim] = claim_find(owner.identifier, chunk);
+		Claim      *marker = nullptr;
+		ClaimIndex *index  = claim_index_get(chunk, &marker);
+		Claim      *claim;
+		uint16_t   *next     = &chunk.claims;
+		size_t      position = 0;
+		if (index != nullptr)
+		{
+			claim = index->find(owner.identifier, position);
+		}
+		else
+		{
+			size_t length;
+			auto [link, found] =
+			  claim_list_find(owner.identifier, chunk, length);
+			next  = &link;
+			claim = found;
+		}
 		// If there is no claim, fail.
 		if (claim == nullptr)
 		{
@@ -748,7 +2089,21 @@ namespace
 		// away, destroy this claim structure.
 		if (claim->reference_remove())
 		{
-			next        = claim->encoded_next();
+			if (index == nullptr)
+			{
+				*next = claim->encoded_next();
+			}
+			else
+			{
+				index->remove(position);
+				// Return to the compact encoding once the last claim is gone.
+				if (index->count == 0)
+				{
+					claim_index_free(index);
+					Claim::destroy_index_marker(marker);
+					chunk.claims = 0;
+				}
+			}
 			size_t size = chunk.size_get();
 			owner.quota += size;
 			Claim::destroy(owner, claim);
@@ -778,6 +2133,7 @@ namespace
 		// If this is a precise allocation, see if we can free it as the
 		// original owner.  You may drop claims with a capability that is a
 		// subset of the original but you may not free an object with a subset.
+		MState *region = region_for(Capability{&chunk}.address());
 		if (isPrecise && (chunk.owner() == owner.identifier))
 		{
 			if (!reallyFree)
@@ -788,11 +2144,22 @@ namespace
 			chunk.ownerID    = 0;
 			if (chunk.claims == 0)
 			{
-				int ret = gm->mspace_free(chunk, bodySize);
+				uint64_t start = trace_start();
+				int      ret   = region->mspace_free(
+				  chunk,
+				  bodySize,
+				  false,
+				  region == gm ? owner.size_class_cache(true) : nullptr);
 				// If free fails, don't manipulate the quota.
 				if (ret == 0)
 				{
 					owner.quota += chunkSize;
+					reservation_refund(owner, chunkSize);
+					trace_record(TraceOperation::Free,
+					             &chunk,
+					             bodySize,
+					             owner.identifier,
+					             start);
 				}
 				return ret;
 			}
@@ -800,6 +2167,7 @@ namespace
 			// free won't happen until the last claim goes away, but this is no
 			// longer the owner's responsibility.
 			owner.quota += chunkSize;
+			reservation_refund(owner, chunkSize);
 			return 0;
 		}
 		// If this is an interior (but valid) pointer, see if we can drop a
@@ -808,13 +2176,52 @@ namespace
 		{
 			if ((chunk.claims == 0) && (chunk.ownerID == 0))
 			{
-				return gm->mspace_free(chunk, bodySize);
+				uint64_t start = trace_start();
+				int      ret   = region->mspace_free(chunk, bodySize);
+				if (ret == 0)
+				{
+					trace_record(TraceOperation::Free,
+					             &chunk,
+					             bodySize,
+					             owner.identifier,
+					             start);
+				}
+				return ret;
 			}
 			return 0;
 		}
 		return -EPERM;
 	}
 
+	/**
+	 * Free `rawPointer` (or drop a claim on it) with an already-unsealed
+	 * allocator capability.  See `heap_free_chunk` for the meaning of
+	 * `reallyFree`.
+	 */
+	int heap_free_pointer(PrivateAllocatorCapabilityState &capability,
+	                      void                            *rawPointer,
+	                      bool                             reallyFree)
+	{
+		Capability<void> mem{rawPointer};
+		if (!mem.is_valid())
+		{
+			return -EINVAL;
+		}
+		check_gm();
+		// Find the chunk that corresponds to this allocation.
+		auto *chunk = allocation_start(mem.address());
+		if (!chunk)
+		{
+			return -EINVAL;
+		}
+		ptraddr_t start    = chunk->body().address();
+		size_t    bodySize = MState::chunk_body_size(*chunk);
+		// Is the pointer that we're freeing a pointer to the entire allocation?
+		bool isPrecise = (start == mem.base()) && (bodySize == mem.length());
+		return heap_free_chunk(
+		  capability, *chunk, bodySize, isPrecise, reallyFree);
+	}
+
 	__noinline int heap_free_internal(AllocatorCapability heapCapability,
 	                                  void               *rawPointer,
 	                                  bool                reallyFree)
@@ -826,24 +2233,319 @@ namespace
 			                                heapCapability);
 			return -EPERM;
 		}
-		Capability<void> mem{rawPointer};
-		if (!mem.is_valid())
+		return heap_free_pointer(*capability, rawPointer, reallyFree);
+	}
+
+	/**
+	 * Returns the chunk for `mem` if it is a valid pointer to the whole of an
+	 * unsealed allocation owned by `capability`, null otherwise.  Used to
+	 * validate the argument to `heap_reallocate`.
+	 */
+	MChunkHeader *
+	reallocation_chunk(PrivateAllocatorCapabilityState &capability,
+	                   Capability<void>                 mem)
+	{
+		if (!mem.is_valid() || mem.is_sealed())
+		{
+			return nullptr;
+		}
+		auto *chunk = allocation_start(mem.address());
+		if ((chunk == nullptr) || chunk->isSealedObject ||
+		    MState::is_quarantined(chunk) ||
+		    (chunk->owner() != capability.identifier))
+		{
+			return nullptr;
+		}
+		bool isPrecise = (chunk->body().address() == mem.base()) &&
+		                 (MState::chunk_body_size(*chunk) == mem.length());
+		return isPrecise ? chunk : nullptr;
+	}
+
+	/**
+	 * Returns true if `chunk` is a live chunk that is owned or claimed by
+	 * `capability`.
+	 */
+	bool chunk_is_held_by(PrivateAllocatorCapabilityState &capability,
+	                      MChunkHeader                    &chunk)
+	{
+		return chunk.is_in_use() && !MState::is_quarantined(&chunk) &&
+		       ((chunk.ownerID == capability.identifier) ||
+		        (claim_find(capability.identifier, chunk) != nullptr));
+	}
+
+	/**
+	 * Free every chunk owned by `capability`, and drop a claim on every chunk
+	 * that it has claimed, for chunks whose headers are between `start` and
+	 * `end`.  Sealed objects are skipped.  The walk begins at `chunk`, which
+	 * must be the header of the chunk that contains `start`.
+	 *
+	 * Returns the number of bytes freed.  Sets `retained` to true if any chunk
+	 * in the range is still owned or claimed by `capability` afterwards.
+	 */
+	ssize_t heap_free_range(PrivateAllocatorCapabilityState &capability,
+	                        MChunkHeader                    *chunk,
+	                        ptraddr_t                        start,
+	                        ptraddr_t                        end,
+	                        bool                            &retained)
+	{
+		ssize_t       freed = 0;
+		MChunkHeader *prev  = chunk->cell_prev();
+		while (Capability{chunk}.address() < end)
+		{
+			if ((Capability{chunk}.address() >= start) && chunk->is_in_use() &&
+			    !MState::is_quarantined(chunk))
+			{
+				if (!chunk->isSealedObject)
+				{
+					auto   size     = chunk->size_get();
+					size_t bodySize = MState::chunk_body_size(*chunk);
+					if (heap_free_chunk(capability, *chunk, bodySize) == 0)
+					{
+						freed += size;
+					}
+				}
+				// A freed chunk may have been merged into its predecessor in
+				// quarantine, leaving a zeroed header.
+				if ((chunk->size_get() != 0) &&
+				    chunk_is_held_by(capability, *chunk))
+				{
+					retained = true;
+				}
+			}
+			MChunkHeader *current = (chunk->size_get() == 0) ? prev : chunk;
+			prev                  = current;
+			chunk                 = current->cell_next();
+		}
+		return freed;
+	}
+
+	/**
+	 * Debug cross-check for the owner index.  Walks the entire heap and checks
+	 * that every chunk that is owned or claimed by `capability` is in one of
+	 * the owner-index regions in `regions`.
+	 */
+	void owner_index_check(PrivateAllocatorCapabilityState &capability,
+	                       uint64_t                         regions)
+	{
+		for (MState *region : mspaces)
+		{
+			if (region == nullptr)
+			{
+				continue;
+			}
+			auto      chunk   = region->heapStart.cast<MChunkHeader>();
+			ptraddr_t heapEnd = chunk.top();
+			do
+			{
+				if (chunk_is_held_by(capability, *chunk))
+				{
+					Debug::Assert((regions >> owner_index_bit(chunk)) & 1,
+					              "Chunk {} held by {} is missing from the "
+					              "owner index",
+					              chunk,
+					              capability.identifier);
+				}
+				chunk = static_cast<MChunkHeader *>(chunk->cell_next());
+			} while (chunk.address() < heapEnd);
+		}
+	}
+
+	/**
+	 * Wake threads that are blocked waiting for memory to be freed.  Threads
+	 * with a record in `blockedAllocations` are woken, longest-waiting first,
+	 * only while the free and quarantined space could satisfy all of the
+	 * threads woken so far, so freeing a small object does not wake every
+	 * waiter only for most of them to fail and sleep again.  A woken thread
+	 * waits for revocation if it needs quarantined memory.  This is a
+	 * heuristic: fragmentation may still prevent a woken thread from
+	 * allocating.  Threads are not
+	 * ordered by priority, but the scheduler runs the highest-priority woken
+	 * thread first.
+	 */
+	void wake_blocked_allocators()
+	{
+		if (freeFutex != -1)
+		{
+			Debug::log("Some threads are blocking on allocations, waking them");
+			freeFutex = -1;
+			freeFutex.notify_all();
+		}
+		if (blockedAllocationCount == 0)
+		{
+			return;
+		}
+		size_t budget = heap_free_size();
+		for (MState *region : mspaces)
+		{
+			if (region != nullptr)
+			{
+				budget += region->heapQuarantineSize;
+			}
+		}
+		while (true)
+		{
+			BlockedAllocation *oldest = nullptr;
+			for (auto &waiter : blockedAllocations)
+			{
+				if ((waiter.futex.load() == BlockedAllocation::Waiting) &&
+				    (waiter.bytes <= budget) &&
+				    ((oldest == nullptr) ||
+				     (static_cast<int32_t>(waiter.sequence -
+				                           oldest->sequence) < 0)))
+				{
+					oldest = &waiter;
+				}
+			}
+			if (oldest == nullptr)
+			{
+				return;
+			}
+			// The thread may have timed out and released its record since
+			// the check above, in which case there is nothing to wake.
+			uint32_t expected = BlockedAllocation::Waiting;
+			if (oldest->futex.compare_exchange_strong(
+			      expected, BlockedAllocation::Woken))
+			{
+				Debug::log("Waking thread blocked on a {}-byte allocation",
+				           oldest->bytes);
+				budget -= oldest->bytes;
+				oldest->futex.notify_one();
+			}
+		}
+	}
+
+	/**
+	 * Histogram of the number of cycles taken by successful calls to
+	 * `heap_allocate`, reported by `heap_statistics`.
+	 */
+	uint32_t allocateCycles[HEAP_STATISTICS_HISTOGRAM_BUCKETS];
+
+	/**
+	 * Histogram of the number of cycles taken by successful calls to
+	 * `heap_free`, reported by `heap_statistics`.
+	 */
+	uint32_t freeCycles[HEAP_STATISTICS_HISTOGRAM_BUCKETS];
+
+	/**
+	 * Record an operation that started at cycle `start` in `histogram`.
+	 * Buckets are powers of two, as described for `HeapStatistics`, and
+	 * saturate rather than wrapping.  Must be called with the lock held.
+	 */
+	void histogram_record(uint32_t *histogram, uint64_t start)
+	{
+		uint64_t cycles = rdcycle64() - start;
+		size_t   bucket = 0;
+		if (cycles >= (1U << HEAP_STATISTICS_HISTOGRAM_SHIFT))
+		{
+			bucket = std::min<size_t>(63 - __builtin_clzll(cycles) -
+			                            HEAP_STATISTICS_HISTOGRAM_SHIFT + 1,
+			                          HEAP_STATISTICS_HISTOGRAM_BUCKETS - 1);
+		}
+		if (histogram[bucket] != UINT32_MAX)
+		{
+			histogram[bucket]++;
+		}
+	}
+
+	/**
+	 * A free queued by `heap_free_deferred` because the allocator lock was
+	 * held by another thread.
+	 */
+	struct PendingFree
+	{
+		/// The (sealed) capability to free with.
+		AllocatorCapability heapCapability;
+		/// The pointer to free.
+		void *pointer;
+	};
+
+	/**
+	 * Ring of frees that have not yet been performed, drained by the next
+	 * thread to acquire the allocator lock in an allocation, free, or
+	 * quarantine operation, and by threads that are waiting for memory or for
+	 * the revoker each time that they reacquire the lock.
+	 */
+	PendingFree pendingFrees[PendingFreeSlots];
+
+	/// The index of the oldest entry in `pendingFrees`.
+	size_t pendingFreeHead;
+
+	/// The number of entries in `pendingFrees`.
+	size_t pendingFreeCount;
+
+	/**
+	 * The number of frees that have been queued in `pendingFrees`, reported
+	 * by `heap_statistics`.
+	 */
+	size_t deferredFrees;
+
+	/**
+	 * Lock protecting `pendingFrees`.  This is held only while adding or
+	 * removing a single entry and so may be acquired with or without the
+	 * allocator lock held, but the allocator lock must never be acquired
+	 * while holding it.
+	 */
+	FlagLockPriorityInherited pendingFreeLock;
+
+	/**
+	 * Add a free to `pendingFrees`.  Returns false if the queue is full.
+	 */
+	bool pending_free_push(AllocatorCapability heapCapability, void *pointer)
+	{
+		LockGuard g{pendingFreeLock};
+		if (pendingFreeCount == PendingFreeSlots)
+		{
+			return false;
+		}
+		size_t tail = (pendingFreeHead + pendingFreeCount) % PendingFreeSlots;
+		pendingFrees[tail] = {heapCapability, pointer};
+		pendingFreeCount++;
+		deferredFrees++;
+		return true;
+	}
+
+	/**
+	 * Perform the frees in `pendingFrees`, waking any threads blocked on
+	 * allocations if one succeeds.  At most `PendingFreeSlots` entries are
+	 * processed, so that threads that keep queueing frees cannot hold up the
+	 * caller indefinitely.  Must be called with the allocator lock held.
+	 *
+	 * Errors are not reported to the thread that queued the free.
+	 */
+	void pending_frees_drain()
+	{
+		bool freed = false;
+		for (size_t i = 0; i < PendingFreeSlots; i++)
 		{
-			return -EINVAL;
+			PendingFree pending;
+			{
+				LockGuard g{pendingFreeLock};
+				if (pendingFreeCount == 0)
+				{
+					break;
+				}
+				pending = pendingFrees[pendingFreeHead];
+				// Don't keep the object reachable from the queue.
+				pendingFrees[pendingFreeHead] = {};
+				pendingFreeHead = (pendingFreeHead + 1) % PendingFreeSlots;
+				pendingFreeCount--;
+			}
+			int ret =
+			  heap_free_internal(pending.heapCapability, pending.pointer, true);
+			if (ret == 0)
+			{
+				freed = true;
+			}
+			else
+			{
+				Debug::log<DebugLevel::Warning>(
+				  "Deferred free of {} failed: {}", pending.pointer, ret);
+			}
 		}
-		check_gm();
-		// Find the chunk that corresponds to this allocation.
-		auto *chunk = gm->allocation_start(mem.address());
-		if (!chunk)
+		if (freed)
 		{
-			return -EINVAL;
+			wake_blocked_allocators();
 		}
-		ptraddr_t start    = chunk->body().address();
-		size_t    bodySize = gm->chunk_body_size(*chunk);
-		// Is the pointer that we're freeing a pointer to the entire allocation?
-		bool isPrecise = (start == mem.base()) && (bodySize == mem.length());
-		return heap_free_chunk(
-		  *capability, *chunk, bodySize, isPrecise, reallyFree);
 	}
 
 } // namespace
@@ -858,7 +2560,66 @@ __cheriot_minimum_stack(0xa0) ssize_t
 	{
 		return -1;
 	}
-	return cap->quota;
+	// Memory in this capability's size-class cache is not charged to its
+	// quota, but is not available to anyone else until it is reused or the
+	// cache is flushed.
+	SizeClassCache *cache  = cap->size_class_cache();
+	size_t          cached = (cache != nullptr) ? cache->cached_bytes() : 0;
+	return cap->quota - std::min(cap->quota, cached);
+}
+
+__cheriot_minimum_stack(0xc0) int heap_reserve(
+  AllocatorCapability heapCapability,
+  size_t              bytes)
+{
+	STACK_CHECK(0xc0);
+	LockGuard g{lock};
+	auto     *cap = malloc_capability_unseal(heapCapability);
+	if (cap == nullptr)
+	{
+		return -EPERM;
+	}
+	Reservation *reservation =
+	  (cap->reservation != 0) ? &reservations[cap->reservation - 1] : nullptr;
+	if (bytes == 0)
+	{
+		if (reservation != nullptr)
+		{
+			*reservation     = {};
+			cap->reservation = 0;
+		}
+		return 0;
+	}
+	if (bytes > cap->quota)
+	{
+		return -EINVAL;
+	}
+	size_t freeSize = heap_free_size();
+	size_t reserved = reservations_unused(cap);
+	if ((freeSize < reserved) || (freeSize - reserved < bytes))
+	{
+		return -ENOMEM;
+	}
+	if (reservation == nullptr)
+	{
+		for (size_t i = 0; i < ReservationSlots; i++)
+		{
+			if (reservations[i].capability == nullptr)
+			{
+				reservation      = &reservations[i];
+				cap->reservation = i + 1;
+				break;
+			}
+		}
+		if (reservation == nullptr)
+		{
+			return -ENOSPC;
+		}
+	}
+	reservation->capability = cap;
+	reservation->bytes      = bytes;
+	reservation->used       = 0;
+	return 0;
 }
 
 __cheriot_minimum_stack(0xe0) int heap_quarantine_flush(Timeout *timeout)
@@ -872,6 +2633,7 @@ __cheriot_minimum_stack(0xe0) int heap_quarantine_flush(Timeout *timeout)
 
 	if (LockGuard g{lock, timeout})
 	{
+		pending_frees_drain();
 		auto epoch = revoker.system_epoch_get();
 		// Round the epoch up.  Odd epoch numbers indicate in-progress epochs.
 		epoch = (epoch + 1) & ~1U;
@@ -882,12 +2644,22 @@ __cheriot_minimum_stack(0xe0) int heap_quarantine_flush(Timeout *timeout)
 		{
 			revoker.system_bg_revoker_kick();
 		}
-		// Try removing items from quarantine until we've popped all that
-		// we can.  There may still be quarantine things from the previous
+		// Empty the size-class caches into the quarantine and then try
+		// removing items from quarantine until we've popped all that we
+		// can.  There may still be quarantine things from the previous
 		// epoch.
-		while (gm->quarantine_dequeue()) {}
+		gm->size_class_caches_flush();
+		size_t quarantined = 0;
+		for (MState *region : mspaces)
+		{
+			if (region != nullptr)
+			{
+				while (region->quarantine_dequeue()) {}
+				quarantined += region->heapQuarantineSize;
+			}
+		}
 		// If we've emptied the quarantine, stop and report success.
-		if (gm->heapQuarantineSize == 0)
+		if (quarantined == 0)
 		{
 			return 0;
 		}
@@ -897,14 +2669,61 @@ __cheriot_minimum_stack(0xe0) int heap_quarantine_flush(Timeout *timeout)
 			return -ETIMEDOUT;
 		}
 		// Remove everything that was freed with the previous revocation.
-		while (gm->quarantine_dequeue()) {}
-		Debug::log("{} bytes left in quarantine", gm->heapQuarantineSize);
+		for (MState *region : mspaces)
+		{
+			if (region != nullptr)
+			{
+				while (region->quarantine_dequeue()) {}
+				Debug::log("{} bytes left in quarantine",
+				           region->heapQuarantineSize);
+			}
+		}
 		return 0;
 	}
 
 	return -ETIMEDOUT;
 }
 
+__cheriot_minimum_stack(0xe0) int heap_quarantine_process(Timeout *timeout)
+{
+	STACK_CHECK(0xe0);
+
+	if (!check_timeout_pointer(timeout))
+	{
+		return -EINVAL;
+	}
+
+	if (LockGuard g{lock, timeout})
+	{
+		check_gm();
+		pending_frees_drain();
+		while (true)
+		{
+			bool progress = false;
+			for (MState *region : mspaces)
+			{
+				if (region != nullptr)
+				{
+					progress |= region->quarantine_dequeue();
+				}
+			}
+			if (!progress)
+			{
+				return 0;
+			}
+			// Release the lock between slices so that allocations by other
+			// threads are not delayed behind this one.
+			g.unlock();
+			if (!reacquire_lock(timeout, g))
+			{
+				return -ETIMEDOUT;
+			}
+		}
+	}
+
+	return -ETIMEDOUT;
+}
+
 __cheriot_minimum_stack(0x220) void *heap_allocate(
   Timeout            *timeout,
   AllocatorCapability heapCapability,
@@ -916,14 +2735,122 @@ __cheriot_minimum_stack(0x220) void *heap_allocate(
 	{
 		return nullptr;
 	}
+	uint64_t  start = rdcycle64();
 	LockGuard g{lock};
-	auto     *cap = malloc_capability_unseal(heapCapability);
+	pending_frees_drain();
+	auto *cap = malloc_capability_unseal(heapCapability);
 	if (cap == nullptr)
 	{
 		return nullptr;
 	}
 	// Use the default memory space.
-	return malloc_internal(bytes, std::move(g), cap, timeout, false, flags);
+	void *ret =
+	  malloc_internal(bytes, std::move(g), cap, timeout, false, flags);
+	// `malloc_internal` may have dropped the lock and failed to reacquire it,
+	// in which case the allocation has failed and is not recorded.
+	if (g && (ret != nullptr))
+	{
+		histogram_record(allocateCycles, start);
+	}
+	return ret;
+}
+
+__cheriot_minimum_stack(0x280) void *heap_reallocate(
+  Timeout            *timeout,
+  AllocatorCapability heapCapability,
+  void               *rawPointer,
+  size_t              bytes,
+  uint32_t            flags)
+{
+	STACK_CHECK(0x280);
+	if (!check_timeout_pointer(timeout))
+	{
+		return nullptr;
+	}
+	uint64_t  start = rdcycle64();
+	LockGuard g{lock};
+	auto     *cap = malloc_capability_unseal(heapCapability);
+	if (cap == nullptr)
+	{
+		return nullptr;
+	}
+	if (rawPointer == nullptr)
+	{
+		void *ret =
+		  malloc_internal(bytes, std::move(g), cap, timeout, false, flags);
+		if (g && (ret != nullptr))
+		{
+			histogram_record(allocateCycles, start);
+		}
+		return ret;
+	}
+	check_gm();
+	Capability<void> mem{rawPointer};
+	auto            *chunk = reallocation_chunk(*cap, mem);
+	// Reallocating to zero bytes is not a free, the caller must use
+	// `heap_free` for that.
+	if ((chunk == nullptr) || (bytes == 0))
+	{
+		return nullptr;
+	}
+	size_t bodySize = MState::chunk_body_size(*chunk);
+	if (CHERI::representable_length(bytes) <= bodySize)
+	{
+		// Return a capability to the whole allocation, whatever the bounds
+		// and address of the one that we were passed.
+		Capability<void> body{chunk->body()};
+		body.bounds() = bodySize;
+		body.permissions() &= mem.permissions();
+		trace_record(
+		  TraceOperation::Allocate, chunk, bytes, cap->identifier, start);
+		histogram_record(allocateCycles, start);
+		return body;
+	}
+	// Claims charge the claimer for the size of the chunk when they are made
+	// and refund it when they are dropped, so claimed chunks must not change
+	// size.
+	size_t chunkSize = chunk->size_get();
+	size_t growth    = MState::chunk_size(bytes);
+	growth -= std::min(growth, chunkSize);
+	if ((chunk->claims == 0) && reservations_permit(cap, growth))
+	{
+		Capability<void> grown =
+		  region_for(mem.address())->mspace_grow(*chunk, bytes, cap->quota);
+		if (grown != nullptr)
+		{
+			reservation_charge(*cap, chunk->size_get() - chunkSize);
+			grown.permissions() &= mem.permissions();
+			trace_record(
+			  TraceOperation::Allocate, chunk, bytes, cap->identifier, start);
+			histogram_record(allocateCycles, start);
+			return grown;
+		}
+	}
+
+	Capability<void> fresh{
+	  malloc_internal(bytes, std::move(g), cap, timeout, false, flags)};
+	if (fresh == nullptr)
+	{
+		return nullptr;
+	}
+	// The lock may have been dropped while waiting for memory.  If another
+	// thread freed the original allocation in the meantime then give up.
+	if (reallocation_chunk(*cap, mem) != chunk)
+	{
+		auto *freshChunk = allocation_header(fresh);
+		heap_free_chunk(
+		  *cap, *freshChunk, MState::chunk_body_size(*freshChunk));
+		return nullptr;
+	}
+	memcpy(fresh, chunk->body(), bodySize);
+	histogram_record(allocateCycles, start);
+	// `heap_free_chunk` records the free in the trace.
+	uint64_t freeStart = rdcycle64();
+	heap_free_chunk(*cap, *chunk, bodySize);
+	wake_blocked_allocators();
+	histogram_record(freeCycles, freeStart);
+	fresh.permissions() &= mem.permissions();
+	return fresh;
 }
 
 __cheriot_minimum_stack(0x1c0) ssize_t
@@ -942,7 +2869,7 @@ __cheriot_minimum_stack(0x1c0) ssize_t
 		Debug::log<DebugLevel::Warning>("Invalid claimed cap");
 		return 0;
 	}
-	auto *chunk = gm->allocation_start(Capability{pointer}.address());
+	auto *chunk = allocation_start(Capability{pointer}.address());
 	if (chunk == nullptr)
 	{
 		Debug::log<DebugLevel::Warning>("chunk not found");
@@ -950,7 +2877,7 @@ __cheriot_minimum_stack(0x1c0) ssize_t
 	}
 	if (claim_add(*cap, *chunk))
 	{
-		return gm->chunk_body_size(*chunk);
+		return MState::chunk_body_size(*chunk);
 	}
 	Debug::log<DebugLevel::Warning>("failed to add claim");
 	return 0;
@@ -970,21 +2897,19 @@ __cheriot_minimum_stack(
 
 int heap_free_nostackcheck(AllocatorCapability heapCapability, void *rawPointer)
 {
+	uint64_t  start = rdcycle64();
 	LockGuard g{lock};
-	int       ret = heap_free_internal(heapCapability, rawPointer, true);
+	pending_frees_drain();
+	int ret = heap_free_internal(heapCapability, rawPointer, true);
 	if (ret != 0)
 	{
 		return ret;
 	}
 
 	// If there are any threads blocked allocating memory, wake them up.
-	if (freeFutex != -1)
-	{
-		Debug::log("Some threads are blocking on allocations, waking them");
-		freeFutex = -1;
-		freeFutex.notify_all();
-	}
+	wake_blocked_allocators();
 
+	histogram_record(freeCycles, start);
 	return 0;
 }
 
@@ -996,10 +2921,60 @@ __cheriot_minimum_stack(0x260) int heap_free(AllocatorCapability heapCapability,
 	return heap_free_nostackcheck(heapCapability, rawPointer);
 }
 
-__cheriot_minimum_stack(0x1a0) ssize_t
-  heap_free_all(AllocatorCapability heapCapability)
+__cheriot_minimum_stack(0x260) int heap_free_deferred(
+  AllocatorCapability heapCapability,
+  void               *rawPointer)
+{
+	// This may perform a normal free and so needs as much stack as
+	// `heap_free`.
+	STACK_CHECK(0x260);
+	// If the lock is free, this is just a free.
+	Timeout noWait{0};
+	if (LockGuard g{lock, &noWait})
+	{
+		pending_frees_drain();
+		int ret = heap_free_internal(heapCapability, rawPointer, true);
+		if (ret == 0)
+		{
+			wake_blocked_allocators();
+		}
+		return ret;
+	}
+	// Check the arguments without the lock.  Local capabilities cannot be
+	// stored in the queue and can never be valid arguments to a free.
+	auto *capability = token_unseal<AllocatorCapabilityState>(
+	  STATIC_SEALING_TYPE(MallocKey), heapCapability);
+	if ((capability == nullptr) ||
+	    !Capability{capability}.permissions().contains(Permission::Global))
+	{
+		return -EPERM;
+	}
+	Capability<void> pointer{rawPointer};
+	if (!pointer.is_valid() || pointer.is_sealed() ||
+	    !pointer.permissions().contains(Permission::Global) ||
+	    !heap_address_is_valid(rawPointer))
+	{
+		return -EINVAL;
+	}
+	if (pending_free_push(heapCapability, rawPointer))
+	{
+		return -EINPROGRESS;
+	}
+	// The queue is full, wait for the lock.
+	return heap_free_nostackcheck(heapCapability, rawPointer);
+}
+
+__cheriot_minimum_stack(0x280) ssize_t
+  heap_free_many(AllocatorCapability heapCapability,
+                 size_t              count,
+                 void              **allocations)
 {
-	STACK_CHECK(0x1a0);
+	STACK_CHECK(0x280);
+	size_t allocationsLength;
+	if (__builtin_mul_overflow(count, sizeof(void *), &allocationsLength))
+	{
+		return -EINVAL;
+	}
 	LockGuard g{lock};
 	auto     *capability = malloc_capability_unseal(heapCapability);
 	if (capability == nullptr)
@@ -1008,30 +2983,115 @@ __cheriot_minimum_stack(0x1a0) ssize_t
 		                                heapCapability);
 		return -EPERM;
 	}
-
-	auto      chunk   = gm->heapStart.cast<MChunkHeader>();
-	ptraddr_t heapEnd = chunk.top();
-	ssize_t   freed   = 0;
-	do
+	if (!check_pointer<PermissionSet{Permission::Load,
+	                                 Permission::Store,
+	                                 Permission::LoadStoreCapability}>(
+	      allocations, allocationsLength))
 	{
-		if (chunk->is_in_use() && !chunk->isSealedObject)
+		return -EINVAL;
+	}
+	// The array may itself be a heap allocation that is in the batch.  The
+	// allocator's capability to it remains tagged after it is freed, so
+	// writing back to it would corrupt the freed chunk.  Free the first
+	// entry that refers to it last, and skip any others.
+	MChunkHeader *arrayChunk =
+	  allocation_start(Capability{allocations}.address());
+	void   *arrayAllocation = nullptr;
+	ssize_t freed           = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		void *allocation = allocations[i];
+		if (allocation == nullptr)
+		{
+			continue;
+		}
+		if ((arrayChunk != nullptr) &&
+		    (allocation_start(Capability{allocation}.address()) ==
+		     arrayChunk))
 		{
-			auto size = chunk->size_get();
-			if (heap_free_chunk(
-			      *capability, *chunk, gm->chunk_body_size(*chunk)) == 0)
+			if (arrayAllocation == nullptr)
 			{
-				freed += size;
+				arrayAllocation = allocation;
 			}
+			continue;
+		}
+		if (heap_free_pointer(*capability, allocation, true) == 0)
+		{
+			allocations[i] = nullptr;
+			freed++;
+		}
+	}
+	if ((arrayAllocation != nullptr) &&
+	    (heap_free_pointer(*capability, arrayAllocation, true) == 0))
+	{
+		freed++;
+	}
+
+	if (freed > 0)
+	{
+		wake_blocked_allocators();
+	}
+
+	return freed;
+}
+
+__cheriot_minimum_stack(0x1c0) ssize_t
+  heap_free_all(AllocatorCapability heapCapability)
+{
+	STACK_CHECK(0x1c0);
+	LockGuard g{lock};
+	auto     *capability = malloc_capability_unseal(heapCapability);
+	if (capability == nullptr)
+	{
+		Debug::log<DebugLevel::Warning>("Invalid heap capability {}",
+		                                heapCapability);
+		return -EPERM;
+	}
+
+	check_gm();
+	uint64_t regions = capability->ownerRegions;
+	ssize_t  freed   = 0;
+
+	if constexpr (AllocatorDebugEnabled)
+	{
+		owner_index_check(*capability, regions);
+	}
+
+	// Visit only the regions of the heap that the owner index says may
+	// contain chunks held by this capability, and keep the bits for those
+	// that still do afterwards (sealed objects and multiply-held claims).
+	capability->ownerRegions = 0;
+	while (regions != 0)
+	{
+		size_t bit = __builtin_ctzll(regions);
+		regions &= regions - 1;
+		MState   *mspace   = mspaces[bit / MState::OwnerIndexRegions];
+		size_t    region   = bit % MState::OwnerIndexRegions;
+		ptraddr_t heapEnd  = mspace->heapStart.top();
+		bool      retained = false;
+		freed += heap_free_range(
+		  *capability,
+		  mspace->owner_index_chunk(region),
+		  mspace->owner_index_region_base(region),
+		  std::min(mspace->owner_index_region_base(region + 1), heapEnd),
+		  retained);
+		if (retained)
+		{
+			capability->ownerRegions |= uint64_t(1) << bit;
 		}
-		chunk = static_cast<MChunkHeader *>(chunk->cell_next());
-	} while (chunk.address() < heapEnd);
+	}
+
+	// Give back the memory that this capability's size-class cache holds, and
+	// the cache itself, so that a compartment that is being reset does not
+	// keep them.
+	SizeClassCache *cache = capability->size_class_cache();
+	bool            flushed =
+	  (cache != nullptr) && gm->size_class_cache_flush(*cache);
 
 	// If there are any threads blocked allocating memory, wake them up.
-	if ((freeFutex > 0) && (freed > 0))
+	if ((freed > 0) || flushed)
 	{
-		Debug::log("Some threads are blocking on allocations, waking them");
-		freeFutex = 0;
-		freeFutex.notify_all();
+		wake_blocked_allocators();
 	}
 
 	return freed;
@@ -1050,7 +3110,8 @@ __cheriot_minimum_stack(0x220) void *heap_allocate_array(
 		return nullptr;
 	}
 	LockGuard g{lock};
-	auto     *cap = malloc_capability_unseal(heapCapability);
+	pending_frees_drain();
+	auto *cap = malloc_capability_unseal(heapCapability);
 	if (cap == nullptr)
 	{
 		return nullptr;
@@ -1069,6 +3130,81 @@ __cheriot_minimum_stack(0x220) void *heap_allocate_array(
 	return malloc_internal(req, std::move(g), cap, timeout, false, flags);
 }
 
+__cheriot_minimum_stack(0x240) ssize_t
+  heap_allocate_many(Timeout            *timeout,
+                     AllocatorCapability heapCapability,
+                     size_t              count,
+                     const size_t       *sizes,
+                     void              **allocations,
+                     uint32_t            flags)
+{
+	STACK_CHECK(0x240);
+	if (!check_timeout_pointer(timeout))
+	{
+		return -EINVAL;
+	}
+	size_t sizesLength;
+	size_t allocationsLength;
+	if (__builtin_mul_overflow(count, sizeof(size_t), &sizesLength) ||
+	    __builtin_mul_overflow(count, sizeof(void *), &allocationsLength))
+	{
+		return -EINVAL;
+	}
+	// The arrays are rechecked whenever they are used because the lock is
+	// dropped while blocking and the caller may free them in the meantime.
+	auto checkArrays = [&]() {
+		return check_pointer<PermissionSet{Permission::Load}>(sizes,
+		                                                      sizesLength) &&
+		       check_pointer<PermissionSet{Permission::Load,
+		                                   Permission::Store,
+		                                   Permission::LoadStoreCapability}>(
+		         allocations, allocationsLength);
+	};
+	LockGuard g{lock};
+	pending_frees_drain();
+	auto *cap = malloc_capability_unseal(heapCapability);
+	if (cap == nullptr)
+	{
+		return -EPERM;
+	}
+	if (!checkArrays())
+	{
+		return -EINVAL;
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		allocations[i] = nullptr;
+	}
+	ssize_t allocated = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		Capability<void> allocation{
+		  malloc_internal(sizes[i], std::move(g), cap, timeout, false, flags)};
+		// If we failed to reacquire the lock after blocking, give up on
+		// the remaining requests.
+		if (!g)
+		{
+			break;
+		}
+		if (!checkArrays())
+		{
+			// We have nowhere to put this allocation, return it.
+			if (allocation != nullptr)
+			{
+				auto *chunk = allocation_header(allocation);
+				heap_free_chunk(*cap, *chunk, MState::chunk_body_size(*chunk));
+			}
+			break;
+		}
+		if (allocation != nullptr)
+		{
+			allocations[i] = allocation;
+			allocated++;
+		}
+	}
+	return allocated;
+}
+
 namespace
 {
 	/**
@@ -1323,13 +3459,83 @@ __cheriot_minimum_stack(0xf0) int token_obj_can_destroy(
 
 size_t heap_available()
 {
-	return gm->heapFreeSize;
+	return heap_free_size();
+}
+
+__cheriot_minimum_stack(0xe0) int heap_statistics(HeapStatistics *statistics)
+{
+	STACK_CHECK(0xe0);
+	if (!check_pointer<PermissionSet{Permission::Store}>(
+	      statistics, sizeof(HeapStatistics)))
+	{
+		return -EINVAL;
+	}
+	LockGuard g{lock};
+	check_gm();
+	memset(statistics, 0, sizeof(HeapStatistics));
+	for (MState *region : mspaces)
+	{
+		if (region != nullptr)
+		{
+			region->statistics_collect(*statistics);
+		}
+	}
+	memcpy(statistics->allocateCycles, allocateCycles, sizeof(allocateCycles));
+	memcpy(statistics->freeCycles, freeCycles, sizeof(freeCycles));
+	statistics->revocationWaits = revocationWaits;
+	statistics->heapFullWaits   = heapFullWaits;
+	statistics->reservedBytes   = reservations_unused();
+	statistics->deferredFrees   = deferredFrees;
+#if defined(TEMPORAL_SAFETY) && defined(SOFTWARE_REVOKER)
+	auto &pass                        = revoker.statistics_get();
+	statistics->revocationPassEpoch   = pass.epoch;
+	statistics->revocationPassTicks   = pass.ticks;
+	statistics->revocationPassScanned = pass.scanned;
+	statistics->revocationPassSkipped = pass.skipped;
+	statistics->revocationPassCycles  = pass.cycles;
+#endif
+	return 0;
 }
 
 [[cheriot::interrupt_state(disabled)]] int heap_render()
 {
 #if HEAP_RENDER
-	gm->render();
+	for (MState *region : mspaces)
+	{
+		if (region != nullptr)
+		{
+			region->render();
+		}
+	}
+#endif
+	return 0;
+}
+
+int heap_trace_dump()
+{
+#if HEAP_TRACE
+	using TraceDebug = ConditionalDebug<true, "Allocator trace">;
+	LockGuard g{lock};
+	size_t    first = 0;
+	if (traceWritten > TraceRecords)
+	{
+		first = traceWritten - TraceRecords;
+	}
+	TraceDebug::log("begin records={} dropped={}",
+	                int32_t(traceWritten - first),
+	                int32_t(first));
+	for (size_t i = first; i < traceWritten; i++)
+	{
+		TraceRecord &record = traceBuffer[i % TraceRecords];
+		TraceDebug::log("{} {} {} {} {}",
+		                char(record.operation),
+		                record.owner,
+		                record.address,
+		                int32_t(record.size),
+		                int32_t(record.cycles));
+	}
+	TraceDebug::log("end");
+	traceWritten = 0;
 #endif
 	return 0;
 }
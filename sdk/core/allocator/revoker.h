@@ -32,8 +32,10 @@ namespace Revocation
 	 * shadow memory, and the base address of the memory covered by the shadow
 	 * bitmap.
 	 *
-	 * This currently assumes that all revocable memory is in a single
-	 * contiguous region.
+	 * The hardware load barrier has a single shadow bitmap, which covers one
+	 * contiguous range of memory starting at `TCMBaseAddr`.  Its size depends
+	 * on the size of the `shadow` device, and `shadow_covers` checks whether
+	 * memory is within it.
 	 */
 	template<typename WordT, size_t TCMBaseAddr>
 	class Bitmap
@@ -207,6 +209,18 @@ namespace Revocation
 			}
 		}
 
+		/**
+		 * Returns true if the shadow bitmap has a bit for every allocation
+		 * granule in [base, top).
+		 */
+		bool shadow_covers(ptraddr_t base, ptraddr_t top)
+		{
+			size_t coveredBits =
+			  utils::bytes2bits(CHERI::Capability{shadowCap}.length());
+			return (base >= TCMBaseAddr) && (base <= top) &&
+			       (shadow_offset_bits(top) <= coveredBits);
+		}
+
 		// Return the shadow bit at address addr.
 		bool shadow_bit_get(size_t addr)
 		{
@@ -256,6 +270,9 @@ namespace Revocation
 			Bitmap<WordT, TCMBaseAddr>::init();
 			Revoker<WordT, TCMBaseAddr>::init();
 		}
+
+		/// The hardware revoker sweeps at a fixed rate.
+		void pressure_set(uint32_t) {}
 	};
 
 	/**
@@ -286,6 +303,11 @@ namespace Revocation
 			return true;
 		}
 		void system_bg_revoker_kick() {}
+		void pressure_set(uint32_t) {}
+		bool shadow_covers(ptraddr_t, ptraddr_t)
+		{
+			return true;
+		}
 		bool is_free_cap_valid(void *)
 		{
 			return true;
@@ -313,6 +335,18 @@ namespace Revocation
 		 */
 		const uint32_t *epoch;
 
+		/**
+		 * A (read-only) pointer to the statistics for the last complete
+		 * revocation pass.
+		 */
+		const SoftwareRevokerStatistics *statistics;
+
+		/**
+		 * The pressure passed to `revoker_tick`, which determines how much
+		 * memory each tick scans.
+		 */
+		uint32_t pressure;
+
 		public:
 		/**
 		 * Software sweeping is implemented synchronously now. The sweeping is
@@ -327,7 +361,53 @@ namespace Revocation
 		void init()
 		{
 			Bitmap<WordT, TCMBaseAddr>::init();
-			epoch = revoker_epoch_get();
+			epoch      = revoker_epoch_get();
+			statistics = revoker_statistics_get();
+		}
+
+		/**
+		 * Set the urgency of revocation, from 0 (idle) to
+		 * `REVOKER_PRESSURE_MAX` (threads are blocked waiting for the pass).
+		 * This applies to subsequent ticks.
+		 */
+		void pressure_set(uint32_t newPressure)
+		{
+			pressure = newPressure;
+		}
+
+		/**
+		 * Returns the statistics for the last complete revocation pass.
+		 */
+		const SoftwareRevokerStatistics &statistics_get()
+		{
+			return *statistics;
+		}
+
+		/**
+		 * Register a tag summary, which must be kept up to date, so that
+		 * revocation passes can skip memory that does not hold capabilities.
+		 * The revoker is given a read-only view of the summary.  Returns
+		 * false on failure, in which case the revoker scans everything.
+		 */
+		bool tag_summary_add(TagSummaryCapability       authority,
+		                     SoftwareRevokerTagSummary *summary)
+		{
+			CHERI::Capability<const SoftwareRevokerTagSummary> readOnly{
+			  summary};
+			readOnly.bounds() = sizeof(SoftwareRevokerTagSummary);
+			readOnly.permissions() &= {CHERI::Permission::Load,
+			                           CHERI::Permission::Global};
+			return revoker_tag_summary_add(authority, readOnly) == 0;
+		}
+
+		/**
+		 * Add `range`, a heap region outside of the range that the loader
+		 * provides, to every future revocation pass.  Returns false on
+		 * failure, in which case the region must not be used.
+		 */
+		bool scan_range_add(TagSummaryCapability authority, void *range)
+		{
+			return revoker_scan_range_add(authority, range) == 0;
 		}
 
 		/**
@@ -351,7 +431,7 @@ namespace Revocation
 			// time that it's queried.
 			if ((current & 1) == 1)
 			{
-				(void)revoker_tick();
+				(void)revoker_tick(pressure);
 				current = *epoch;
 			}
 			// We want to know if current is greater than epoch, but current
@@ -377,7 +457,7 @@ namespace Revocation
 		/// Start revocation running.
 		void system_bg_revoker_kick()
 		{
-			(void)revoker_tick();
+			(void)revoker_tick(pressure);
 		}
 	};
 
@@ -432,7 +512,23 @@ namespace Revocation
 		{
 			epoch++;
 		}
+
+		/// Fake revocation is always instant.
+		void pressure_set(uint32_t) {}
 	};
+	/**
+	 * True if the revoker skips memory that the allocator's tag summaries
+	 * (`MState::tagSummary`) report does not hold capabilities, and so the
+	 * allocator must maintain them.
+	 */
+	constexpr bool UsesTagSummary =
+#if defined(TEMPORAL_SAFETY) && defined(SOFTWARE_REVOKER)
+	  true
+#else
+	  false
+#endif
+	  ;
+
 	/**
 	 * The revoker to use for this configuration.
 	 *
@@ -1,19 +1,103 @@
 // Copyright Microsoft and CHERIoT Contributors.
 // SPDX-License-Identifier: MIT
 
+#pragma once
+
+#include <__cheri_sealed.h>
 #include <cdefs.h>
+#include <stddef.h>
 #include <stdint.h>
 
+/**
+ * The largest value of the `pressure` argument to `revoker_tick`, used when
+ * threads are blocked waiting for revocation to finish.
+ */
+#define REVOKER_PRESSURE_MAX 100
+
+/**
+ * Statistics for a complete revocation pass of the software revoker.
+ */
+struct SoftwareRevokerStatistics
+{
+	/// The (even) epoch at the end of the pass.
+	uint32_t epoch;
+	/// The number of calls to `revoker_tick` that the pass took.
+	uint32_t ticks;
+	/// The number of capability-sized words scanned.
+	uint32_t scanned;
+	/// The number of capability-sized words skipped using tag summaries.
+	uint32_t skipped;
+	/// The number of cycles spent scanning.
+	uint32_t cycles;
+};
+
+/// The number of blocks in a `SoftwareRevokerTagSummary`.
+#define REVOKER_TAG_SUMMARY_BLOCKS 256
+
+/// The number of tag summaries that the software revoker accepts.
+#define REVOKER_TAG_SUMMARIES 4
+
+/**
+ * The number of ranges that the software revoker scans in addition to the
+ * one, from the start of globals to the end of the primary heap, that the
+ * loader provides.
+ */
+#define REVOKER_SCAN_RANGES 3
+
+/**
+ * A summary of the parts of a range of memory that may contain tagged
+ * capabilities, maintained by the allocator for each heap region.  The range
+ * is divided into power-of-two-sized blocks.  The software revoker does not
+ * scan blocks whose bit is clear.
+ */
+struct SoftwareRevokerTagSummary
+{
+	/// The address of the first block.
+	ptraddr_t base;
+	/// Log2 of the size of a block.
+	uint32_t blockShift;
+	/// The number of blocks in use.
+	uint32_t blocks;
+	/// One bit per block, set if the block may contain capabilities.
+	uint32_t bits[REVOKER_TAG_SUMMARY_BLOCKS / 32];
+};
+
+/**
+ * The type of the static sealed object that authorises registering tag
+ * summaries with `revoker_tag_summary_add` and scan ranges with
+ * `revoker_scan_range_add`.  Skipping memory that does hold capabilities
+ * would break temporal safety, and scanning memory requires a capability that
+ * can load and store capabilities in it, so only the allocator should hold
+ * one of these.
+ */
+struct SoftwareRevokerTagSummaryAuthority
+{
+	/// Unused.
+	uint32_t unused;
+};
+
+/**
+ * Type for sealed capabilities that authorise registering tag summaries and
+ * scan ranges.
+ */
+typedef CHERI_SEALED(struct SoftwareRevokerTagSummaryAuthority *)
+  TagSummaryCapability;
+
 /**
  * Prod the software revoker to do some work.  This does not do a complete
  * revocation pass; it will scan a region of memory and then return.
  *
+ * The amount of memory scanned grows with `pressure`, which runs from 0 (no
+ * urgency) to `REVOKER_PRESSURE_MAX` (threads are blocked waiting for this
+ * pass).  Larger values finish a pass in fewer ticks, at the cost of longer
+ * periods with interrupts disabled.
+ *
  * Returns 0 on success, a compartment invocation failure indication
  * (-ENOTENOUGHSTACK, -ENOTENOUGHTRUSTEDSTACK) if it cannot be invoked, or
  * possibly -ECOMPARTMENTFAIL if the software revoker compartment is damaged.
  */
 [[cheriot::interrupt_state(disabled)]] __cheri_compartment(
-  "software_revoker") int revoker_tick();
+  "software_revoker") int revoker_tick(uint32_t pressure);
 
 /**
  * Returns a read-only capability to the current revocation epoch.  If the low
@@ -21,3 +105,42 @@
  * wrap, the caller is responsible for handling overflow.
  */
 const uint32_t *__cheri_compartment("software_revoker") revoker_epoch_get();
+
+/**
+ * Returns a read-only capability to the statistics for the most recently
+ * completed revocation pass.  These are updated when each pass finishes.
+ */
+const struct SoftwareRevokerStatistics *
+  __cheri_compartment("software_revoker") revoker_statistics_get();
+
+/**
+ * Register `summary`, which must remain valid and correct for as long as the
+ * system runs, so that future revocation passes skip the blocks that it
+ * reports do not contain capabilities.  `authority` must be a static sealed
+ * `SoftwareRevokerTagSummaryAuthority` sealed with the software revoker's
+ * `TagSummaryKey` type.
+ *
+ * Returns 0 on success, -EPERM if `authority` is not valid, -EINVAL if
+ * `summary` is not a valid summary, or -ENOSPC if
+ * `REVOKER_TAG_SUMMARIES` summaries are already registered.
+ */
+[[cheriot::interrupt_state(disabled)]] __cheri_compartment(
+  "software_revoker") int revoker_tag_summary_add(
+  TagSummaryCapability                    authority,
+  const struct SoftwareRevokerTagSummary *summary);
+
+/**
+ * Add the memory that `range` refers to to every future revocation pass.
+ * This is used for heap regions outside of the range that the loader
+ * provides.  `range` must be a global, unsealed capability that can load and
+ * store capabilities, and must remain usable for as long as the system runs.
+ * `authority` must be a static sealed `SoftwareRevokerTagSummaryAuthority`
+ * sealed with the software revoker's `TagSummaryKey` type.
+ *
+ * Returns 0 on success, -EPERM if `authority` is not valid, -EINVAL if
+ * `range` is not a valid capability, or -ENOSPC if `REVOKER_SCAN_RANGES`
+ * ranges are already registered.
+ */
+[[cheriot::interrupt_state(disabled)]] __cheri_compartment(
+  "software_revoker") int revoker_scan_range_add(TagSummaryCapability authority,
+                                                 void                *range);
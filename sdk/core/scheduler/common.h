@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <token.h>
 #include <type_traits>
+#include <utils.hh>
 
 namespace
 {
@@ -97,6 +98,24 @@ namespace
 		}
 	};
 
+	/**
+	 * Hash a futex address into one of `Buckets` buckets.  `Buckets` must be
+	 * a power of two.
+	 *
+	 * Futex words are 4-byte aligned, so the low two bits carry no
+	 * information.  Fold some higher bits in as well so that futex words that
+	 * are a multiple of the table size apart (for example, the same field in
+	 * objects allocated with the same size) do not all collide.
+	 */
+	template<size_t Buckets>
+	size_t futex_address_hash(ptraddr_t key)
+	{
+		constexpr size_t Shift = utils::log2<Buckets>();
+		ptraddr_t        hash =
+		  (key >> 2) ^ (key >> (2 + Shift)) ^ (key >> (2 + (2 * Shift)));
+		return hash & (Buckets - 1);
+	}
+
 	/**
 	 * RAII class for preventing nested exceptions.
 	 */
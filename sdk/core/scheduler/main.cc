@@ -47,9 +47,37 @@ namespace
 	constexpr bool UseMultiwaiters = SCHEDULER_MULTIWAITER;
 
 	/**
-	 * Priority-sorted list of threads waiting for a futex.
+	 * The number of buckets in the futex wait-queue hash table.  This is the
+	 * number of threads rounded up to a power of two (so that the hash is a
+	 * mask), clamped to a small range.  With at least as many buckets as
+	 * threads, most futex words will have a bucket to themselves.
 	 */
-	Thread *futexWaitingList;
+	constexpr size_t FutexWaitQueueBuckets = []() {
+		size_t buckets = 4;
+		while ((buckets < CONFIG_THREADS_NUM) && (buckets < 32))
+		{
+			buckets <<= 1;
+		}
+		return buckets;
+	}();
+
+	/**
+	 * Hash table of priority-sorted lists of threads waiting for a futex.
+	 * Each thread waiting on a futex is on the list for the bucket that
+	 * `futex_wait_queue` returns for its futex address.  Threads waiting on
+	 * unrelated futexes may share a bucket, so walkers must still compare
+	 * `futexWaitAddress` against the key.
+	 */
+	Thread *futexWaitingLists[FutexWaitQueueBuckets];
+
+	/**
+	 * Returns the wait queue for the futex at `key`.
+	 */
+	Thread *&futex_wait_queue(ptraddr_t key)
+	{
+		return futexWaitingLists[futex_address_hash<FutexWaitQueueBuckets>(
+		  key)];
+	}
 
 	/**
 	 * The value used for priority-boosting futexes that are not actually
@@ -69,13 +97,18 @@ namespace
 	 */
 	uint8_t priority_boost_for_thread(uint16_t threadID, uint8_t priority = 0)
 	{
-		Thread::walk_thread_list(futexWaitingList, [&](Thread *thread) {
-			if ((thread->futexPriorityInheriting) &&
-			    (thread->futexPriorityBoostedThread == threadID))
-			{
-				priority = std::max(priority, thread->priority_get());
-			}
-		});
+		// A thread may hold several priority-inheriting futexes, so the
+		// threads boosting it may be in any bucket.
+		for (Thread *&queue : futexWaitingLists)
+		{
+			Thread::walk_thread_list(queue, [&](Thread *thread) {
+				if ((thread->futexPriorityInheriting) &&
+				    (thread->futexPriorityBoostedThread == threadID))
+				{
+					priority = std::max(priority, thread->priority_get());
+				}
+			});
+		}
 		return priority;
 	}
 
@@ -85,9 +118,9 @@ namespace
 	 */
 	void priority_boost_update(ptraddr_t key, uint16_t threadID)
 	{
-		Thread::walk_thread_list(futexWaitingList, [&](Thread *thread) {
+		Thread::walk_thread_list(futex_wait_queue(key), [&](Thread *thread) {
 			if ((thread->futexPriorityInheriting) &&
-			    (thread->futexWaitAddress = key))
+			    (thread->futexWaitAddress == key))
 			{
 				thread->futexPriorityBoostedThread = threadID;
 			}
@@ -106,9 +139,9 @@ namespace
 	 */
 	void priority_boost_reset(ptraddr_t key, uint16_t threadID)
 	{
-		Thread::walk_thread_list(futexWaitingList, [&](Thread *thread) {
+		Thread::walk_thread_list(futex_wait_queue(key), [&](Thread *thread) {
 			if ((thread->futexPriorityInheriting) &&
-			    (thread->futexWaitAddress = key))
+			    (thread->futexWaitAddress == key))
 			{
 				if (thread->futexPriorityBoostedThread == threadID)
 				{
@@ -164,7 +197,7 @@ namespace
 		// success.
 		int woke = 0;
 		Thread::walk_thread_list(
-		  futexWaitingList,
+		  futex_wait_queue(key),
 		  [&](Thread *thread) {
 			  if (thread->futexWaitAddress == key)
 			  {
@@ -509,7 +542,7 @@ __cheriot_minimum_stack(0xb0) int futex_timed_wait(Timeout        *timeout,
 		owningThread->priority_boost(priority_boost_for_thread(
 		  owningThreadID, currentThread->priority_get()));
 	}
-	currentThread->suspend(timeout, &futexWaitingList);
+	currentThread->suspend(timeout, &futex_wait_queue(key));
 	bool timedout                   = currentThread->futexWaitAddress == 0;
 	currentThread->futexWaitAddress = 0;
 	if (isPriorityInheriting)
@@ -710,6 +743,79 @@ __cheriot_minimum_stack(0xc0) int multiwaiter_wait(Timeout           *timeout,
 	});
 }
 
+__cheriot_minimum_stack(0x60) int multiwaiter_attach(MultiWaiter        waiter,
+                                                     EventWaiterSource *events,
+                                                     size_t             count)
+{
+	STACK_CHECK(0x60);
+	return typed_op<MultiWaiterInternal>(waiter, [&](MultiWaiterInternal &mw) {
+		if (count > mw.capacity())
+		{
+			Debug::log("Too many events");
+			return -EINVAL;
+		}
+		// We don't need to worry about overflow here because we have ensured
+		// count is very small.  Detaching (a zero count) does not need an
+		// array.
+		if ((count > 0) && !check_pointer<PermissionSet{Permission::Load}>(
+		                     events, count * sizeof(EventWaiterSource)))
+		{
+			Debug::log("Invalid events pointer: {}", events);
+			return -EINVAL;
+		}
+		if (mw.is_waiting())
+		{
+			Debug::log("Attempting to attach events to busy multiwaiter");
+			return -EBUSY;
+		}
+		return mw.attach_events(events, count);
+	});
+}
+
+__cheriot_minimum_stack(0xb0) int multiwaiter_wait_attached(Timeout    *timeout,
+                                                            MultiWaiter waiter)
+{
+	STACK_CHECK(0xb0);
+	return typed_op<MultiWaiterInternal>(waiter, [&](MultiWaiterInternal &mw) {
+		if (!check_timeout_pointer(timeout))
+		{
+			return -EINVAL;
+		}
+		if (!mw.is_attached())
+		{
+			Debug::log("Waiting on multiwaiter with no attached events");
+			return -EINVAL;
+		}
+		if (mw.is_waiting())
+		{
+			Debug::log("Attempting wait on busy multiwaiter");
+			return -EBUSY;
+		}
+		auto result = mw.arm_attached_events();
+		if (result == MultiWaiterInternal::EventOperationResult::Error)
+		{
+			Debug::log("Attached futex word is no longer valid");
+			return -EINVAL;
+		}
+		if ((result == MultiWaiterInternal::EventOperationResult::Sleep) &&
+		    timeout->may_block())
+		{
+			Debug::log("Sleeping for {} ticks", timeout->remaining);
+			mw.wait(timeout);
+			// If we yielded then the multiwaiter may have been freed out
+			// from under us.
+			if (!Capability{&mw}.is_valid())
+			{
+				return -EINVAL;
+			}
+		}
+		// As with `multiwaiter_wait`, don't report a timeout if events
+		// arrived between the timeout and this thread running.
+		uint32_t fired = mw.get_attached_results();
+		return (fired == 0) ? -ETIMEDOUT : static_cast<int>(fired);
+	});
+}
+
 #endif // SCHEDULER_MULTIWAITER
 
 namespace
@@ -33,13 +33,24 @@ namespace
 		/**
 		 * Event-type-specific flags.
 		 */
-		unsigned flags : 6 = 0;
+		unsigned flags : 3 = 0;
+		/**
+		 * The index of this event waiter in its multiwaiter's array of
+		 * events.  This is used to find the multiwaiter from an event waiter
+		 * found via the event-source index.
+		 */
+		unsigned index : 3 = 0;
 		/**
 		 * Value indicating the events that have occurred.  The zero value is
 		 * reserved to indicate that this event has not been triggered,
 		 * subclasses are responsible for defining interpretations of others.
 		 */
 		unsigned readyEvents : 24 = 0;
+		/**
+		 * The next event waiter in the same event-source index bucket.  This
+		 * is valid only while the owning multiwaiter's thread is blocked.
+		 */
+		EventWaiter *nextInBucket = nullptr;
 		/**
 		 * Set some of the bits in the readyEvents field.  Any bits set in
 		 * `value` will be set, in addition to any that are already set.
@@ -78,14 +89,21 @@ namespace
 			return false;
 		}
 
+		/**
+		 * Returns the address of the futex word that this waits on.
+		 */
+		ptraddr_t source_address()
+		{
+			return Capability{eventSource}.address();
+		}
+
 		/**
 		 * Trigger method that is called when a futex is notified.  Checks for
 		 * matches against the address.
 		 */
 		bool trigger(ptraddr_t address)
 		{
-			ptraddr_t sourceAddress = Capability{eventSource}.address();
-			if (sourceAddress != address)
+			if (source_address() != address)
 			{
 				return false;
 			}
@@ -95,8 +113,8 @@ namespace
 	};
 
 	static_assert(
-	  sizeof(EventWaiter) == (2 * sizeof(void *)),
-	  "Each waited event should consume only two pointers worth of memory");
+	  sizeof(EventWaiter) == (3 * sizeof(void *)),
+	  "Each waited event should consume only three pointers worth of memory");
 } // namespace
 
 /**
@@ -120,6 +138,14 @@ class MultiWaiterInternal : public Handle</*IsDynamic*/ true>
 	 */
 	static constexpr size_t MaxMultiWaiterSize = 8;
 
+	static_assert(MaxMultiWaiterSize <= (1 << 3),
+	              "EventWaiter::index is too small for the maximum size");
+
+	/**
+	 * The number of buckets in the event-source index.
+	 */
+	static constexpr size_t EventIndexBuckets = 16;
+
 	/**
 	 * The maximum number of events in this multiwaiter.
 	 */
@@ -128,12 +154,30 @@ class MultiWaiterInternal : public Handle</*IsDynamic*/ true>
 	 * The current number of events in this multiwaiter.
 	 */
 	uint8_t usedLength = 0;
+	/**
+	 * True if the events in this multiwaiter are in the event-source index.
+	 * This is the case only while a thread is blocked in `wait`.
+	 */
+	bool isIndexed = false;
+	/**
+	 * True if the events in this multiwaiter were attached with
+	 * `attach_events` and so persist across waits.
+	 */
+	bool isAttached = false;
+	/**
+	 * The thread that is blocked on this multiwaiter.  This is valid only if
+	 * `isIndexed` is true.
+	 */
+	Thread *waitingThread = nullptr;
 
 	/**
 	 * The array of events that we're waiting for.  This is variable sized
 	 * and must be the last field of the structure.
+	 *
+	 * This is no_subobject_bounds so that `from_event` below will work even if
+	 * subobject bounds are turned on.
 	 */
-	EventWaiter events[];
+	EventWaiter events[] __attribute__((__cheri_no_subobject_bounds__));
 
 	public:
 	/**
@@ -171,6 +215,23 @@ class MultiWaiterInternal : public Handle</*IsDynamic*/ true>
 		return usedLength;
 	}
 
+	/**
+	 * Returns true if a thread is currently blocked on this multiwaiter, or
+	 * has been woken but not yet returned from `wait`.
+	 */
+	bool is_waiting()
+	{
+		return isIndexed;
+	}
+
+	/**
+	 * Returns true if this multiwaiter has persistent events attached.
+	 */
+	bool is_attached()
+	{
+		return isAttached;
+	}
+
 	/**
 	 * Factory method.  Creates a multiwaiter of the specified size.  On
 	 * failure, sets `error` to the errno constant corresponding to the
@@ -241,26 +302,126 @@ class MultiWaiterInternal : public Handle</*IsDynamic*/ true>
 				return EventOperationResult::Error;
 			}
 			eventTriggered |= events[i].reset(address, newEvents[i].value);
+			events[i].index = i;
 		}
 		usedLength = count;
 		return eventTriggered ? EventOperationResult::Wake
 		                      : EventOperationResult::Sleep;
 	}
 
+	/**
+	 * Attach a persistent set of events, replacing any existing ones.  The
+	 * caller is responsible for ensuring that `newEvents` is a valid and
+	 * usable capability and that `count` is within the capacity of this
+	 * object.
+	 *
+	 * Unlike `set_events`, this retains a capability to each futex word, so
+	 * that the words can be checked again on each wait.  These are reduced to
+	 * global, read-only capabilities to the single word.  Each source is read
+	 * once from `newEvents`, so concurrent modification can cause validation
+	 * to fail but cannot bypass it.
+	 *
+	 * Returns 0 on success or `-EINVAL` if any of the sources is invalid, in
+	 * which case no events are attached.
+	 */
+	int attach_events(EventWaiterSource *newEvents, size_t count)
+	{
+		usedLength = 0;
+		isAttached = false;
+		for (size_t i = 0; i < count; i++)
+		{
+			Capability<uint32_t> address{
+			  static_cast<uint32_t *>(newEvents[i].eventSource)};
+			if (!check_pointer<PermissionSet{Permission::Load,
+			                                 Permission::Global}>(
+			      address.get(), sizeof(uint32_t)))
+			{
+				return -EINVAL;
+			}
+			address.bounds() = sizeof(uint32_t);
+			address.permissions() &= {Permission::Load, Permission::Global};
+			events[i].eventSource  = address.get();
+			events[i].eventValue   = newEvents[i].value;
+			events[i].flags        = 0;
+			events[i].readyEvents  = 0;
+			events[i].index        = i;
+			events[i].nextInBucket = nullptr;
+		}
+		usedLength = count;
+		isAttached = count > 0;
+		return 0;
+	}
+
+	/**
+	 * Prepare the attached events for a wait, checking whether any has
+	 * already fired.  Returns `Error` if one of the attached futex words has
+	 * been deallocated.
+	 */
+	EventOperationResult arm_attached_events()
+	{
+		bool eventTriggered = false;
+		for (auto &event : *this)
+		{
+			auto *address = static_cast<uint32_t *>(event.eventSource);
+			if (!Capability{address}.is_valid())
+			{
+				return EventOperationResult::Error;
+			}
+			event.readyEvents = 0;
+			if (*address != event.eventValue)
+			{
+				event.set_ready(1);
+				eventTriggered = true;
+			}
+		}
+		return eventTriggered ? EventOperationResult::Wake
+		                      : EventOperationResult::Sleep;
+	}
+
+	/**
+	 * Collect the results of a wait on attached events.  Returns a bitmask of
+	 * the events that have fired and updates the expected value of each of
+	 * them to the current value of its futex word, so that it will not fire
+	 * again until the word changes.
+	 */
+	uint32_t get_attached_results()
+	{
+		uint32_t fired = 0;
+		for (auto &event : *this)
+		{
+			if (!event.has_fired())
+			{
+				continue;
+			}
+			fired |= 1U << event.index;
+			auto *address = static_cast<uint32_t *>(event.eventSource);
+			if (Capability{address}.is_valid())
+			{
+				event.eventValue = *address;
+			}
+			event.readyEvents = 0;
+		}
+		return fired;
+	}
+
 	/**
 	 * Destructor, ensures that nothing is waiting on this.
 	 */
 	~MultiWaiterInternal()
 	{
-		// If any thread is waiting on us, unregister and mark the thread as
-		// ready instead.
-		Thread::walk_thread_list(threads, [&](Thread *thread) {
-			if (thread->multiWaiter == this)
+		// If a thread is waiting on us, unregister and mark the thread as
+		// ready instead.  The thread must not touch this object again, so we
+		// remove it from the event-source index on its behalf.
+		if (isIndexed)
+		{
+			Thread *thread = waitingThread;
+			index_remove();
+			if (!thread->is_ready())
 			{
 				thread->multiWaiter = nullptr;
 				thread->ready(Thread::WakeReason::Timer);
 			}
-		});
+		}
 	}
 
 	/**
@@ -284,31 +445,91 @@ class MultiWaiterInternal : public Handle</*IsDynamic*/ true>
 	}
 
 	/**
-	 * Helper that should be called whenever an event of type `T` is ready.
+	 * Helper that should be called whenever the futex at `source` is woken.
+	 * This visits only the event waiters in the event-source index bucket for
+	 * `source`, so the cost is independent of the number of threads blocked
+	 * on unrelated multiwaiters.
+	 *
 	 * This will always notify any waiters that have already been woken but
 	 * have not yet returned.  The `maxWakes` parameter can be used to
 	 * restrict the number of threads that are woken as a result of this
-	 * call.
+	 * call.  If it does, the highest-priority threads are woken first.
 	 */
-	template<typename T>
 	static uint32_t
-	wake_waiters(T        source,
-	             uint32_t maxWakes = std::numeric_limits<uint32_t>::max())
+	wake_waiters(ptraddr_t source,
+	             uint32_t  maxWakes = std::numeric_limits<uint32_t>::max())
 	{
-		// Look at any threads that are waiting on multiwaiters.  This
-		// should happen after waking the multiwaiters so that we don't
-		// visit multiwaiters twice
+		// Waking threads does not remove their events from the index (they
+		// do that themselves when they next run), so the bucket is stable
+		// for the duration of this call.
+		EventWaiter *bucket = event_index_bucket(source);
+		auto         visit  = [&](auto &&visitor) {
+			for (EventWaiter *event = bucket; event != nullptr;
+			     event              = event->nextInBucket)
+			{
+				if (event->source_address() == source)
+				{
+					visitor(event, from_event(event)->waitingThread);
+				}
+			}
+		};
+		// Count the blocked threads that this could wake.  A thread waiting
+		// on the same futex twice is counted twice, which just means that we
+		// may take the slow path unnecessarily.
+		uint32_t candidates = 0;
+		visit([&](EventWaiter *, Thread *thread) {
+			candidates += !thread->is_ready();
+		});
 		uint32_t woken = 0;
-		Thread::walk_thread_list(
-		  threads,
-		  [&](Thread *thread) {
-			  if (thread->multiWaiter->trigger(source))
-			  {
-				  thread->ready(Thread::WakeReason::MultiWaiter);
-				  woken++;
-			  }
-		  },
-		  [&]() { return woken >= maxWakes; });
+		// Common case: wake everything waiting on this futex.
+		if (candidates <= maxWakes)
+		{
+			visit([&](EventWaiter *event, Thread *thread) {
+				event->set_ready(1);
+				if (!thread->is_ready())
+				{
+					thread->ready(Thread::WakeReason::MultiWaiter);
+					woken++;
+				}
+			});
+			return woken;
+		}
+		// Otherwise, only some threads can be woken.  Threads that another
+		// event has already woken do not count towards `maxWakes`, but must
+		// still see this event when they run, as on the common path.
+		visit([&](EventWaiter *event, Thread *thread) {
+			if (thread->is_ready())
+			{
+				event->set_ready(1);
+			}
+		});
+		// Wake the highest-priority blocked thread each time.  Index
+		// buckets are in LIFO order, so prefer the last thread seen at a given
+		// priority to preserve FIFO order among equal-priority waiters.
+		while (woken < maxWakes)
+		{
+			Thread *best = nullptr;
+			visit([&](EventWaiter *, Thread *thread) {
+				if (!thread->is_ready() &&
+				    ((best == nullptr) ||
+				     (thread->priority_get() >= best->priority_get())))
+				{
+					best = thread;
+				}
+			});
+			if (best == nullptr)
+			{
+				break;
+			}
+			visit([&](EventWaiter *event, Thread *thread) {
+				if (thread == best)
+				{
+					event->set_ready(1);
+				}
+			});
+			best->ready(Thread::WakeReason::MultiWaiter);
+			woken++;
+		}
 		return woken;
 	}
 
@@ -320,25 +541,82 @@ class MultiWaiterInternal : public Handle</*IsDynamic*/ true>
 	{
 		Thread *currentThread      = Thread::current_get();
 		currentThread->multiWaiter = this;
-		currentThread->suspend(timeout, &MultiWaiterInternal::threads);
+		waitingThread              = currentThread;
+		index_insert();
+		currentThread->suspend(timeout, nullptr);
 		currentThread->multiWaiter = nullptr;
+		// If this multiwaiter was deleted while we were blocked then the
+		// destructor has already removed it from the index and `this` is no
+		// longer valid.
+		if (Capability{this}.is_valid())
+		{
+			index_remove();
+		}
 	}
 
 	private:
 	/**
-	 * Deliver an event from the source to all possible waiting events in
-	 * this set.  This returns true if any of the event sources matches
-	 * this multiwaiter and the thread should be awoken.
+	 * Returns the event-source index bucket for the futex at `source`.
+	 */
+	static EventWaiter *&event_index_bucket(ptraddr_t source)
+	{
+		return eventIndex[futex_address_hash<EventIndexBuckets>(source)];
+	}
+
+	/**
+	 * Container-of for the `events` field, given any element.
 	 */
-	template<typename T>
-	bool trigger(T source, uint32_t info = 0)
+	static MultiWaiterInternal *from_event(EventWaiter *event)
 	{
-		bool shouldWake = false;
-		for (auto &registeredSource : *this)
+		EventWaiter *first = event - event->index;
+		return reinterpret_cast<MultiWaiterInternal *>(
+		  reinterpret_cast<uintptr_t>(first) -
+		  offsetof(MultiWaiterInternal, events));
+	}
+
+	/**
+	 * Add all of the events in this multiwaiter to the event-source index.
+	 */
+	void index_insert()
+	{
+		Debug::Assert(!isIndexed, "Multiwaiter is already indexed");
+		for (auto &event : *this)
 		{
-			shouldWake |= registeredSource.trigger(source);
+			EventWaiter *&bucket = event_index_bucket(event.source_address());
+			event.nextInBucket   = bucket;
+			bucket               = &event;
+		}
+		isIndexed = true;
+	}
+
+	/**
+	 * Remove all of the events in this multiwaiter from the event-source
+	 * index, if they are present.  Each removal walks only the bucket that
+	 * the event is in.
+	 */
+	void index_remove()
+	{
+		if (!isIndexed)
+		{
+			return;
+		}
+		for (auto &event : *this)
+		{
+			for (EventWaiter **link =
+			       &event_index_bucket(event.source_address());
+			     *link != nullptr;
+			     link = &(*link)->nextInBucket)
+			{
+				if (*link == &event)
+				{
+					*link = event.nextInBucket;
+					break;
+				}
+			}
+			event.nextInBucket = nullptr;
 		}
-		return shouldWake;
+		isIndexed     = false;
+		waitingThread = nullptr;
 	}
 
 	/**
@@ -347,8 +625,9 @@ class MultiWaiterInternal : public Handle</*IsDynamic*/ true>
 	MultiWaiterInternal(size_t length) : Length(length) {}
 
 	/**
-	 * Priority-sorted wait queue for threads that are blocked on a
-	 * multiwaiter.
+	 * Index of the events of all multiwaiters that have a blocked thread,
+	 * keyed on the address of the futex word.  Each bucket is a singly linked
+	 * list through `EventWaiter::nextInBucket`.
 	 */
-	static inline Thread *threads;
+	static inline EventWaiter *eventIndex[EventIndexBuckets];
 };
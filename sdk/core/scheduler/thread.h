@@ -64,8 +64,15 @@ namespace
 		 * disabled.
 		 */
 		static inline uint64_t ticksSinceBoot;
-		/// All threads that are suspended must be on this list.
-		static inline ThreadImpl *waitingList;
+
+		/**
+		 * Returns the suspended thread with the earliest expiry time, or
+		 * `nullptr` if no threads are suspended.
+		 */
+		static ThreadImpl *timer_queue_head()
+		{
+			return (timerQueueSize == 0) ? nullptr : timerQueue[0];
+		}
 
 		/// Returns the current running thread.
 		static ThreadImpl *current_get()
@@ -207,7 +214,7 @@ namespace
 			static_assert(NPrios <
 			              std::numeric_limits<decltype(priority)>::max());
 			// All threads are created in blocked state.
-			timer_list_insert(&waitingList);
+			timer_queue_insert();
 		}
 
 		/**
@@ -225,8 +232,8 @@ namespace
 			Debug::Assert(state == ThreadState::Suspended,
 			              "Waking thread that is in state {}, not suspended",
 			              static_cast<ThreadState>(state));
-			// First, remove self from the timer waiting list.
-			timer_list_remove(&waitingList);
+			// First, remove self from the timer queue.
+			timer_queue_remove();
 			if (sleepQueue != nullptr)
 			{
 				// We were on a list waiting for some resource. Remove ourselves
@@ -306,7 +313,7 @@ namespace
 			}
 			expiryTime = expiry_time_for_timeout(waitTicks);
 
-			timer_list_insert(&waitingList);
+			timer_queue_insert();
 		}
 
 		/**
@@ -412,44 +419,26 @@ namespace
 			}
 		}
 
-		/// Same as list_insert(), but sorted on ExpiryTime.
-		void timer_list_insert(ThreadImpl **headPtr)
+		/**
+		 * Insert self into the timer queue.  All suspended threads must be in
+		 * the timer queue, including those blocked with an unlimited timeout.
+		 *
+		 * The timer queue is a binary min-heap keyed on `expiryTime`, so this
+		 * performs at most log2(CONFIG_THREADS_NUM) comparisons and moves,
+		 * irrespective of the timeouts of other threads.
+		 */
+		void timer_queue_insert()
 		{
-			ThreadImpl *head = *headPtr;
-
 			Debug::Assert(state == ThreadState::Suspended,
-			              "Inserting thread into timer list that is in state "
+			              "Inserting thread into timer queue that is in state "
 			              "{}, not suspended",
 			              static_cast<ThreadState>(state));
-			if (head == nullptr)
-			{
-				timerNext = timerPrev = *headPtr = this;
-			}
-			else
-			{
-				ThreadImpl *iter = head->timerPrev;
-				ThreadImpl *iterNext;
-
-				// Go back from tail, and stop at the first Thread whose expiry
-				// <= ours.
-				while (iter->expiryTime > expiryTime)
-				{
-					iter = iter->timerPrev;
-					if (iter == head->timerPrev)
-					{
-						break;
-					}
-				}
-				iterNext        = iter->timerNext;
-				iter->timerNext = iterNext->timerPrev = this;
-				timerNext                             = iterNext;
-				timerPrev                             = iter;
-
-				if (expiryTime < head->expiryTime)
-				{
-					*headPtr = this;
-				}
-			}
+			Debug::Assert(timerQueueIndex == NotInTimerQueue,
+			              "Thread {} is already in the timer queue",
+			              threadId);
+			Debug::Assert(timerQueueSize < CONFIG_THREADS_NUM,
+			              "Timer queue overflow");
+			timer_queue_sift_up(this, timerQueueSize++);
 		}
 
 		/// Remove self from the list headPtr points to.
@@ -483,35 +472,40 @@ namespace
 			next = prev = nullptr;
 		}
 
-		/// Same as list_remove(), but for the timer list.
-		void timer_list_remove(ThreadImpl **headPtr)
+		/**
+		 * Remove self from the timer queue.
+		 *
+		 * The last element of the heap is moved into the vacated slot and
+		 * then moved up or down to restore the heap invariant.  As with
+		 * insertion, this is bounded by log2(CONFIG_THREADS_NUM) steps.
+		 */
+		void timer_queue_remove()
 		{
-			ThreadImpl *head = *headPtr;
-
-			if (timerNext == this)
-			{
-				// We are the only one left on this list, clear the head.
-				Debug::Assert(timerPrev == this,
-				              "Invalid loop in thread list.  Next pointer "
-				              "points to this ({}) but previous pointer is {}",
-				              this,
-				              timerPrev);
-				*headPtr = nullptr;
-			}
-			else
+			uint16_t index = timerQueueIndex;
+			Debug::Assert(index < timerQueueSize,
+			              "Thread {} is not in the timer queue",
+			              threadId);
+			Debug::Assert(timerQueue[index] == this,
+			              "Timer queue slot {} contains {}, expected {}",
+			              index,
+			              timerQueue[index],
+			              this);
+			ThreadImpl *last = timerQueue[--timerQueueSize];
+			if (last != this)
 			{
-				ThreadImpl *prevThread = timerPrev;
-				ThreadImpl *nextThread = timerNext;
-
-				prevThread->timerNext = nextThread;
-				nextThread->timerPrev = prevThread;
-
-				if (head == this)
+				if ((index > 0) &&
+				    (last->expiryTime <
+				     timerQueue[timer_queue_parent(index)]->expiryTime))
 				{
-					*headPtr = timerNext;
+					timer_queue_sift_up(last, index);
+				}
+				else
+				{
+					timer_queue_sift_down(last, index);
 				}
 			}
-			timerNext = timerPrev = nullptr;
+			timerQueue[timerQueueSize] = nullptr;
+			timerQueueIndex            = NotInTimerQueue;
 		}
 
 		uint16_t id_get()
@@ -571,12 +565,11 @@ namespace
 		ThreadImpl *prev;
 		ThreadImpl *next;
 		///@}
-		/// Linked list fields to the global timer list, when this thread is
-		/// blocked with a timeout.
-		///@{
-		ThreadImpl *timerPrev;
-		ThreadImpl *timerNext;
-		///@}
+		/**
+		 * The index of this thread in `timerQueue`, or `NotInTimerQueue` if
+		 * this thread is not suspended.
+		 */
+		uint16_t timerQueueIndex = NotInTimerQueue;
 		/// Pointer to the list of the resource this thread is blocked on.
 		ThreadImpl **sleepQueue;
 		/**
@@ -627,6 +620,82 @@ namespace
 		CHERI_SEALED(TrustedStack *) tStackPtr;
 
 		private:
+		/**
+		 * Value of `timerQueueIndex` for threads that are not in the timer
+		 * queue.
+		 */
+		static constexpr uint16_t NotInTimerQueue =
+		  std::numeric_limits<uint16_t>::max();
+
+		/**
+		 * Returns the index of the parent of the timer queue slot `index`.
+		 */
+		static uint16_t timer_queue_parent(uint16_t index)
+		{
+			return (index - 1) / 2;
+		}
+
+		/**
+		 * Place `thread` in timer queue slot `index`.
+		 */
+		static void timer_queue_place(ThreadImpl *thread, uint16_t index)
+		{
+			timerQueue[index]       = thread;
+			thread->timerQueueIndex = index;
+		}
+
+		/**
+		 * Place `thread` in the timer queue, starting at the (vacant) slot
+		 * `index` and moving towards the root until its parent expires no
+		 * later than it does.
+		 */
+		static void timer_queue_sift_up(ThreadImpl *thread, uint16_t index)
+		{
+			while (index > 0)
+			{
+				uint16_t    parentIndex = timer_queue_parent(index);
+				ThreadImpl *parent      = timerQueue[parentIndex];
+				if (parent->expiryTime <= thread->expiryTime)
+				{
+					break;
+				}
+				timer_queue_place(parent, index);
+				index = parentIndex;
+			}
+			timer_queue_place(thread, index);
+		}
+
+		/**
+		 * Place `thread` in the timer queue, starting at the (vacant) slot
+		 * `index` and moving towards the leaves until neither child expires
+		 * before it does.
+		 */
+		static void timer_queue_sift_down(ThreadImpl *thread, uint16_t index)
+		{
+			while (true)
+			{
+				uint16_t childIndex = (2 * index) + 1;
+				if (childIndex >= timerQueueSize)
+				{
+					break;
+				}
+				ThreadImpl *child = timerQueue[childIndex];
+				if ((childIndex + 1 < timerQueueSize) &&
+				    (timerQueue[childIndex + 1]->expiryTime < child->expiryTime))
+				{
+					childIndex++;
+					child = timerQueue[childIndex];
+				}
+				if (thread->expiryTime <= child->expiryTime)
+				{
+					break;
+				}
+				timer_queue_place(child, index);
+				index = childIndex;
+			}
+			timer_queue_place(thread, index);
+		}
+
 		/**
 		 * Helper to remove a thread from the priority map and update the
 		 * highest priority, if it was the last runnable thread at that
@@ -662,6 +731,15 @@ namespace
 		static inline uint32_t priorityMap;
 		/// the highest priority of all the current threads that are ready
 		static inline uint16_t highestPriority;
+		/**
+		 * The timer queue.  This is a binary min-heap, ordered by
+		 * `expiryTime`, of all suspended threads.  Each thread records its own
+		 * index so that it can be removed in logarithmic time when it is
+		 * woken by something other than its timeout.
+		 */
+		static inline ThreadImpl *timerQueue[CONFIG_THREADS_NUM];
+		/// The number of threads in `timerQueue`.
+		static inline uint16_t timerQueueSize;
 
 		uint16_t threadId;
 		/**
@@ -81,12 +81,13 @@ namespace
 		 */
 		static void update()
 		{
-			auto *thread             = Thread::current_get();
-			bool  waitingListIsEmpty = ((Thread::waitingList == nullptr) ||
-                                       (Thread::waitingList->expiryTime == -1));
+			auto *thread          = Thread::current_get();
+			auto *nextExpiry      = Thread::timer_queue_head();
+			bool  timerQueueEmpty = ((nextExpiry == nullptr) ||
+			                        (nextExpiry->expiryTime == -1));
 			bool  threadHasNoPeers =
 			  (thread == nullptr) || (!thread->has_priority_peers());
-			if (waitingListIsEmpty && threadHasNoPeers)
+			if (timerQueueEmpty && threadHasNoPeers)
 			{
 				clear();
 			}
@@ -97,9 +98,9 @@ namespace
 				uint64_t nextTick  = threadHasNoPeers
 				                       ? DistantFuture
 				                       : time() + TIMERCYCLES_PER_TICK;
-				uint64_t nextTimer = waitingListIsEmpty
+				uint64_t nextTimer = timerQueueEmpty
 				                       ? DistantFuture
-				                       : Thread::waitingList->expiryTime;
+				                       : nextExpiry->expiryTime;
 				setnext(std::min(nextTick, nextTimer));
 			}
 		}
@@ -125,6 +126,11 @@ namespace
 		 * runnable threads.
 		 *
 		 * This should be called when a timer interrupt fires.
+		 *
+		 * Each expired thread costs one removal from the root of the timer
+		 * queue, which is at most log2(CONFIG_THREADS_NUM) steps.  Waking k
+		 * threads is therefore O(k log n), and the cost of finding that no
+		 * threads have expired is constant.
 		 */
 		static void expiretimers()
 		{
@@ -136,28 +142,14 @@ namespace
 
 			uint64_t now           = time();
 			Thread::ticksSinceBoot = (now - zeroTickTime) / FastDivisor;
-			if (Thread::waitingList == nullptr)
-			{
-				return;
-			}
-			for (Thread *iter = Thread::waitingList;;)
+			while (Thread *head = Thread::timer_queue_head())
 			{
-				if (iter->expiryTime <= now)
-				{
-					Thread *iterNext = iter->timerNext;
-
-					iter->ready(Thread::WakeReason::Timer);
-					iter = iterNext;
-					if (Thread::waitingList == nullptr ||
-					    iter == Thread::waitingList)
-					{
-						break;
-					}
-				}
-				else
+				if (head->expiryTime > now)
 				{
 					break;
 				}
+				// This removes the thread from the timer queue.
+				head->ready(Thread::WakeReason::Timer);
 			}
 			// If there are not runnable threads, try to wake a yielded thread
 			if (!Thread::any_ready())
@@ -172,7 +164,7 @@ namespace
 				//    with a 1-tick timeout.
 				// 3. A wakes up and prevents B from running even though we're
 				//    still in its 5-tick yield period.
-				if (Thread *head = Thread::waitingList)
+				if (Thread *head = Thread::timer_queue_head())
 				{
 					if (head->is_yielding())
 					{
@@ -4,7 +4,11 @@
 #include "../allocator/software_revoker.h"
 #include <array>
 #include <cheri.hh>
+#include <compartment.h>
 #include <debug.hh>
+#include <errno.h>
+#include <riscvreg.h>
+#include <token.h>
 #include <utility>
 
 using CHERI::Capability;
@@ -34,9 +38,31 @@ extern "C" volatile void *volatile *get_globals(int idx);
 namespace
 {
 	/**
-	 * The index of the current range to scan.  Must be 0 or -1.
+	 * The index of the current range to scan.  Range 0 is the one that the
+	 * loader provides, ranges from 1 are in `scanRanges`, and -1 means that
+	 * revocation is not running.
 	 */
 	int currentRange;
+
+	/**
+	 * Ranges registered with `revoker_scan_range_add`, scanned after the
+	 * loader's range.  Unused slots are null.
+	 */
+	volatile void *volatile *scanRanges[REVOKER_SCAN_RANGES];
+
+	/**
+	 * Returns a capability to the range with index `range`, as described for
+	 * `currentRange`.
+	 */
+	volatile void *volatile *range_get(int range)
+	{
+		if (range == 0)
+		{
+			return get_globals(0);
+		}
+		return scanRanges[range - 1];
+	}
+
 	/**
 	 * The current offset within the scanned range, in pointer-sized units.
 	 */
@@ -76,17 +102,56 @@ namespace
 			case State::NotRunning:
 				return {0, State::Scanning};
 			case State::Scanning:
+				for (int range = currentRange + 1; range <= REVOKER_SCAN_RANGES;
+				     range++)
+				{
+					if (range_get(range) != nullptr)
+					{
+						return {range, State::Scanning};
+					}
+				}
 				return {-1, State::NotRunning};
 		}
 	}
 
 	/**
-	 * The number of capabilities to scan per tick.  This probably needs some
-	 * tuning.  Invoking the revoker costs around 400 cycles on Flute, so we're
-	 * likely to be spending about half of our total time on domain transitions
-	 * with a value <100.
+	 * The number of capabilities to scan per tick with no pressure.  Invoking
+	 * the revoker costs around 400 cycles on Flute, so we're likely to be
+	 * spending about half of our total time on domain transitions with a
+	 * value <100.
+	 */
+	static constexpr size_t TickSizeMinimum = 1024;
+
+	/**
+	 * The number of capabilities to scan per tick when threads are blocked
+	 * waiting for the pass to finish.  Interrupts are disabled for the whole
+	 * tick, so this bounds the interrupt latency that revocation adds.
+	 */
+	static constexpr size_t TickSizeMaximum = 16384;
+
+	/**
+	 * Statistics for the pass that is running.
+	 */
+	SoftwareRevokerStatistics current;
+
+	/**
+	 * Statistics for the last complete pass, exposed read-only by
+	 * `revoker_statistics_get`.
 	 */
-	static constexpr size_t TickSize = 4096;
+	SoftwareRevokerStatistics last;
+
+	/**
+	 * Returns the number of capabilities to scan in a tick at `pressure`.
+	 * This interpolates linearly between the minimum and the maximum, which
+	 * gives the old fixed size of 4096 at a pressure of 20 (a fifth of the
+	 * heap in quarantine).
+	 */
+	size_t tick_size(uint32_t pressure)
+	{
+		pressure = std::min<uint32_t>(pressure, REVOKER_PRESSURE_MAX);
+		return TickSizeMinimum + (TickSizeMaximum - TickSizeMinimum) *
+		                           pressure / REVOKER_PRESSURE_MAX;
+	}
 
 	/**
 	 * Advance the state machine to the next state.
@@ -107,35 +172,103 @@ namespace
 		// If we have a new range, set the length to something sensible.
 		if (nextRange != -1)
 		{
-			length = __builtin_cheri_length_get(get_globals(currentRange)) /
+			length = __builtin_cheri_length_get(range_get(currentRange)) /
 			         sizeof(void *);
 		}
 		state = nextState;
 		// If we've finished a run, increment the epoch counter (it should now
-		// be even).
+		// be even) and publish the statistics for the run.
 		if (state == State::NotRunning)
 		{
 			epoch++;
 			assert((epoch & 1) == 0);
+			current.epoch = epoch;
+			last          = current;
+			current       = {};
+		}
+	}
+
+	/**
+	 * Tag summaries registered with `revoker_tag_summary_add`.
+	 */
+	const SoftwareRevokerTagSummary *summaries[REVOKER_TAG_SUMMARIES];
+
+	/**
+	 * Look up `address` in the tag summaries.  Returns the number of words
+	 * from `address` to the end of the summary block that contains it, and
+	 * whether that block may contain capabilities.  Addresses that are not
+	 * covered by a summary may contain capabilities, and the run extends to
+	 * the start of the next summary.
+	 */
+	std::pair<size_t, bool> summary_lookup(ptraddr_t address)
+	{
+		size_t run = SIZE_MAX;
+		for (const SoftwareRevokerTagSummary *summary : summaries)
+		{
+			if (summary == nullptr)
+			{
+				continue;
+			}
+			ptraddr_t base = summary->base;
+			ptraddr_t top =
+			  base + (ptraddr_t(summary->blocks) << summary->blockShift);
+			if (address < base)
+			{
+				run = std::min<size_t>(run, (base - address) / sizeof(void *));
+				continue;
+			}
+			if (address >= top)
+			{
+				continue;
+			}
+			size_t    block = (address - base) >> summary->blockShift;
+			ptraddr_t blockEnd =
+			  base + (ptraddr_t(block + 1) << summary->blockShift);
+			bool mayHoldCapabilities =
+			  (summary->bits[block / 32] >> (block % 32)) & 1;
+			return {(blockEnd - address) / sizeof(void *),
+			        mayHoldCapabilities};
 		}
+		return {run, true};
 	}
 
 	/**
-	 * Scan a fixed-size range of the current memory region.
+	 * Scan a range of the current memory region, of a size determined by
+	 * `pressure`.  Blocks that the tag summaries report do not contain
+	 * capabilities are skipped and do not count towards the size.
 	 */
-	void scan_range()
+	void scan_range(uint32_t pressure)
 	{
-		size_t end     = offset + std::min(length - offset, TickSize);
-		auto   current = get_globals(currentRange);
-		// With interrupts disabled, loading and storing a capability will
-		// clear the tag on anything that has been revoked via the load
-		// barrier.
-		for (int i = offset; i < end; i++)
+		uint64_t  start  = rdcycle64();
+		size_t    budget = tick_size(pressure);
+		auto      words  = range_get(currentRange);
+		ptraddr_t base   = __builtin_cheri_address_get(words);
+		while ((offset < length) && (budget > 0))
 		{
-			current[i] = current[i];
+			auto [run, mayHoldCapabilities] =
+			  summary_lookup(base + offset * sizeof(void *));
+			size_t end = offset + std::min(run, length - offset);
+			if (!mayHoldCapabilities)
+			{
+				current.skipped += end - offset;
+				offset = end;
+				continue;
+			}
+			end = std::min(end, offset + budget);
+			// With interrupts disabled, loading and storing a capability will
+			// clear the tag on anything that has been revoked via the load
+			// barrier.
+			for (size_t i = offset; i < end; i++)
+			{
+				words[i] = words[i];
+			}
+			current.scanned += end - offset;
+			budget -= end - offset;
+			// Record the amount that we've scanned.
+			offset = end;
 		}
-		// Record the amount that we've scanned.
-		offset = end;
+		current.ticks++;
+		current.cycles += static_cast<uint32_t>(rdcycle64() - start);
 		// Advance to the next state if we've finished scanning this range.
 		if (offset == length)
 		{
@@ -145,7 +278,7 @@ namespace
 
 } // namespace
 
-int revoker_tick()
+int revoker_tick(uint32_t pressure)
 {
 	// If we've been asked to run, make sure that we're running.
 	if (state == State::NotRunning)
@@ -153,7 +286,7 @@ int revoker_tick()
 		advance();
 	}
 	// Do some work.
-	scan_range();
+	scan_range(pressure);
 
 	return 0;
 }
@@ -164,3 +297,74 @@ const uint32_t *revoker_epoch_get()
 	epochPtr.permissions() &= {Permission::Load, Permission::Global};
 	return epochPtr;
 }
+
+int revoker_tag_summary_add(TagSummaryCapability             authority,
+                            const SoftwareRevokerTagSummary *summary)
+{
+	if (token_obj_unseal_static(STATIC_SEALING_TYPE(TagSummaryKey),
+	                            authority) == nullptr)
+	{
+		return -EPERM;
+	}
+	// The summary is kept and read on every tick, so it must be a global,
+	// readable, capability to a whole summary.
+	Capability<const SoftwareRevokerTagSummary> summaryCap{summary};
+	if (!summaryCap.is_valid() || summaryCap.is_sealed() ||
+	    !summaryCap.permissions().contains(Permission::Load,
+	                                       Permission::Global) ||
+	    (summaryCap.length() < sizeof(SoftwareRevokerTagSummary)) ||
+	    (summary->blocks > REVOKER_TAG_SUMMARY_BLOCKS) ||
+	    (summary->blockShift < 3) || (summary->blockShift >= 32))
+	{
+		return -EINVAL;
+	}
+	for (auto &slot : summaries)
+	{
+		if (slot == nullptr)
+		{
+			slot = summary;
+			return 0;
+		}
+	}
+	return -ENOSPC;
+}
+
+int revoker_scan_range_add(TagSummaryCapability authority, void *range)
+{
+	if (token_obj_unseal_static(STATIC_SEALING_TYPE(TagSummaryKey),
+	                            authority) == nullptr)
+	{
+		return -EPERM;
+	}
+	// The range is kept and scanned by every pass, which loads and stores
+	// every capability in it.
+	Capability<volatile void *volatile> rangeCap{
+	  static_cast<volatile void *volatile *>(range)};
+	if (!rangeCap.is_valid() || rangeCap.is_sealed() ||
+	    !rangeCap.permissions().contains(Permission::Load,
+	                                     Permission::Store,
+	                                     Permission::LoadStoreCapability,
+	                                     Permission::LoadMutable,
+	                                     Permission::Global) ||
+	    (rangeCap.length() < sizeof(void *)))
+	{
+		return -EINVAL;
+	}
+	rangeCap.address() = rangeCap.base();
+	for (auto &slot : scanRanges)
+	{
+		if (slot == nullptr)
+		{
+			slot = rangeCap;
+			return 0;
+		}
+	}
+	return -ENOSPC;
+}
+
+const SoftwareRevokerStatistics *revoker_statistics_get()
+{
+	Capability<SoftwareRevokerStatistics> statisticsPtr{&last};
+	statisticsPtr.permissions() &= {Permission::Load, Permission::Global};
+	return statisticsPtr;
+}
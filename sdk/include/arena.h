@@ -0,0 +1,102 @@
+// Copyright CHERIoT Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+/**
+ * This file contains the interface for a bump-pointer arena allocator,
+ * implemented in the `arena` library.
+ *
+ * An arena carves a single heap allocation into many small objects.  Each
+ * sub-allocation is a capability bounded to the object, so spatial safety is
+ * preserved between objects in the same arena, but sub-allocations are not
+ * individually freed.  Instead, the entire arena is released at once, either
+ * by resetting it (which makes the space available for reuse without a call
+ * into the allocator) or by destroying it (which returns the backing memory to
+ * the heap with a single `heap_free`).
+ *
+ * Arenas are intended for workloads that make many small, short-lived
+ * allocations with a common lifetime, such as parsing a network message.  The
+ * backing allocation is charged to the quota of the allocator capability used
+ * to create the arena, and so is subject to the normal quota limits.
+ *
+ * Note that `arena_reset` does *not* revoke capabilities to objects that were
+ * allocated from the arena.  Code that resets an arena must ensure that no
+ * pointers to previous sub-allocations are used after the reset.  Destroying
+ * the arena frees the backing memory via the allocator and so gives the usual
+ * temporal-safety guarantees.
+ */
+
+#include <cdefs.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <timeout.h>
+
+struct Arena;
+
+/**
+ * The minimum alignment of all objects returned from `arena_allocate`.  Larger
+ * objects may be more strongly aligned to ensure that their bounds are
+ * precisely representable.
+ */
+#define ARENA_ALIGNMENT 8
+
+__BEGIN_DECLS
+
+/**
+ * Create a new arena that can hold at least `capacity` bytes of objects,
+ * allocated using `heapCapability`.  The arena is returned via `outArena`.
+ *
+ * Space for the arena's own state is allocated in addition to `capacity`.
+ * Individual objects may require padding to meet alignment requirements and
+ * so the total size of the objects that can be allocated may be less than
+ * `capacity`.
+ *
+ * This returns zero on success.  Otherwise it returns a negative error code
+ * and, if `outArena` is a valid pointer, sets `*outArena` to null.  If
+ * `outArena` is not a valid writeable pointer or the size calculation
+ * overflows then this returns `-EINVAL`, if memory cannot be allocated it
+ * returns `-ENOMEM`.
+ */
+int __cheri_libcall arena_create(Timeout            *timeout,
+                                 AllocatorCapability heapCapability,
+                                 size_t              capacity,
+                                 struct Arena      **outArena);
+
+/**
+ * Allocate `size` bytes from `arena`.  The returned capability is bounded to
+ * the object and the memory is zeroed.
+ *
+ * This does not call into the allocator compartment.  It returns null if the
+ * arena does not have enough space remaining or if `size` is zero.
+ */
+void *__cheri_libcall arena_allocate(struct Arena *arena, size_t size);
+
+/**
+ * Returns the number of bytes that remain available in `arena`.  Alignment
+ * padding means that a single allocation of this size is guaranteed to
+ * succeed, but several smaller allocations may not.
+ */
+size_t __cheri_libcall arena_remaining(struct Arena *arena);
+
+/**
+ * Release all objects allocated from `arena`, making the space available for
+ * reuse.  This runs in constant time and does not call into the allocator.
+ *
+ * Capabilities to objects previously allocated from the arena are *not*
+ * invalidated.  The caller is responsible for ensuring that they are not used
+ * after this call.
+ */
+void __cheri_libcall arena_reset(struct Arena *arena);
+
+/**
+ * Destroy `arena`, freeing the backing memory with a single call to
+ * `heap_free`.  All capabilities to objects allocated from the arena will be
+ * invalidated by the allocator's temporal safety mechanism.
+ *
+ * This returns the result of `heap_free`: zero on success or a negative error
+ * code if the arena was not allocated with `heapCapability`.
+ */
+int __cheri_libcall arena_destroy(AllocatorCapability heapCapability,
+                                  struct Arena       *arena);
+
+__END_DECLS
@@ -0,0 +1,82 @@
+// Copyright CHERIoT Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+#include <arena.h>
+#include <cstddef>
+
+/**
+ * C++ allocator adaptor for arenas.  This allows standard library containers
+ * to allocate their storage from an `Arena`, for example:
+ *
+ * ```c++
+ * std::vector<int, ArenaAllocator<int>> v{ArenaAllocator<int>{arena}};
+ * ```
+ *
+ * Deallocation is a no-op: the storage used by the container is reclaimed
+ * when the arena is reset or destroyed.  Containers that repeatedly grow and
+ * shrink will therefore consume arena space for every reallocation.
+ *
+ * The RTOS does not support exceptions, so `allocate` returns null if the
+ * arena is exhausted.
+ */
+template<typename T>
+class ArenaAllocator
+{
+	static_assert(alignof(T) <= ARENA_ALIGNMENT,
+	              "Arena allocations are not sufficiently aligned for T");
+
+	/// The arena that this allocates from.
+	Arena *arena;
+
+	public:
+	using value_type = T;
+
+	/**
+	 * Construct an allocator that allocates from `arena`.
+	 */
+	explicit ArenaAllocator(Arena *arena) : arena(arena) {}
+
+	/**
+	 * Converting constructor, used by containers that allocate internal node
+	 * types.
+	 */
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena_get())
+	{
+	}
+
+	/**
+	 * Allocate space for `n` objects of type `T`.
+	 */
+	T *allocate(size_t n)
+	{
+		size_t size;
+		if (__builtin_mul_overflow(n, sizeof(T), &size))
+		{
+			return nullptr;
+		}
+		return static_cast<T *>(arena_allocate(arena, size));
+	}
+
+	/**
+	 * Deallocation is deferred until the arena is reset or destroyed.
+	 */
+	void deallocate(T *, size_t) {}
+
+	/**
+	 * Returns the arena that this allocator uses.
+	 */
+	[[nodiscard]] Arena *arena_get() const
+	{
+		return arena;
+	}
+
+	/**
+	 * Allocators compare equal if they allocate from the same arena.
+	 */
+	template<typename U>
+	bool operator==(const ArenaAllocator<U> &other) const
+	{
+		return arena == other.arena_get();
+	}
+};
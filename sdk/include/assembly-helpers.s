@@ -87,3 +87,52 @@
 	auicgp		\register, %cheriot_compartment_hi(\symbol)
 	clc			\register, %cheriot_compartment_lo_i(1b)(\register)
 .endm
+
+/**
+ * Zero the memory from `base` to `top` with capability-width stores of
+ * `cnull`, which also clears tags.  The base must be a capability but it must
+ * be provided without the c prefix because it is used as both a capability
+ * and an integer register.  The top is an address.  Both must be
+ * capability-aligned.  The base and scratch registers are clobbered.
+ *
+ * Large ranges are zeroed in 64-byte chunks, with straight-line 32-, 16- and
+ * 8-byte tails, so the loop branch is taken once per eight stores and a
+ * small range executes at most one taken branch.
+ */
+.macro zero_capabilities base top scratch
+	addi               \scratch, \top, -64
+	bltu               \scratch, \base, 1f
+	// Zero in 64-byte chunks
+0:
+	csc                cnull, 0(c\base)
+	csc                cnull, 8(c\base)
+	csc                cnull, 16(c\base)
+	csc                cnull, 24(c\base)
+	csc                cnull, 32(c\base)
+	csc                cnull, 40(c\base)
+	csc                cnull, 48(c\base)
+	csc                cnull, 56(c\base)
+	cincoffset         c\base, c\base, 64
+	bgeu               \scratch, \base, 0b
+1:
+	// Zero any 32-byte tail
+	addi               \scratch, \top, -32
+	bltu               \scratch, \base, 2f
+	csc                cnull, 0(c\base)
+	csc                cnull, 8(c\base)
+	csc                cnull, 16(c\base)
+	csc                cnull, 24(c\base)
+	cincoffset         c\base, c\base, 32
+2:
+	// Zero any 16-byte tail
+	addi               \scratch, \top, -16
+	bltu               \scratch, \base, 3f
+	csc                cnull, 0(c\base)
+	csc                cnull, 8(c\base)
+	cincoffset         c\base, c\base, 16
+3:
+	// Zero any 8-byte tail
+	bgeu               \base, \top, 4f
+	csc                cnull, 0(c\base)
+4:
+.endm
@@ -23,11 +23,13 @@
  * stack: the scheduler does not need to hold a copy of it between calls or
  * write to it from another thread.
  *
- * The multiwaiter should be used sparingly.  In the worst case, it can add a
- * linear-complexity overhead on all wake events.  Memory overhead and code
- * size have been the key optimisation goals for this design.  Unlike systems
- * such as `kqueue`, scalability has not been a priority in this design because
- * expected number of waited objects is small and so is the number of threads.
+ * While a thread is blocked, the scheduler indexes its multiwaiter's events by
+ * futex address, so a wake event visits only the multiwaiters that are
+ * waiting on that address (and any that share its hash bucket).  Memory
+ * overhead and code size remain the key optimisation goals for this design.
+ * Unlike systems such as `kqueue`, the multiwaiter does not scale to large
+ * numbers of event sources: each multiwaiter holds at most a small, fixed
+ * number of events.
  */
 #include <compartment.h>
 #include <stdlib.h>
@@ -100,3 +102,59 @@ typedef CHERI_SEALED(struct MultiWaiterInternal *) MultiWaiter;
                    MultiWaiter               waiter,
                    struct EventWaiterSource *events,
                    size_t                    newEventsCount);
+
+/**
+ * Attach a persistent set of event sources to a multiwaiter.  This is an
+ * alternative to passing the events to each `multiwaiter_wait` call, for event
+ * loops that wait on the same sources repeatedly.  The sources are validated
+ * and copied once, here, and are then used by every subsequent
+ * `multiwaiter_wait_attached` call.
+ *
+ * Each element of `events` describes a futex word and the value that it is
+ * expected to hold, exactly as for `multiwaiter_wait`.  Because the scheduler
+ * retains a (read-only) capability to each futex word, the futex words must
+ * not be on the stack.
+ *
+ * Attaching replaces any previously attached sources.  Passing a `count` of
+ * zero (and, optionally, a null `events`) detaches all sources, after which
+ * the multiwaiter can be used with `multiwaiter_wait` again.  While sources
+ * are attached, `multiwaiter_wait` returns `-EBUSY`.
+ *
+ * Return values:
+ *
+ *  - On success, this function returns `0`.
+ *  - If the arguments are invalid, this function returns `-EINVAL` and
+ *    leaves the multiwaiter with no attached sources.
+ *  - If another thread is currently waiting on this multiwaiter, this
+ *    function returns `-EBUSY`.
+ */
+[[cheriot::interrupt_state(disabled)]] int __cheri_compartment("scheduler")
+  multiwaiter_attach(MultiWaiter               waiter,
+                     struct EventWaiterSource *events,
+                     size_t                    count);
+
+/**
+ * Wait for any of the event sources attached with `multiwaiter_attach`.
+ *
+ * Attached sources are edge triggered: an event fires if its futex word does
+ * not contain the expected value.  When an event is reported, its expected
+ * value is updated to the value of the futex word at the time that this call
+ * returns.  It will therefore fire again only when the word next changes.
+ * Callers should consume all pending work for a source (for example, drain a
+ * queue) before waiting again.
+ *
+ * Return values:
+ *
+ *  - On success, this function returns a positive bitmask of the events that
+ *    fired.  Bit *n* corresponds to element *n* of the array passed to
+ *    `multiwaiter_attach`.
+ *  - If the arguments are invalid, no sources are attached, or one of the
+ *    attached futex words has been deallocated, this function returns
+ *    `-EINVAL`.
+ *  - If another thread is currently waiting on this multiwaiter, this
+ *    function returns `-EBUSY`.
+ *  - If the timeout is reached without any events being triggered then this
+ *    returns `-ETIMEDOUT`.
+ */
+[[cheriot::interrupt_state(disabled)]] int __cheri_compartment("scheduler")
+  multiwaiter_wait_attached(Timeout *timeout, MultiWaiter waiter);
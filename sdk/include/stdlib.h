@@ -36,11 +36,34 @@ struct AllocatorCapabilityState
 	/// The number of bytes that the capability will permit to be allocated.
 	size_t quota;
 	/// Reserved space for internal use.
-	size_t unused;
+	uint16_t unused;
+	/// Flags from `AllocatorCapabilityFlags` requesting optional behaviour.
+	uint16_t flags;
 	/// Reserved space for internal use.
 	uintptr_t reserved[2];
 };
 
+/**
+ * Flags that can be set in an allocator capability to opt into optional
+ * allocator behaviour.
+ */
+enum [[clang::flag_enum]] AllocatorCapabilityFlags
+{
+	/**
+	 * Keep a small per-capability cache of freed small (up to 128-byte)
+	 * objects, grouped by size.  Objects enter the cache only after they
+	 * have been freed and zeroed and can be reused only once a revocation
+	 * pass has completed, so this provides the same temporal safety
+	 * guarantees as the shared quarantine.  Allocations that can be served
+	 * from the cache avoid searching the free lists.  The number of caches
+	 * is limited.  A capability takes a cache when it frees an object and
+	 * gives it back when the cache empties or `heap_free_all` is called.
+	 * Capabilities that cannot take a cache behave as if this flag were not
+	 * set.
+	 */
+	AllocatorCapabilitySizeClassCache = (1 << 0),
+};
+
 /**
  * Type for allocator capabilities.
  */
@@ -58,12 +81,21 @@ typedef CHERI_SEALED(struct AllocatorCapabilityState *) AllocatorCapability;
  * quota.
  */
 #define DEFINE_ALLOCATOR_CAPABILITY(name, quota)                               \
+	DEFINE_ALLOCATOR_CAPABILITY_WITH_FLAGS(name, quota, 0)
+
+/**
+ * Helper macro to define an allocator capability authorising the specified
+ * quota, with `flags` (from `AllocatorCapabilityFlags`) enabling optional
+ * allocator behaviour.
+ */
+#define DEFINE_ALLOCATOR_CAPABILITY_WITH_FLAGS(name, quota, flags)             \
 	DEFINE_STATIC_SEALED_VALUE(struct AllocatorCapabilityState,                \
 	                           allocator,                                      \
 	                           MallocKey,                                      \
 	                           name,                                           \
 	                           (quota),                                        \
 	                           0,                                              \
+	                           (flags),                                        \
 	                           {0, 0});
 
 /**
@@ -74,6 +106,14 @@ typedef CHERI_SEALED(struct AllocatorCapabilityState *) AllocatorCapability;
 	DECLARE_ALLOCATOR_CAPABILITY(name);                                        \
 	DEFINE_ALLOCATOR_CAPABILITY(name, quota)
 
+/**
+ * Helper macro to define an allocator capability with flags without a
+ * separate declaration.
+ */
+#define DECLARE_AND_DEFINE_ALLOCATOR_CAPABILITY_WITH_FLAGS(name, quota, flags) \
+	DECLARE_ALLOCATOR_CAPABILITY(name);                                        \
+	DEFINE_ALLOCATOR_CAPABILITY_WITH_FLAGS(name, quota, flags)
+
 #ifndef CHERIOT_NO_AMBIENT_MALLOC
 /**
  * Declare a default capability for use with malloc-style APIs.  Compartments
@@ -146,6 +186,39 @@ enum [[clang::flag_enum]] AllocateWaitFlags
 	                   AllocateWaitQuotaExceeded | AllocateWaitHeapFull),
 };
 
+/**
+ * Placement hints for allocations.  These may be combined with
+ * `AllocateWaitFlags` in the `flags` argument to the allocation functions.
+ *
+ * Boards may provide heap regions in addition to the primary heap (region 0),
+ * as devices named `heap_region1` to `heap_region3`, for example to expose a
+ * bank of slower memory.  By default, the allocator tries the primary heap
+ * first and then the other regions in order.
+ * `ALLOCATE_PLACEMENT_REGION(n)` requests that region `n` is tried first.
+ */
+enum [[clang::flag_enum]] AllocatePlacementFlags
+{
+	/**
+	 * Fail, rather than using another region, if the allocation cannot be
+	 * satisfied from the region requested with `ALLOCATE_PLACEMENT_REGION`.
+	 * The allocation will fail if that region does not exist.
+	 */
+	AllocatePlacementStrict = (1 << 12),
+};
+
+/**
+ * Placement hint requesting heap region `region` (0-14).  The region is
+ * stored in bits 8-11 of the flags, offset by one so that zero means no
+ * preference.
+ */
+#define ALLOCATE_PLACEMENT_REGION(region) ((((region) + 1) & 0xf) << 8)
+
+/**
+ * Extract the region requested with `ALLOCATE_PLACEMENT_REGION` from `flags`.
+ * Returns -1 if there is no preference.
+ */
+#define ALLOCATE_PLACEMENT_REGION_GET(flags) ((int)(((flags) >> 8) & 0xf) - 1)
+
 /**
  * Non-standard allocation API.  Allocates `size` bytes.
  *
@@ -209,6 +282,66 @@ void *__cheri_compartment("allocator")
                       size_t              size,
                       uint32_t flags      __if_cxx(= AllocateWaitAny));
 
+/**
+ * Non-standard reallocation API.  Returns an allocation of at least `size`
+ * bytes whose initial contents are those of `ptr`, up to the smaller of the
+ * two sizes, and with any remaining space zeroed.  `ptr` must be a pointer to
+ * the whole of an allocation (as returned from `heap_allocate`) owned by
+ * `heapCapability`.  If `ptr` is null then this behaves like `heap_allocate`.
+ * If `size` is zero and `ptr` is not null then this fails, leaving `ptr`
+ * valid: use `heap_free` to free an allocation.
+ *
+ * If the allocation is already large enough then it is not changed and a
+ * capability to the whole of it is returned.  The allocator never shrinks an
+ * allocation in place, because a stale capability with the old bounds could
+ * then reach memory that has been reused.  Growing in place is safe because
+ * existing capabilities keep their narrower bounds, so if the chunk that
+ * follows the allocation is free then the allocation is extended in place and
+ * `ptr` remains valid.  Otherwise, a new allocation is made, the contents are
+ * copied, and `ptr` is freed.  In every case, the returned capability is
+ * bounded to the whole allocation and has no more permissions than `ptr`.
+ *
+ * The `timeout` and `flags` parameters control blocking while waiting for a
+ * new allocation, as for `heap_allocate`, and the additional space is charged
+ * to the quota of `heapCapability`.  On failure, this returns `nullptr` and
+ * `ptr` remains valid and unmodified.  It may also return `-ENOTENOUGHSTACK`
+ * (see `heap_allocate`).
+ */
+void *__cheri_compartment("allocator")
+  heap_reallocate(Timeout            *timeout,
+                  AllocatorCapability heapCapability,
+                  void               *ptr,
+                  size_t              size,
+                  uint32_t flags      __if_cxx(= AllocateWaitAny));
+
+/**
+ * Non-standard batched allocation API.  Allocates `count` objects, where the
+ * size of object `i` is `sizes[i]`, storing a pointer to each object in
+ * `allocations[i]`.  This is equivalent to calling `heap_allocate` once for
+ * each object, but performs a single compartment call and acquires the
+ * allocator's lock once for the whole batch.
+ *
+ * Each request succeeds or fails independently.  Entries of `allocations` for
+ * requests that could not be satisfied are set to `nullptr`.  The `timeout`
+ * and `flags` parameters apply to the batch as a whole and have the same
+ * meaning as for `heap_allocate`.  If the timeout expires while blocking, the
+ * remaining requests are not attempted.
+ *
+ * Returns the number of objects allocated, `-EINVAL` if the timeout or either
+ * array is not valid, `-EPERM` if `heapCapability` is not a valid allocator
+ * capability, or `-ENOTENOUGHSTACK` if the stack is insufficiently large to
+ * run the function.
+ *
+ * Memory returned from this interface is guaranteed to be zeroed.
+ */
+ssize_t __cheri_compartment("allocator")
+  heap_allocate_many(Timeout            *timeout,
+                     AllocatorCapability heapCapability,
+                     size_t              count,
+                     const size_t       *sizes,
+                     void              **allocations,
+                     uint32_t flags      __if_cxx(= AllocateWaitAny));
+
 /**
  * Add a claim to an allocation.  The object will be counted against the quota
  * provided by the first argument until a corresponding call to `heap_free`.
@@ -266,7 +399,55 @@ int __cheri_compartment("allocator")
   heap_free(AllocatorCapability heapCapability, void *ptr);
 
 /**
- * Free all allocations owned by this capability.
+ * Free a heap allocation without waiting for other threads to finish using
+ * the allocator.  If another thread holds the allocator's lock, this checks
+ * that the arguments are valid capabilities and that `ptr` points into the
+ * heap, and queues the free.  The queue is drained by the next thread to
+ * allocate or free memory or to process the quarantine, and by threads that
+ * are waiting for memory or for revocation.  Otherwise, this is equivalent to
+ * `heap_free`.  If the queue is full, this waits for the lock and frees the
+ * object immediately.
+ *
+ * Returns 0 if the object was freed, `-EINPROGRESS` if the free was queued,
+ * `-EPERM` if `heapCapability` is not a valid allocator capability, `-EINVAL`
+ * if `ptr` is not a valid pointer to a heap allocation, or `-ENOTENOUGHSTACK`
+ * if the stack size is insufficiently large to safely run the function.
+ * Ownership, claims, and double frees cannot be checked without the lock, so
+ * a queued free may still fail (for example, if `ptr` is not owned or claimed
+ * by `heapCapability`), but this is not reported.  The object remains
+ * accessible until the queued free is performed.
+ */
+int __cheri_compartment("allocator")
+  heap_free_deferred(AllocatorCapability heapCapability, void *ptr);
+
+/**
+ * Free `count` heap allocations, passed in the `allocations` array.  This is
+ * equivalent to calling `heap_free` once for each pointer, but performs a
+ * single compartment call and acquires the allocator's lock once for the
+ * whole batch.  Null entries are skipped.
+ *
+ * Each entry that is successfully freed (or has a claim dropped) is replaced
+ * with `nullptr`, entries that could not be freed are left unmodified.  If
+ * `allocations` is itself a heap allocation that is in the batch, then it is
+ * freed after all of the other entries and its entry is not modified.  Any
+ * further entries that refer to the array's allocation are ignored.
+ *
+ * Returns the number of entries freed, `-EINVAL` if `count` is too large or
+ * `allocations` is not a valid, writeable array of `count` pointers (in which
+ * case no entries are freed), `-EPERM` if `heapCapability` is not a valid
+ * allocator capability, or `-ENOTENOUGHSTACK` if the stack is insufficiently
+ * large to run the function.
+ */
+ssize_t __cheri_compartment("allocator")
+  heap_free_many(AllocatorCapability heapCapability,
+                 size_t              count,
+                 void              **allocations);
+
+/**
+ * Free all allocations owned by this capability.  The allocator records the
+ * parts of the heap in which each capability has allocated or claimed memory,
+ * so this does not need to examine the entire heap.  This also empties and
+ * releases the capability's size-class cache, if it has one.
  *
  * Returns the number of bytes freed, `-EPERM` if this is not a valid heap
  * capability, or `-ENOTENOUGHSTACK` if the stack size is insufficiently large
@@ -285,22 +466,47 @@ int __cheri_compartment("allocator")
 /**
  * Returns the space available in the given quota. This will return -1 if
  * `heapCapability` is not valid or if the stack is insufficient to run the
- * function.
+ * function.  Memory held in the capability's size-class cache (see
+ * `AllocatorCapabilitySizeClassCache`) is reported as unavailable.
  */
 ssize_t __cheri_compartment("allocator")
   heap_quota_remaining(AllocatorCapability heapCapability);
 
+/**
+ * Reserve `bytes` of the heap for allocations with `heapCapability`.  Once
+ * this has succeeded, allocations with other allocator capabilities fail (or
+ * block, as if the heap were full) if they would leave less free memory than
+ * the unused part of the reservation.  Chunks (including their headers)
+ * allocated with `heapCapability` are drawn from the reservation until it is
+ * used up, and return to it when freed.  Claims are charged to the quota but
+ * do not draw from the reservation.  The allocator's own metadata, such as
+ * the storage for claims, may not eat into the reservation.  The reservation
+ * guarantees a number of free bytes, not a contiguous range, so fragmentation
+ * may still prevent a large allocation.
+ *
+ * Each capability can hold one reservation.  Calling this again replaces it,
+ * and passing zero for `bytes` releases it.
+ *
+ * Returns 0 on success, `-EPERM` if `heapCapability` is not a valid allocator
+ * capability, `-EINVAL` if `bytes` is larger than the capability's remaining
+ * quota, `-ENOMEM` if there is not enough unreserved free memory, `-ENOSPC`
+ * if too many capabilities hold reservations, or `-ENOTENOUGHSTACK` if the
+ * stack is insufficient to run the function.
+ */
+int __cheri_compartment("allocator")
+  heap_reserve(AllocatorCapability heapCapability, size_t bytes);
+
 /**
  * Try to empty the quarantine and defragment the heap.
  *
  * This will (finish and then) run a revocation sweep and try to empty the
  * quarantine.  In normal operation, the allocator will remove a small number of
- * allocations from quarantine on each allocation.  Allocations are not
- * coalesced until they are moved from quarantine, so this can cause
- * fragmentation.  If you have just freed a lot of memory (for example, after
- * resetting a compartment and calling `heap_free_all`), especially if you have
- * freed a lot of small allocations, then calling this function will likely
- * reduce fragmentation.
+ * allocations from quarantine on each allocation.  Allocations that were not
+ * freed during the same revocation epoch are not coalesced until they are
+ * moved from quarantine, so this can cause fragmentation.  If you have just
+ * freed a lot of memory (for example, after resetting a compartment and calling
+ * `heap_free_all`), especially if you have freed a lot of small allocations,
+ * then calling this function will likely reduce fragmentation.
  *
  * Calling this function will ensure that all objects freed before the call are
  * out of quarantine (unless a timeout occurs).  Objects freed concurrently (by
@@ -318,6 +524,24 @@ ssize_t __cheri_compartment("allocator")
 __attribute__((overloadable)) int __cheri_compartment("allocator")
   heap_quarantine_flush(Timeout *timeout);
 
+/**
+ * Move objects whose revocation has finished from the quarantine to the free
+ * lists, without waiting for revocation.  If the RTOS is built with
+ * --allocator-incremental-zeroing=y, freed objects are zeroed as they leave
+ * quarantine rather than when they are freed, and this is where that zeroing
+ * happens.
+ *
+ * The allocator does this work in bounded slices on the allocation and free
+ * paths anyway.  This function allows a low-priority thread to do it ahead
+ * of time, so that it does not add to the latency of other threads'
+ * allocations.  The allocator lock is released between slices.
+ *
+ * Returns 0 when there is no more work that can be done without waiting for
+ * revocation, `-ETIMEDOUT` if the timeout expires first, or `-EINVAL` if the
+ * timeout is not valid.
+ */
+int __cheri_compartment("allocator") heap_quarantine_process(Timeout *timeout);
+
 /**
  * Run `heap_quarantine_flush` with unlimited timeout.
  *
@@ -350,7 +574,34 @@ __if_c(static) inline _Bool heap_address_is_valid(const void *object)
 	// base is within the range of the heap.  Anything derived from a non-heap
 	// capability must have a base outside of that range.
 	ptraddr_t address = __builtin_cheri_base_get(object);
-	return (address >= heap_start) && (address < heap_end);
+	if ((address >= heap_start) && (address < heap_end))
+	{
+		return true;
+	}
+	// Additional heap regions, if the board provides them, are also owned
+	// exclusively by the allocator.
+#if DEVICE_EXISTS(heap_region1)
+	if ((address >= LA_ABS(__export_mem_heap_region1)) &&
+	    (address < LA_ABS(__export_mem_heap_region1_end)))
+	{
+		return true;
+	}
+#endif
+#if DEVICE_EXISTS(heap_region2)
+	if ((address >= LA_ABS(__export_mem_heap_region2)) &&
+	    (address < LA_ABS(__export_mem_heap_region2_end)))
+	{
+		return true;
+	}
+#endif
+#if DEVICE_EXISTS(heap_region3)
+	if ((address >= LA_ABS(__export_mem_heap_region3)) &&
+	    (address < LA_ABS(__export_mem_heap_region3_end)))
+	{
+		return true;
+	}
+#endif
+	return false;
 }
 
 /**
@@ -362,6 +613,138 @@ __if_c(static) inline _Bool heap_address_is_valid(const void *object)
  */
 int __cheri_compartment("allocator") heap_render();
 
+/**
+ * Write the allocation trace to the debug console and then clear it.
+ *
+ * If the RTOS is built with --allocator-tracing=y, the allocator records the
+ * most recent allocations and frees (operation, allocator capability
+ * identifier, chunk address, size and cycles taken) in a ring buffer.  The
+ * output of this function can be converted with
+ * `scripts/heap_trace_to_replay.py` and replayed with the
+ * `benchmarks/allocation-replay` benchmark.  The allocator lock is held while
+ * the trace is written, so this will delay other allocator operations.
+ *
+ * If the RTOS is not built with --allocator-tracing=y, this is a no-op.
+ *
+ * Returns zero on success, non-zero on error (e.g. compartment call failure).
+ */
+int __cheri_compartment("allocator") heap_trace_dump();
+
+/// The number of small (exact-size) free bins reported by `heap_statistics`.
+#define HEAP_STATISTICS_SMALL_BINS 8
+/// The number of tree (size-range) free bins reported by `heap_statistics`.
+#define HEAP_STATISTICS_TREE_BINS 12
+/// The number of quarantine rings reported by `heap_statistics`.
+#define HEAP_STATISTICS_QUARANTINE_RINGS 2
+/// The number of buckets in each latency histogram.
+#define HEAP_STATISTICS_HISTOGRAM_BUCKETS 16
+/**
+ * Log2 of the upper bound (exclusive) of the first latency histogram bucket.
+ * Bucket 0 counts operations that took fewer than `1 << 7` cycles, bucket `i`
+ * counts operations that took `[1 << (i + 6), 1 << (i + 7))` cycles, and the
+ * last bucket also counts everything slower than that.
+ */
+#define HEAP_STATISTICS_HISTOGRAM_SHIFT 7
+
+/**
+ * A snapshot of the allocator's internal state, filled in by
+ * `heap_statistics`.  This is intended for telemetry: it can be used to
+ * observe fragmentation, quarantine pressure and allocation latency in
+ * deployed systems, without building the RTOS with `--allocator-rendering`.
+ *
+ * All sizes are in bytes and include the allocator's per-chunk headers.
+ */
+struct HeapStatistics
+{
+	/// The total size of the heap.
+	size_t heapSize;
+	/// The number of bytes that are free and can be allocated immediately.
+	size_t freeBytes;
+	/// The number of bytes that are waiting for revocation.
+	size_t quarantinedBytes;
+	/// The size of the largest free chunk.
+	size_t largestFreeChunk;
+	/**
+	 * Free bytes in each small bin.  Small bin `i` holds chunks of exactly
+	 * `(i + 1) * 8` bytes, so bin 0 is always empty.
+	 */
+	size_t smallBinFreeBytes[HEAP_STATISTICS_SMALL_BINS];
+	/// Free bytes in each tree bin, which hold larger chunks.
+	size_t treeBinFreeBytes[HEAP_STATISTICS_TREE_BINS];
+	/// Bytes in each of the quarantine rings waiting for an epoch to end.
+	size_t quarantinePendingBytes[HEAP_STATISTICS_QUARANTINE_RINGS];
+	/// The revocation epoch that each quarantine ring is waiting for.
+	size_t quarantinePendingEpoch[HEAP_STATISTICS_QUARANTINE_RINGS];
+	/// Bytes that have finished revocation but are not yet in a free bin.
+	size_t quarantineFinishedBytes;
+	/**
+	 * Bytes that have left quarantine and are partially zeroed (only with
+	 * incremental zeroing).
+	 */
+	size_t quarantineZeroingBytes;
+	/// Bytes held in per-capability size-class caches.
+	size_t cachedBytes;
+	/// Bytes reserved with `heap_reserve` that have not yet been used.
+	size_t reservedBytes;
+	/// The number of freed objects kept alive by hazard pointers.
+	size_t hazardQuarantineOccupancy;
+	/// The number of objects that the hazard quarantine can hold.
+	size_t hazardQuarantineCapacity;
+	/**
+	 * The number of revocation passes started because the quarantine crossed
+	 * a watermark configured with `--allocator-revocation-watermark` or
+	 * `--allocator-revocation-watermark-bytes`.
+	 */
+	size_t revocationWatermarkKicks;
+	/// The number of times that an allocation blocked waiting for revocation.
+	size_t revocationWaits;
+	/**
+	 * The number of times that an allocation blocked waiting for memory to be
+	 * freed or for quota.
+	 */
+	size_t heapFullWaits;
+	/// The number of frees that `heap_free_deferred` queued.
+	size_t deferredFrees;
+	/**
+	 * The epoch at the end of the last complete revocation pass.  This and
+	 * the following four fields are reported only with the software revoker
+	 * and are zero otherwise.
+	 */
+	uint32_t revocationPassEpoch;
+	/// The number of revoker invocations in the last complete pass.
+	uint32_t revocationPassTicks;
+	/// The number of capability-sized words scanned in the last pass.
+	uint32_t revocationPassScanned;
+	/**
+	 * The number of capability-sized words that the last pass skipped
+	 * because the allocator reported that they were in free chunks.
+	 */
+	uint32_t revocationPassSkipped;
+	/// The number of cycles spent scanning in the last complete pass.
+	uint32_t revocationPassCycles;
+	/// Histogram of the number of cycles taken by successful allocations.
+	uint32_t allocateCycles[HEAP_STATISTICS_HISTOGRAM_BUCKETS];
+	/// Histogram of the number of cycles taken by successful frees.
+	uint32_t freeCycles[HEAP_STATISTICS_HISTOGRAM_BUCKETS];
+};
+
+/**
+ * Fill `statistics` with a snapshot of the allocator's state.  This walks the
+ * free bins and quarantine and so takes time proportional to the number of
+ * free and quarantined chunks.
+ *
+ * The latency histograms count calls to `heap_allocate` and `heap_free` since
+ * boot, measured from entry to the allocator until the operation completes
+ * (including any time spent waiting for memory), and saturate rather than
+ * wrapping.
+ *
+ * Returns 0 on success, `-EINVAL` if `statistics` is not a valid writeable
+ * pointer, or `-ENOTENOUGHSTACK` if the stack is insufficient to run the
+ * function.
+ */
+int __cheri_compartment("allocator")
+  heap_statistics(struct HeapStatistics *statistics);
+
 static inline void __dead2 abort()
 {
 	panic();
@@ -0,0 +1,139 @@
+// Copyright CHERIoT Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <arena.h>
+#include <cheri.hh>
+#include <errno.h>
+#include <string.h>
+
+using namespace CHERI;
+
+struct Arena
+{
+	/**
+	 * Capability to the entire backing allocation.  Sub-allocations are
+	 * derived from this and it is passed to `heap_free` when the arena is
+	 * destroyed.
+	 */
+	char *block;
+	/**
+	 * Offset of the first byte in `block` that is available for objects.
+	 * Everything below this is used by the arena's own state.
+	 */
+	size_t start;
+	/**
+	 * Offset of the first unallocated byte in `block`.
+	 */
+	size_t used;
+};
+
+namespace
+{
+	/**
+	 * The space at the start of the backing allocation that is reserved for
+	 * the arena's own state.
+	 */
+	constexpr size_t HeaderSize =
+	  (sizeof(Arena) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+} // namespace
+
+int arena_create(Timeout            *timeout,
+                 AllocatorCapability heapCapability,
+                 size_t              capacity,
+                 Arena             **outArena)
+{
+	Capability<Arena *> out{outArena};
+	if (!out.is_valid() || out.is_sealed() ||
+	    !out.permissions().contains(Permission::Store) ||
+	    (out.length() < sizeof(Arena *)))
+	{
+		return -EINVAL;
+	}
+	*outArena = nullptr;
+	size_t size;
+	if (__builtin_add_overflow(capacity, HeaderSize, &size))
+	{
+		return -EINVAL;
+	}
+	Capability<char> block{
+	  static_cast<char *>(heap_allocate(timeout, heapCapability, size))};
+	if (!block.is_valid())
+	{
+		return -ENOMEM;
+	}
+	Capability<Arena> arena{block.cast<Arena>()};
+	arena.bounds() = sizeof(Arena);
+	arena->block   = block;
+	arena->start   = HeaderSize;
+	arena->used    = HeaderSize;
+	*outArena      = arena;
+	return 0;
+}
+
+void *arena_allocate(Arena *arena, size_t size)
+{
+	if (size == 0)
+	{
+		return nullptr;
+	}
+	// Round the size and alignment so that the bounds of the returned object
+	// are precise.  Large objects may need more padding than the arena's
+	// default alignment.
+	size_t length = representable_length(size);
+	if (length < size)
+	{
+		return nullptr;
+	}
+	ptraddr_t mask =
+	  representable_alignment_mask(size) & ~ptraddr_t(ARENA_ALIGNMENT - 1);
+	Capability<char> object{arena->block};
+	ptraddr_t        base  = object.base();
+	ptraddr_t        top   = object.top();
+	ptraddr_t        first = (base + arena->used + ~mask) & mask;
+	if ((first > top) || (top - first < length))
+	{
+		return nullptr;
+	}
+	arena->used      = first + length - base;
+	object.address() = first;
+	object.bounds()  = length;
+	memset(object, 0, length);
+	return object;
+}
+
+size_t arena_remaining(Arena *arena)
+{
+	Capability<char> block{arena->block};
+	size_t           remaining =
+	  (block.length() - arena->used) & ~size_t(ARENA_ALIGNMENT - 1);
+	// Shrink until the result can be placed at the current cursor with
+	// precise bounds.  Only large sizes need extra alignment padding, so this
+	// normally exits on the first iteration.
+	while (remaining > 0)
+	{
+		ptraddr_t mask = representable_alignment_mask(remaining) &
+		                 ~ptraddr_t(ARENA_ALIGNMENT - 1);
+		ptraddr_t first = (block.base() + arena->used + ~mask) & mask;
+		if ((first <= block.top()) &&
+		    (block.top() - first >= representable_length(remaining)))
+		{
+			break;
+		}
+		remaining -= ARENA_ALIGNMENT;
+	}
+	return remaining;
+}
+
+void arena_reset(Arena *arena)
+{
+	arena->used = arena->start;
+}
+
+int arena_destroy(AllocatorCapability heapCapability, Arena *arena)
+{
+	if (!__builtin_cheri_tag_get(arena))
+	{
+		return -EINVAL;
+	}
+	return heap_free(heapCapability, arena->block);
+}
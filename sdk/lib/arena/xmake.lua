@@ -0,0 +1,6 @@
+-- Copyright CHERIoT Contributors.
+-- SPDX-License-Identifier: MIT
+
+library("arena")
+  set_default(false)
+  add_files("arena.cc")
@@ -88,8 +88,16 @@ void *memcpy(void *dst0, const void *src0, size_t length)
 			length -= t;
 			TLOOP1(*dst++ = *src++);
 		}
-		// Copy whole words, then mop up any trailing bytes.
-		t = length / wsize;
+		// Copy whole words, four at a time while possible, then mop up any
+		// trailing words and bytes.
+		t = length / (4 * wsize);
+		TLOOP(((word *)dst)[0] = ((const word *)src)[0];
+		      ((word *)dst)[1] = ((const word *)src)[1];
+		      ((word *)dst)[2] = ((const word *)src)[2];
+		      ((word *)dst)[3] = ((const word *)src)[3];
+		      src += 4 * wsize;
+		      dst += 4 * wsize);
+		t = (length / wsize) & 3;
 		TLOOP(*(word *)dst = *(const word *)src; src += wsize; dst += wsize);
 		t = length & wmask;
 		TLOOP(*dst++ = *src++);
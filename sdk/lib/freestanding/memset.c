@@ -39,6 +39,19 @@
 #define wsize sizeof(unsigned int)
 #define wmask (wsize - 1)
 
+#define csize sizeof(void *)
+#define cmask (csize - 1)
+
+/*
+ * Zeroing shorter than this is done with the word loop below.  Above it, the
+ * unrolled capability-width kernel in zero.S halves the number of stores and
+ * amortises the cost of the alignment prologue.
+ */
+#define ZERO_KERNEL_MINIMUM (4 * csize)
+
+__attribute__((visibility("hidden"))) void
+__cheriot_zero_capabilities(void *base, size_t length);
+
 void *memset(void *dst0, int c0, size_t length)
 {
 	size_t         t;
@@ -46,6 +59,28 @@ void *memset(void *dst0, int c0, size_t length)
 	unsigned char *dst;
 
 	dst = dst0;
+	if ((unsigned char)c0 == 0 && length >= ZERO_KERNEL_MINIMUM)
+	{
+		/* Align destination to a capability by zeroing bytes. */
+		if ((t = (__cheri_addr size_t)dst & cmask) != 0)
+		{
+			t = csize - t;
+			length -= t;
+			do
+			{
+				*dst++ = 0;
+			} while (--t != 0);
+		}
+		t = length & ~cmask;
+		__cheriot_zero_capabilities(dst, t);
+		dst += t;
+		/* Mop up trailing bytes, if any. */
+		for (t = length & cmask; t != 0; t--)
+		{
+			*dst++ = 0;
+		}
+		return (dst0);
+	}
 	if (length < 3 * wsize)
 	{
 		while (length != 0)
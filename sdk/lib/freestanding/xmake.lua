@@ -1,2 +1,2 @@
 library("freestanding")
-  add_files("memcmp.c", "memcpy.c", "memset.c", "compat.S")
+  add_files("memcmp.c", "memcpy.c", "memset.c", "zero.S", "compat.S")
@@ -9,6 +9,7 @@ option("print-doubles")
 	set_showmenu(true)
 
 includes(
+	"arena",
 	"atomic",
 	"compartment_helpers",
 	"crt",
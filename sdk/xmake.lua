@@ -50,6 +50,46 @@ option("allocator-rendering")
 		option_check_dep(raise, option, "allocator")
 	end)
 
+option("allocator-tracing")
+	set_default(false)
+	set_description("Record a trace of allocations and frees that can be dumped with heap_trace_dump()")
+	set_showmenu(true)
+
+	add_deps("allocator")
+	after_check(function (option)
+		option_check_dep(raise, option, "allocator")
+	end)
+
+option("allocator-incremental-zeroing")
+	set_default(false)
+	set_description("Zero freed memory in bounded slices as it leaves quarantine, instead of on free")
+	set_showmenu(true)
+
+	add_deps("allocator")
+	after_check(function (option)
+		option_check_dep(raise, option, "allocator")
+	end)
+
+option("allocator-revocation-watermark")
+	set_default("0")
+	set_description("Start a background revocation pass when quarantine exceeds this percentage of the heap (0 disables)")
+	set_showmenu(true)
+
+	add_deps("allocator")
+	after_check(function (option)
+		option_check_dep(raise, option, "allocator")
+	end)
+
+option("allocator-revocation-watermark-bytes")
+	set_default("0")
+	set_description("Start a background revocation pass when quarantine exceeds this many bytes (0 disables)")
+	set_showmenu(true)
+
+	add_deps("allocator")
+	after_check(function (option)
+		option_check_dep(raise, option, "allocator")
+	end)
+
 option("scheduler-accounting")
 	set_default(false)
 	set_description("Track per-thread cycle counts in the scheduler");
@@ -341,6 +381,10 @@ target("cheriot.allocator")
 		target:set("cheriot.compartment", "allocator")
 		target:set('cheriot.debug-name', "allocator")
 		target:add('defines', "HEAP_RENDER=" .. tostring(get_config("allocator-rendering")))
+		target:add('defines', "HEAP_TRACE=" .. tostring(get_config("allocator-tracing")))
+		target:add('defines', "HEAP_INCREMENTAL_ZEROING=" .. tostring(get_config("allocator-incremental-zeroing")))
+		target:add('defines', "HEAP_REVOCATION_WATERMARK_PERCENT=" .. tostring(get_config("allocator-revocation-watermark")))
+		target:add('defines', "HEAP_REVOCATION_WATERMARK_BYTES=" .. tostring(get_config("allocator-revocation-watermark-bytes")))
 	end)
 
 -- Add the allocator to the firmware image if enabled.
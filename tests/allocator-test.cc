@@ -28,6 +28,21 @@ using namespace CHERI;
 DECLARE_AND_DEFINE_ALLOCATOR_CAPABILITY(emptyHeap, 0);
 #define EMPTY_HEAP STATIC_SEALED_VALUE(emptyHeap)
 
+#define CACHED_HEAP_QUOTA 1024U
+DECLARE_AND_DEFINE_ALLOCATOR_CAPABILITY_WITH_FLAGS(
+  cachedHeap,
+  CACHED_HEAP_QUOTA,
+  AllocatorCapabilitySizeClassCache);
+#define CACHED_HEAP STATIC_SEALED_VALUE(cachedHeap)
+
+/* Additional claimants, so that a chunk can have enough claims to be indexed */
+#define CLAIMANT_HEAP_QUOTA 512U
+DECLARE_AND_DEFINE_ALLOCATOR_CAPABILITY(claimantHeap0, CLAIMANT_HEAP_QUOTA);
+DECLARE_AND_DEFINE_ALLOCATOR_CAPABILITY(claimantHeap1, CLAIMANT_HEAP_QUOTA);
+DECLARE_AND_DEFINE_ALLOCATOR_CAPABILITY(claimantHeap2, CLAIMANT_HEAP_QUOTA);
+DECLARE_AND_DEFINE_ALLOCATOR_CAPABILITY(claimantHeap3, CLAIMANT_HEAP_QUOTA);
+DECLARE_AND_DEFINE_ALLOCATOR_CAPABILITY(claimantHeap4, CLAIMANT_HEAP_QUOTA);
+
 /* Used to test that the revoker sweeps static sealed capabilities */
 struct AllocatorTestStaticSealedType
 {
@@ -337,6 +352,9 @@ namespace
 		     "Blocking heap allocation with the heap full flag unset did not "
 		     "return failure with memory "
 		     "exhausted");
+		HeapStatistics before;
+		HeapStatistics after;
+		TEST_SUCCESS(heap_statistics(&before));
 		Timeout thirtyticks{30};
 		TEST(heap_allocate(&thirtyticks,
 		                   MALLOC_CAPABILITY,
@@ -347,6 +365,9 @@ namespace
 		TEST(thirtyticks.remaining == 0,
 		     "Allocation with heap full wait flag set did not wait on memory "
 		     "exhausted");
+		TEST_SUCCESS(heap_statistics(&after));
+		TEST(after.heapFullWaits > before.heapFullWaits,
+		     "Blocking on a full heap was not counted in the statistics");
 		debug_log("Checking that the 'quota exhausted' flag works");
 		TEST(heap_allocate(&forever,
 		                   EMPTY_HEAP,
@@ -394,6 +415,173 @@ namespace
 		allocations.clear();
 	}
 
+	/**
+	 * Test that `heap_reallocate` fails cleanly if it has to block for memory
+	 * and another thread frees the original allocation while it waits.  The
+	 * fresh allocation must be released and no quota leaked.
+	 */
+	void test_reallocate_blocking(const size_t HeapSize)
+	{
+		const size_t BigAllocSize = HeapSize / (MaxAllocCount - 1);
+		auto         quotaBefore  = heap_quota_remaining(MALLOC_CAPABILITY);
+		allocations.resize(MaxAllocCount);
+		freeStart = 0;
+		// Free everything, including the allocation being reallocated, which
+		// is the first one freed and so is gone before any memory is
+		// available to the reallocation.
+		async([]() {
+			freeStart.wait(0);
+			TEST(sleep(2) >= 0, "Failed to sleep");
+			for (auto &allocation : allocations)
+			{
+				if (allocation != nullptr)
+				{
+					TEST_SUCCESS(heap_free(MALLOC_CAPABILITY, allocation));
+				}
+			}
+			freeStart = 2;
+			freeStart.notify_one();
+		});
+
+		TEST_SUCCESS(heap_quarantine_empty());
+		bool memoryExhausted = false;
+		for (auto &allocation : allocations)
+		{
+			allocation =
+			  heap_allocate(&noWait, MALLOC_CAPABILITY, BigAllocSize);
+			if (allocation == nullptr)
+			{
+				memoryExhausted = true;
+				break;
+			}
+		}
+		TEST(memoryExhausted, "Failed to exhaust memory");
+		TEST(allocations[0] != nullptr, "Failed to allocate any memory");
+
+		freeStart = 1;
+		freeStart.notify_one();
+		Timeout t{AllocTimeout};
+		void   *grown = heap_reallocate(
+		  &t, MALLOC_CAPABILITY, allocations[0], BigAllocSize * 2);
+		TEST(grown == nullptr,
+		     "Reallocating an object freed while waiting returned {}",
+		     grown);
+		freeStart.wait(1);
+		allocations.clear();
+		// The async lambda may not have been freed yet.
+		int sleeps = 0;
+		while (heap_quota_remaining(MALLOC_CAPABILITY) != quotaBefore)
+		{
+			TEST(sleep(1) >= 0, "Failed to sleep");
+			TEST(sleeps++ < 100,
+			     "Failed reallocation leaked quota, {} bytes left, expected {}",
+			     heap_quota_remaining(MALLOC_CAPABILITY),
+			     quotaBefore);
+		}
+		TEST_SUCCESS(heap_quarantine_empty());
+	}
+
+	/// Results of the blocked allocations in `test_blocked_wakes`.
+	cheriot::atomic<int> largeWaiterDone;
+	cheriot::atomic<int> quotaWaiterDone;
+
+	/**
+	 * Returns the number of times that an allocation has blocked on a full
+	 * heap or exhausted quota.
+	 */
+	size_t heap_full_waits()
+	{
+		HeapStatistics statistics;
+		TEST_SUCCESS(heap_statistics(&statistics));
+		return statistics.heapFullWaits;
+	}
+
+	/**
+	 * Test that a free wakes only the blocked allocations that it may
+	 * satisfy.  One thread blocks on a large allocation and another on
+	 * exhausted quota.  A small free must wake the quota waiter (any free may
+	 * return quota) but not the large one, which is woken once enough memory
+	 * is freed.
+	 */
+	void test_blocked_wakes(const size_t HeapSize)
+	{
+		TEST_SUCCESS(heap_quarantine_empty());
+		void *big   = heap_allocate(&noWait, MALLOC_CAPABILITY, HeapSize / 4);
+		void *small = heap_allocate(&noWait, MALLOC_CAPABILITY, 32);
+		void *filler =
+		  heap_allocate(&noWait, SECOND_HEAP, SECOND_HEAP_QUOTA - 32);
+		TEST(__builtin_cheri_tag_get(big) && __builtin_cheri_tag_get(small) &&
+		       __builtin_cheri_tag_get(filler),
+		     "Failed to allocate objects for blocked wake test");
+		TEST(heap_quota_remaining(SECOND_HEAP) < 64,
+		     "Quota not exhausted, {} bytes left",
+		     heap_quota_remaining(SECOND_HEAP));
+		largeWaiterDone = 0;
+		quotaWaiterDone = 0;
+		size_t waits    = heap_full_waits();
+
+		async([=]() {
+			// More than is free now, but less than is free once `big` has
+			// been freed.
+			Timeout t{AllocTimeout};
+			void   *large =
+			  heap_allocate(&t,
+			                MALLOC_CAPABILITY,
+			                heap_available() + HeapSize / 8,
+			                AllocateWaitHeapFull |
+			                  AllocateWaitRevocationNeeded);
+			largeWaiterDone = __builtin_cheri_tag_get(large) ? 1 : -1;
+			free(large);
+		});
+		async([]() {
+			Timeout t{AllocTimeout};
+			void   *object =
+			  heap_allocate(&t, SECOND_HEAP, 64, AllocateWaitQuotaExceeded);
+			quotaWaiterDone = __builtin_cheri_tag_get(object) ? 1 : -1;
+			heap_free(SECOND_HEAP, object);
+		});
+
+		int sleeps = 0;
+		while (heap_full_waits() < waits + 2)
+		{
+			TEST(sleep(1) >= 0, "Failed to sleep");
+			TEST(sleeps++ < 100, "Allocations did not block");
+		}
+
+		// The small free may return quota, so it must wake the quota waiter,
+		// which blocks again.  It cannot satisfy the large allocation.
+		TEST_SUCCESS(heap_free(MALLOC_CAPABILITY, small));
+		TEST(sleep(2) >= 0, "Failed to sleep");
+		TEST_EQUAL(heap_full_waits(),
+		           waits + 3,
+		           "Small free woke the wrong blocked allocations");
+		TEST((largeWaiterDone == 0) && (quotaWaiterDone == 0),
+		     "Blocked allocation returned after a small free");
+
+		// Returning quota lets the quota waiter succeed.
+		TEST_SUCCESS(heap_free(SECOND_HEAP, filler));
+		sleeps = 0;
+		while (quotaWaiterDone == 0)
+		{
+			TEST(sleep(1) >= 0, "Failed to sleep");
+			TEST(sleeps++ < 100, "Quota waiter was not woken");
+		}
+		TEST_EQUAL(quotaWaiterDone.load(), 1, "Quota waiter failed");
+		TEST_EQUAL(largeWaiterDone.load(), 0, "Large waiter returned early");
+
+		// Freeing the big object puts enough memory in quarantine for the
+		// large allocation, which must be woken and wait for revocation.
+		TEST_SUCCESS(heap_free(MALLOC_CAPABILITY, big));
+		sleeps = 0;
+		while (largeWaiterDone == 0)
+		{
+			TEST(sleep(1) >= 0, "Failed to sleep");
+			TEST(sleeps++ < AllocTimeout, "Large waiter was not woken");
+		}
+		TEST_EQUAL(largeWaiterDone.load(), 1, "Large waiter failed");
+		TEST_SUCCESS(heap_quarantine_empty());
+	}
+
 	/**
 	 * This test aims to exercise as many possibilities in the allocator as
 	 * possible.
@@ -554,6 +742,68 @@ namespace
 		     alloc);
 	}
 
+	/**
+	 * Test claims on an object with enough claimants that the allocator
+	 * switches from a list of claims to an index.  Claims must still be found,
+	 * counted, and dropped in any order, and the object must be freed (and
+	 * every quota restored) when the last one is dropped.
+	 */
+	void test_claim_index()
+	{
+		AllocatorCapability claimants[] = {
+		  STATIC_SEALED_VALUE(claimantHeap0),
+		  STATIC_SEALED_VALUE(claimantHeap1),
+		  STATIC_SEALED_VALUE(claimantHeap2),
+		  STATIC_SEALED_VALUE(claimantHeap3),
+		  STATIC_SEALED_VALUE(claimantHeap4),
+		  SECOND_HEAP,
+		  CACHED_HEAP,
+		};
+		constexpr size_t AllocSize = 64;
+		CHERI::Capability alloc{
+		  heap_allocate(&noWait, MALLOC_CAPABILITY, AllocSize)};
+		TEST(alloc.is_valid(), "Allocation failed");
+		std::vector<size_t> quotas;
+		for (auto claimant : claimants)
+		{
+			quotas.push_back(heap_quota_remaining(claimant));
+			ssize_t claimSize = heap_claim(claimant, alloc);
+			TEST(claimSize >= ssize_t(AllocSize),
+			     "{}-byte allocation claimed as {} bytes",
+			     AllocSize,
+			     claimSize);
+		}
+		// A second claim by the same capability must find the existing claim
+		// in the index and not charge the quota again.
+		auto quotaBefore = heap_quota_remaining(claimants[2]);
+		TEST(heap_claim(claimants[2], alloc) > 0, "Second claim failed");
+		TEST_EQUAL(heap_quota_remaining(claimants[2]),
+		           quotaBefore,
+		           "Second claim on an indexed chunk was charged to the quota");
+		TEST_EQUAL(heap_can_free(claimants[4], alloc),
+		           0,
+		           "Claimant cannot free an indexed claim");
+		TEST_EQUAL(heap_can_free(EMPTY_HEAP, alloc),
+		           -EPERM,
+		           "Capability without a claim can free an indexed chunk");
+		TEST_SUCCESS(heap_free(MALLOC_CAPABILITY, alloc));
+		TEST_SUCCESS(heap_free(claimants[2], alloc));
+		// Drop the claims out of order.
+		for (size_t i : {3, 0, 6, 2, 5, 1, 4})
+		{
+			TEST(__builtin_launder(&alloc)->is_valid(),
+			     "Object freed while claimant {} still holds a claim",
+			     i);
+			TEST_SUCCESS(heap_free(claimants[i], alloc));
+			TEST_EQUAL(heap_quota_remaining(claimants[i]),
+			           quotas[i],
+			           "Dropping an indexed claim did not restore the quota");
+		}
+		TEST(!__builtin_launder(&alloc)->is_valid(),
+		     "Heap capability still valid after releasing last claim: {}",
+		     alloc);
+	}
+
 	/**
 	 * Test heap_free_all.  Make sure that we can reclaim all memory associated
 	 * with a single quota.
@@ -563,7 +813,9 @@ namespace
 		ssize_t allocated = 0;
 		debug_log("Quota left before allocating: {}",
 		          heap_quota_remaining(SECOND_HEAP));
-		// Allocate and leak some things:
+		// Allocate and leak some things, interleaved with allocations from
+		// another capability so that they are not all adjacent:
+		std::vector<void *> others;
 		for (size_t i = 16; i < 256; i <<= 1)
 		{
 			allocated += i;
@@ -571,6 +823,7 @@ namespace
 			  __builtin_cheri_tag_get(heap_allocate(&noWait, SECOND_HEAP, i)),
 			  "Allocating {} bytes failed",
 			  i);
+			others.push_back(heap_allocate(&noWait, MALLOC_CAPABILITY, i));
 		}
 		debug_log("Quota left after allocating {} bytes: {}",
 		          allocated,
@@ -587,6 +840,604 @@ namespace
 		     "After alloc and free from {}-byte quota, {} bytes left",
 		     SECOND_HEAP_QUOTA,
 		     quotaLeft);
+		TEST_EQUAL(heap_free_all(SECOND_HEAP),
+		           0,
+		           "Second heap_free_all freed memory");
+		for (void *other : others)
+		{
+			TEST(__builtin_cheri_tag_get(other),
+			     "Allocation from another capability was freed");
+			TEST_SUCCESS(heap_free(MALLOC_CAPABILITY, other));
+		}
+	}
+
+	/**
+	 * Test allocating and freeing with a capability that has a size-class
+	 * cache.  Objects that are reused from the cache must be zeroed, charged
+	 * to the quota in the same way as fresh allocations, and must not be
+	 * reachable through pointers to their previous incarnation.
+	 */
+	void test_size_class_cache()
+	{
+		constexpr size_t Rounds = 32;
+		for (size_t size = 16; size <= 128; size += 16)
+		{
+			for (size_t i = 0; i < Rounds; i++)
+			{
+				Capability<uint8_t> p{static_cast<uint8_t *>(
+				  heap_allocate(&noWait, CACHED_HEAP, size))};
+				TEST(p.is_valid(), "Allocating {} bytes failed", size);
+				TEST(p.length() >= size,
+				     "Allocating {} bytes returned {}",
+				     size,
+				     p);
+				auto quota = heap_quota_remaining(CACHED_HEAP);
+				TEST(quota <= CACHED_HEAP_QUOTA - size - sizeof(void *),
+				     "Allocating {} bytes left {} of {} bytes of quota",
+				     size,
+				     quota,
+				     CACHED_HEAP_QUOTA);
+				for (size_t j = 0; j < p.length(); j++)
+				{
+					TEST(p[j] == 0,
+					     "Byte {} of {}-byte allocation {} not zeroed",
+					     j,
+					     size,
+					     p);
+				}
+				memset(p, 0xa5, p.length());
+				TEST_SUCCESS(heap_free(CACHED_HEAP, p));
+				TEST(!p.is_valid_temporal(),
+				     "Freed pointer {} still live with size-class cache",
+				     p);
+				TEST(heap_free(CACHED_HEAP, p) != 0,
+				     "Double free of {} succeeded with size-class cache",
+				     p);
+				// Only this capability has a cache, and the memory that it
+				// holds is reported as unavailable.
+				quota = heap_quota_remaining(CACHED_HEAP);
+				HeapStatistics statistics;
+				TEST_SUCCESS(heap_statistics(&statistics));
+				TEST(quota == CACHED_HEAP_QUOTA - statistics.cachedBytes,
+				     "After alloc and free of {} bytes from {}-byte quota, "
+				     "{} bytes left with {} bytes cached",
+				     size,
+				     CACHED_HEAP_QUOTA,
+				     quota,
+				     statistics.cachedBytes);
+			}
+		}
+		// Freeing everything must empty and release the cache.
+		TEST(heap_free_all(CACHED_HEAP) >= 0, "heap_free_all failed");
+		HeapStatistics statistics;
+		TEST_SUCCESS(heap_statistics(&statistics));
+		TEST_EQUAL(statistics.cachedBytes,
+		           0U,
+		           "heap_free_all left objects in the size-class cache");
+		TEST_EQUAL(heap_quota_remaining(CACHED_HEAP),
+		           ssize_t(CACHED_HEAP_QUOTA),
+		           "heap_free_all did not make cached memory available");
+		// Flushing the quarantine must also flush the cache and leave the
+		// heap usable by everyone else.
+		TEST_SUCCESS(
+		  heap_free(CACHED_HEAP, heap_allocate(&noWait, CACHED_HEAP, 32)));
+		TEST_SUCCESS(heap_quarantine_empty());
+		void *big = heap_allocate(&noWait, CACHED_HEAP, CACHED_HEAP_QUOTA / 2);
+		TEST(__builtin_cheri_tag_get(big),
+		     "Large allocation from capability with cache failed");
+		TEST_SUCCESS(heap_free(CACHED_HEAP, big));
+	}
+
+	/**
+	 * Test `heap_free_deferred`.  This thread does not contend for the
+	 * allocator lock, so frees are performed immediately and report errors.
+	 */
+	void test_deferred_free()
+	{
+		void *object = heap_allocate(&noWait, MALLOC_CAPABILITY, 32);
+		TEST(__builtin_cheri_tag_get(object), "Allocation failed");
+		TEST_EQUAL(heap_free_deferred(EMPTY_HEAP, object),
+		           -EPERM,
+		           "Deferred free with the wrong capability succeeded");
+		TEST(__builtin_cheri_tag_get(object),
+		     "Object invalidated by a failed deferred free");
+		TEST_SUCCESS(heap_free_deferred(MALLOC_CAPABILITY, object));
+		TEST(!__builtin_cheri_tag_get(*__builtin_launder(&object)),
+		     "Object still valid after deferred free: {}",
+		     object);
+		int onStack;
+		TEST(heap_free_deferred(MALLOC_CAPABILITY, &onStack) != 0,
+		     "Deferred free of a stack object succeeded");
+	}
+
+	/**
+	 * Test the batched allocation and deallocation APIs, including partial
+	 * failure.
+	 */
+	void test_batched_allocation()
+	{
+		constexpr size_t BatchSize = 8;
+		size_t           sizes[BatchSize];
+		void            *allocations[BatchSize];
+		for (size_t i = 0; i < BatchSize; i++)
+		{
+			sizes[i] = 16 + 8 * i;
+		}
+		ssize_t allocated = heap_allocate_many(
+		  &noWait, SECOND_HEAP, BatchSize, sizes, allocations);
+		TEST_EQUAL(allocated,
+		           ssize_t(BatchSize),
+		           "Batched allocation did not allocate every object");
+		for (size_t i = 0; i < BatchSize; i++)
+		{
+			Capability allocation{allocations[i]};
+			TEST(allocation.is_valid() && (allocation.length() >= sizes[i]),
+			     "Batched allocation {} of {} bytes returned {}",
+			     i,
+			     sizes[i],
+			     allocation);
+		}
+		// Free everything except the first object as a batch (null entries
+		// are skipped), then free the first object along with a stale copy.
+		void   *first  = allocations[0];
+		allocations[0] = nullptr;
+		ssize_t freed  = heap_free_many(SECOND_HEAP, BatchSize, allocations);
+		TEST_EQUAL(freed,
+		           ssize_t(BatchSize - 1),
+		           "Batched free did not free every object");
+		for (size_t i = 0; i < BatchSize; i++)
+		{
+			TEST(allocations[i] == nullptr,
+			     "Batched free did not clear entry {}",
+			     i);
+		}
+		allocations[0] = first;
+		allocations[1] = first;
+		freed          = heap_free_many(SECOND_HEAP, 2, allocations);
+		TEST_EQUAL(freed, 1, "Double free in batch was not reported");
+		TEST(allocations[0] == nullptr, "Freed entry was not cleared");
+		TEST(allocations[1] == first, "Failed free cleared its entry");
+		TEST_EQUAL(heap_quota_remaining(SECOND_HEAP),
+		           ssize_t(SECOND_HEAP_QUOTA),
+		           "Batched allocation and free leaked quota");
+
+		// An array that cannot hold the batch is an error, not an empty batch.
+		TEST_EQUAL(heap_free_many(SECOND_HEAP, 2, nullptr),
+		           -EINVAL,
+		           "Batched free with a null array");
+		void *tooShort[1] = {nullptr};
+		TEST_EQUAL(heap_free_many(SECOND_HEAP, 2, tooShort),
+		           -EINVAL,
+		           "Batched free with an array shorter than the count");
+
+		// Requests that exceed the quota fail individually.
+		sizes[0] = 32;
+		sizes[1] = SECOND_HEAP_QUOTA;
+		sizes[2] = 32;
+		allocated =
+		  heap_allocate_many(&noWait, SECOND_HEAP, 3, sizes, allocations);
+		TEST_EQUAL(allocated, 2, "Batch with one oversized request");
+		TEST(allocations[1] == nullptr, "Oversized request succeeded");
+		TEST_EQUAL(heap_free_many(SECOND_HEAP, 3, allocations),
+		           2,
+		           "Failed to free partially allocated batch");
+		TEST_EQUAL(heap_quota_remaining(SECOND_HEAP),
+		           ssize_t(SECOND_HEAP_QUOTA),
+		           "Partially failed batch leaked quota");
+
+		// A batch may contain the array that holds it.  That entry must be
+		// freed last, without writing to the freed array.
+		sizes[0] = 32;
+		sizes[1] = 32;
+		allocated =
+		  heap_allocate_many(&noWait, SECOND_HEAP, 2, sizes, allocations);
+		TEST_EQUAL(allocated, 2, "Failed to allocate objects for batch");
+		Capability<void *> array{static_cast<void **>(
+		  heap_allocate_array(&noWait, SECOND_HEAP, 4, sizeof(void *)))};
+		TEST(array.is_valid(), "Failed to allocate array for batch");
+		array[0] = allocations[0];
+		array[1] = array.get();
+		array[2] = allocations[1];
+		array[3] = array.get();
+		TEST_EQUAL(heap_free_many(SECOND_HEAP, 4, array),
+		           3,
+		           "Batch containing its own array freed the wrong number of "
+		           "objects");
+		TEST(!array.is_valid_temporal(), "Batch did not free its own array");
+		TEST(!Capability{allocations[0]}.is_valid_temporal() &&
+		       !Capability{allocations[1]}.is_valid_temporal(),
+		     "Batch containing its own array did not free other objects");
+		TEST_SUCCESS(heap_quarantine_empty());
+		TEST_EQUAL(heap_quota_remaining(SECOND_HEAP),
+		           ssize_t(SECOND_HEAP_QUOTA),
+		           "Batch containing its own array leaked quota");
+		void *check = heap_allocate(&noWait, SECOND_HEAP, 32);
+		TEST(__builtin_cheri_tag_get(check),
+		     "Allocation after freeing a batch containing its own array "
+		     "failed");
+		TEST_SUCCESS(heap_free(SECOND_HEAP, check));
+	}
+
+	/**
+	 * Test heap_reallocate.  Contents must be preserved, new space must be
+	 * zeroed, the quota must be charged for the larger allocation and the
+	 * original pointer must remain valid only if the allocation grew in
+	 * place.
+	 */
+	void test_reallocate()
+	{
+		// Free and coalesce a large chunk so that a small allocation is
+		// likely to be followed by free space that it can grow into.
+		void *big = heap_allocate(&noWait, SECOND_HEAP, 512);
+		TEST(__builtin_cheri_tag_get(big), "Allocating 512 bytes failed");
+		TEST_SUCCESS(heap_free(SECOND_HEAP, big));
+		TEST_SUCCESS(heap_quarantine_empty());
+
+		Capability<uint8_t> original{
+		  static_cast<uint8_t *>(heap_allocate(&noWait, SECOND_HEAP, 32))};
+		TEST(original.is_valid(), "Allocating 32 bytes failed");
+		for (size_t i = 0; i < original.length(); i++)
+		{
+			original[i] = i + 1;
+		}
+		TEST(heap_reallocate(&noWait, SECOND_HEAP, original, 0) == nullptr,
+		     "Reallocating to zero bytes succeeded");
+		TEST(heap_reallocate(&noWait, MALLOC_CAPABILITY, original, 64) ==
+		       nullptr,
+		     "Reallocating with the wrong capability succeeded");
+		Capability<uint8_t> interior = original;
+		interior.bounds()            = 16;
+		TEST(heap_reallocate(&noWait, SECOND_HEAP, interior, 64) == nullptr,
+		     "Reallocating a subset of an allocation succeeded");
+		TEST(heap_reallocate(&noWait, SECOND_HEAP, original, 16) ==
+		       original.get(),
+		     "Shrinking did not return the original allocation");
+		// A shrink returns a capability to the whole allocation, even if
+		// the one passed in points into the middle of it, and never adds
+		// permissions.
+		Capability<uint8_t> offset = original;
+		offset.address() += 8;
+		offset.permissions() &= offset.permissions().without(
+		  Permission::LoadStoreCapability);
+		Capability<uint8_t> shrunk{static_cast<uint8_t *>(
+		  heap_reallocate(&noWait, SECOND_HEAP, offset, 16))};
+		TEST((shrunk.address() == original.base()) &&
+		       (shrunk.base() == original.base()) &&
+		       (shrunk.length() == original.length()),
+		     "Shrinking {} returned {}",
+		     offset,
+		     shrunk);
+		TEST(shrunk.permissions() == offset.permissions(),
+		     "Shrinking {} returned {} with different permissions",
+		     offset,
+		     shrunk);
+
+		Capability<uint8_t> grown{static_cast<uint8_t *>(
+		  heap_reallocate(&noWait, SECOND_HEAP, original, 128))};
+		TEST(grown.is_valid() && (grown.length() >= 128),
+		     "Reallocating {} to 128 bytes returned {}",
+		     original,
+		     grown);
+		for (size_t i = 0; i < grown.length(); i++)
+		{
+			uint8_t expected = (i < original.length()) ? i + 1 : 0;
+			TEST_EQUAL(grown[i],
+			           expected,
+			           "Reallocated object has incorrect contents");
+		}
+		bool inPlace = grown.base() == original.base();
+		debug_log("Reallocation {} in place", inPlace ? "was" : "was not");
+		TEST_EQUAL(original.is_valid_temporal(),
+		           inPlace,
+		           "Original pointer validity is wrong after reallocation");
+		TEST(heap_quota_remaining(SECOND_HEAP) <=
+		       ssize_t(SECOND_HEAP_QUOTA - grown.length()),
+		     "Quota was not charged for the larger allocation");
+		TEST_SUCCESS(heap_free(SECOND_HEAP, grown));
+		TEST_EQUAL(heap_quota_remaining(SECOND_HEAP),
+		           ssize_t(SECOND_HEAP_QUOTA),
+		           "Reallocation leaked quota");
+
+		void *fresh = heap_reallocate(&noWait, SECOND_HEAP, nullptr, 32);
+		TEST(__builtin_cheri_tag_get(fresh),
+		     "Reallocating a null pointer did not allocate");
+		TEST_SUCCESS(heap_free(SECOND_HEAP, fresh));
+	}
+
+	/**
+	 * Test placement hints.  The primary heap always exists, so a strict
+	 * request for it must succeed and return memory in it.  Region 14 is
+	 * never provided, so a strict request for it must fail and a non-strict
+	 * one must fall back to another region.
+	 */
+	void test_placement()
+	{
+		const ptraddr_t HeapStart = LA_ABS(__export_mem_heap);
+		const ptraddr_t HeapEnd   = LA_ABS(__export_mem_heap_end);
+
+		Capability<void> primary{
+		  heap_allocate(&noWait,
+		                SECOND_HEAP,
+		                32,
+		                AllocateWaitAny | ALLOCATE_PLACEMENT_REGION(0) |
+		                  AllocatePlacementStrict)};
+		TEST(primary.is_valid(), "Strict allocation in region 0 failed");
+		TEST((primary.base() >= HeapStart) && (primary.top() <= HeapEnd),
+		     "Allocation {} is not in the primary heap",
+		     primary);
+		TEST_SUCCESS(heap_free(SECOND_HEAP, primary));
+
+		void *missing =
+		  heap_allocate(&noWait,
+		                SECOND_HEAP,
+		                32,
+		                AllocateWaitAny | ALLOCATE_PLACEMENT_REGION(14) |
+		                  AllocatePlacementStrict);
+		TEST(missing == nullptr,
+		     "Strict allocation in a missing region returned {}",
+		     missing);
+
+		Capability<void> fallback{heap_allocate(
+		  &noWait, SECOND_HEAP, 32, ALLOCATE_PLACEMENT_REGION(14))};
+		TEST(fallback.is_valid(),
+		     "Allocation with a hint for a missing region failed");
+		TEST(heap_address_is_valid(fallback),
+		     "Allocation {} is not in a heap region",
+		     fallback);
+		TEST_SUCCESS(heap_free(SECOND_HEAP, fallback));
+	}
+
+	/**
+	 * Test background quarantine processing.  An object that is larger than
+	 * a zeroing slice is filled, freed, and moved out of quarantine.
+	 * Reallocating it must return zeroed memory, whether it was zeroed on
+	 * free or incrementally as it left quarantine.
+	 */
+	void test_quarantine_process()
+	{
+		constexpr size_t Size = 4096;
+		Timeout          t{UnlimitedTimeout};
+		TEST_EQUAL(heap_quarantine_process(nullptr),
+		           -EINVAL,
+		           "heap_quarantine_process accepted a null timeout");
+
+		Capability<uint8_t> first{static_cast<uint8_t *>(
+		  heap_allocate(&noWait, MALLOC_CAPABILITY, Size))};
+		TEST(first.is_valid(), "Allocating {} bytes failed", Size);
+		memset(first, 0xa5, Size);
+		TEST_SUCCESS(heap_free(MALLOC_CAPABILITY, first));
+		TEST_SUCCESS(heap_quarantine_empty());
+		TEST_SUCCESS(heap_quarantine_process(&t));
+
+		HeapStatistics statistics;
+		TEST_SUCCESS(heap_statistics(&statistics));
+		TEST_EQUAL(statistics.quarantineZeroingBytes,
+		           0U,
+		           "Processing the quarantine left a partially zeroed chunk");
+
+		Capability<uint8_t> second{static_cast<uint8_t *>(
+		  heap_allocate(&noWait, MALLOC_CAPABILITY, Size))};
+		TEST(second.is_valid(), "Allocating {} bytes failed", Size);
+		for (size_t i = 0; i < Size; i++)
+		{
+			if (second[i] != 0)
+			{
+				TEST(false, "Byte {} of {} is not zeroed", i, second);
+			}
+		}
+		TEST_SUCCESS(heap_free(MALLOC_CAPABILITY, second));
+	}
+
+	/**
+	 * Test that adjacent objects freed in the same epoch are merged in
+	 * quarantine.  Once the quarantine is flushed, the merged span must be
+	 * allocatable as a single object, with the absorbed chunk headers
+	 * zeroed.  Live guard objects on either side stop the span from merging
+	 * with anything else.
+	 */
+	void test_quarantine_coalescing()
+	{
+		constexpr size_t Size    = 48;
+		constexpr size_t Objects = 5;
+		size_t           sizes[Objects];
+		void            *allocations[Objects];
+		TEST_SUCCESS(heap_quarantine_empty());
+		for (size_t i = 0; i < Objects; i++)
+		{
+			sizes[i] = Size;
+		}
+		TEST_EQUAL(heap_allocate_many(
+		             &noWait, MALLOC_CAPABILITY, Objects, sizes, allocations),
+		           ssize_t(Objects),
+		           "Failed to allocate objects for coalescing test");
+		for (size_t i = 1; i < Objects; i++)
+		{
+			Capability previous{allocations[i - 1]};
+			Capability next{allocations[i]};
+			TEST_EQUAL(next.base(),
+			           previous.top() + sizeof(void *),
+			           "Objects {} and {} are not adjacent",
+			           previous,
+			           next);
+		}
+		Capability first{allocations[1]};
+		size_t     span = Capability{allocations[3]}.top() - first.base();
+
+		// Free the middle three together, so that they are in one epoch.
+		TEST_EQUAL(heap_free_many(MALLOC_CAPABILITY, 3, &allocations[1]),
+		           3,
+		           "Failed to free adjacent objects");
+		TEST_SUCCESS(heap_quarantine_empty());
+
+		Capability<uint8_t> merged{static_cast<uint8_t *>(
+		  heap_allocate(&noWait, MALLOC_CAPABILITY, span))};
+		TEST(merged.is_valid() && (merged.length() >= span),
+		     "Allocating the {}-byte merged span returned {}",
+		     span,
+		     merged);
+		TEST_EQUAL(merged.base(),
+		           first.base(),
+		           "Merged span was not reused for an allocation that fits it");
+		for (size_t i = 0; i < span; i++)
+		{
+			TEST(merged[i] == 0,
+			     "Byte {} of merged span {} not zeroed",
+			     i,
+			     merged);
+		}
+		TEST_SUCCESS(heap_free(MALLOC_CAPABILITY, merged));
+		TEST_SUCCESS(heap_free(MALLOC_CAPABILITY, allocations[0]));
+		TEST_SUCCESS(heap_free(MALLOC_CAPABILITY, allocations[4]));
+		TEST_SUCCESS(heap_quarantine_empty());
+	}
+
+	/**
+	 * Test that a reservation is drawn from by allocations with the
+	 * reserving capability and is not available to other capabilities.
+	 */
+	void test_reservation()
+	{
+		constexpr size_t Reserved = 512;
+		TEST_EQUAL(heap_reserve(SECOND_HEAP, SECOND_HEAP_QUOTA + 1),
+		           -EINVAL,
+		           "Reserving more than the remaining quota succeeded");
+		TEST_SUCCESS(heap_reserve(SECOND_HEAP, Reserved));
+		HeapStatistics statistics;
+		TEST_SUCCESS(heap_statistics(&statistics));
+		TEST_EQUAL(statistics.reservedBytes,
+		           Reserved,
+		           "Reservation is not reported in the statistics");
+
+		// If the largest free chunk could satisfy an allocation that would
+		// eat into the reservation, check that another capability cannot
+		// make it.
+		size_t large = statistics.largestFreeChunk - 64;
+		if (statistics.freeBytes - large < Reserved)
+		{
+			TEST(heap_allocate(&noWait, MALLOC_CAPABILITY, large) == nullptr,
+			     "Allocation of {} bytes ignored a {}-byte reservation",
+			     large,
+			     Reserved);
+		}
+
+		void *p = heap_allocate(&noWait, SECOND_HEAP, 256);
+		TEST(__builtin_cheri_tag_get(p), "Allocating from reservation failed");
+		TEST_SUCCESS(heap_statistics(&statistics));
+		// The reservation is drawn on by the whole chunk, including its
+		// header.
+		TEST(statistics.reservedBytes <= Reserved - 256 - 8,
+		     "Allocation drew only {} bytes from the reservation",
+		     Reserved - statistics.reservedBytes);
+		size_t afterAllocation = statistics.reservedBytes;
+
+		// Claims are charged to the quota but not to the reservation.
+		void *other = heap_allocate(&noWait, MALLOC_CAPABILITY, 64);
+		TEST(__builtin_cheri_tag_get(other), "Allocating 64 bytes failed");
+		TEST(heap_claim(SECOND_HEAP, other) > 0, "Claiming failed");
+		TEST_SUCCESS(heap_statistics(&statistics));
+		TEST_EQUAL(statistics.reservedBytes,
+		           afterAllocation,
+		           "Claim drew from the reservation");
+		TEST_SUCCESS(heap_free(SECOND_HEAP, other));
+		TEST_SUCCESS(heap_free(MALLOC_CAPABILITY, other));
+
+		TEST_SUCCESS(heap_free(SECOND_HEAP, p));
+		TEST_SUCCESS(heap_statistics(&statistics));
+		TEST_EQUAL(statistics.reservedBytes,
+		           Reserved,
+		           "Free did not return memory to the reservation");
+		TEST_SUCCESS(heap_reserve(SECOND_HEAP, 0));
+		TEST_SUCCESS(heap_statistics(&statistics));
+		TEST_EQUAL(statistics.reservedBytes,
+		           0U,
+		           "Releasing the reservation did not release the memory");
+	}
+
+	/**
+	 * Test the telemetry API.  The per-bin and per-ring figures must add up
+	 * to the totals and each allocation and free must be counted in the
+	 * latency histograms.
+	 */
+	void test_statistics()
+	{
+		HeapStatistics before;
+		HeapStatistics after;
+		TEST_EQUAL(heap_statistics(nullptr),
+		           -EINVAL,
+		           "heap_statistics accepted a null pointer");
+		TEST_SUCCESS(heap_statistics(&before));
+		void *p = heap_allocate(&noWait, MALLOC_CAPABILITY, 32);
+		TEST(__builtin_cheri_tag_get(p), "Allocating 32 bytes failed");
+		TEST_SUCCESS(heap_free(MALLOC_CAPABILITY, p));
+		TEST_SUCCESS(heap_statistics(&after));
+
+		size_t binned = 0;
+		for (size_t bytes : after.smallBinFreeBytes)
+		{
+			binned += bytes;
+		}
+		for (size_t bytes : after.treeBinFreeBytes)
+		{
+			binned += bytes;
+		}
+		TEST_EQUAL(binned,
+		           after.freeBytes,
+		           "Free bins do not add up to the free space");
+		TEST(after.largestFreeChunk > 0 &&
+		       after.largestFreeChunk <= after.freeBytes,
+		     "Largest free chunk {} is inconsistent with {} free bytes",
+		     after.largestFreeChunk,
+		     after.freeBytes);
+		size_t quarantined = after.quarantineFinishedBytes +
+		                     after.quarantineZeroingBytes + after.cachedBytes;
+		for (size_t bytes : after.quarantinePendingBytes)
+		{
+			quarantined += bytes;
+		}
+		TEST_EQUAL(quarantined,
+		           after.quarantinedBytes,
+		           "Quarantine rings do not add up to the quarantined space");
+		TEST(after.hazardQuarantineOccupancy <=
+		       after.hazardQuarantineCapacity,
+		     "Hazard quarantine holds {} of {} objects",
+		     after.hazardQuarantineOccupancy,
+		     after.hazardQuarantineCapacity);
+
+		using Histogram = uint32_t[HEAP_STATISTICS_HISTOGRAM_BUCKETS];
+
+		auto total = [](Histogram &histogram) {
+			uint32_t sum = 0;
+			for (uint32_t count : histogram)
+			{
+				sum += count;
+			}
+			return sum;
+		};
+		TEST(total(after.allocateCycles) > total(before.allocateCycles),
+		     "Allocation was not recorded in the latency histogram");
+		TEST(total(after.freeCycles) > total(before.freeCycles),
+		     "Free was not recorded in the latency histogram");
+
+#if defined(TEMPORAL_SAFETY) && defined(SOFTWARE_REVOKER)
+		// The object freed above is in quarantine, so flushing the
+		// quarantine completes at least one revocation pass.
+		Timeout t{AllocTimeout};
+		TEST_SUCCESS(heap_quarantine_flush(&t));
+		TEST_SUCCESS(heap_statistics(&after));
+		TEST((after.revocationPassEpoch != 0) &&
+		       ((after.revocationPassEpoch & 1) == 0),
+		     "Invalid epoch {} for the last revocation pass",
+		     after.revocationPassEpoch);
+		TEST((after.revocationPassTicks > 0) &&
+		       (after.revocationPassScanned > 0),
+		     "Last revocation pass scanned {} words in {} ticks",
+		     after.revocationPassScanned,
+		     after.revocationPassTicks);
+		// Most of the heap is free, so the pass should have skipped some of
+		// it.
+		TEST(after.revocationPassSkipped > 0,
+		     "Last revocation pass did not skip any free heap memory");
+#endif
 	}
 
 	void test_hazards()
@@ -897,6 +1748,15 @@ int test_allocator()
 	// Make sure that free works only on memory owned by the caller.
 	Timeout t{5};
 	test_free_all();
+	test_size_class_cache();
+	test_batched_allocation();
+	test_deferred_free();
+	test_reallocate();
+	test_placement();
+	test_quarantine_process();
+	test_quarantine_coalescing();
+	test_reservation();
+	test_statistics();
 	void *ptr = heap_allocate(&t, STATIC_SEALED_VALUE(secondHeap), 32);
 	TEST(__builtin_cheri_tag_get(ptr), "Failed to allocate 32 bytes");
 	TEST(heap_address_is_valid(ptr) == true,
@@ -916,6 +1776,7 @@ int test_allocator()
 	     "After alloc and free from 1024-byte quota, {} bytes left",
 	     quotaLeft);
 	test_claims();
+	test_claim_index();
 
 	TEST(heap_address_is_valid(&t) == false,
 	     "Stack object incorrectly reported as heap address");
@@ -938,6 +1799,8 @@ int test_allocator()
 
 	test_blocking_allocator(HeapSize);
 	TEST_SUCCESS(heap_quarantine_empty());
+	test_reallocate_blocking(HeapSize);
+	test_blocked_wakes(HeapSize);
 	test_revoke(HeapSize);
 	test_fuzz();
 	allocations.clear();
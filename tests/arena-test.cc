@@ -0,0 +1,119 @@
+// Copyright CHERIoT Contributors.
+// SPDX-License-Identifier: MIT
+
+#define TEST_NAME "Arena"
+#include "tests.hh"
+#include <arena.hh>
+#include <cheri.hh>
+#include <errno.h>
+#include <vector>
+
+using CHERI::Capability;
+
+namespace
+{
+	constexpr size_t ArenaCapacity = 256;
+
+	/**
+	 * Check that sub-allocations are bounded, zeroed, disjoint and that the
+	 * arena reports exhaustion.
+	 */
+	void test_arena_allocate(Arena *arena)
+	{
+		Capability<char> first{static_cast<char *>(arena_allocate(arena, 13))};
+		TEST(first.is_valid(), "Failed to allocate from arena");
+		TEST_EQUAL(first.length(), 13U, "Arena allocation has wrong bounds");
+		TEST_EQUAL(first.address() % ARENA_ALIGNMENT,
+		           0U,
+		           "Arena allocation is not aligned");
+		for (size_t i = 0; i < first.length(); i++)
+		{
+			TEST_EQUAL(first[i], 0, "Arena allocation is not zeroed");
+			first[i] = 0x5a;
+		}
+		Capability<char> second{static_cast<char *>(arena_allocate(arena, 8))};
+		TEST(second.is_valid(), "Failed to allocate from arena");
+		TEST(second.base() >= first.top(),
+		     "Arena allocations {} and {} overlap",
+		     first,
+		     second);
+		TEST(arena_allocate(arena, 0) == nullptr,
+		     "Zero-sized arena allocation succeeded");
+
+		size_t remaining = arena_remaining(arena);
+		TEST(remaining > 0, "Arena reports no remaining space");
+		TEST(arena_allocate(arena, remaining + ARENA_ALIGNMENT) == nullptr,
+		     "Allocation larger than the remaining space succeeded");
+		Capability<void> last{arena_allocate(arena, remaining)};
+		TEST(last.is_valid(),
+		     "Failed to allocate remaining {} bytes from arena",
+		     remaining);
+		TEST_EQUAL(arena_remaining(arena), 0U, "Arena should be exhausted");
+		TEST(arena_allocate(arena, 1) == nullptr,
+		     "Allocation from exhausted arena succeeded");
+
+		// Resetting should make all of the space available again and reuse
+		// the first address, with the memory zeroed on allocation.
+		arena_reset(arena);
+		Capability<char> reused{static_cast<char *>(arena_allocate(arena, 13))};
+		TEST_EQUAL(reused.address(),
+		           first.address(),
+		           "Arena reset did not reuse memory");
+		TEST_EQUAL(reused[0], 0, "Reused arena memory is not zeroed");
+		arena_reset(arena);
+	}
+
+	/**
+	 * Check that standard library containers can allocate from an arena.
+	 */
+	void test_arena_allocator(Arena *arena)
+	{
+		std::vector<int, ArenaAllocator<int>> v{ArenaAllocator<int>{arena}};
+		for (int i = 0; i < 8; i++)
+		{
+			v.push_back(i);
+		}
+		for (int i = 0; i < 8; i++)
+		{
+			TEST_EQUAL(v[i], i, "Arena-backed vector has incorrect contents");
+		}
+		Capability<int> data{v.data()};
+		TEST(data.length() <= v.capacity() * sizeof(int),
+		     "Vector storage {} is not bounded to its capacity {}",
+		     data,
+		     v.capacity());
+		arena_reset(arena);
+	}
+} // namespace
+
+int test_arena()
+{
+	Timeout t{UnlimitedTimeout};
+	Arena  *arena;
+	auto    quotaBefore = heap_quota_remaining(MALLOC_CAPABILITY);
+
+	TEST_EQUAL(arena_create(&t, MALLOC_CAPABILITY, SIZE_MAX, &arena),
+	           -EINVAL,
+	           "Creating an arena with an overflowing size succeeded");
+	TEST(arena == nullptr, "Failed arena creation returned {}", arena);
+	TEST_EQUAL(arena_create(&t, MALLOC_CAPABILITY, ArenaCapacity, nullptr),
+	           -EINVAL,
+	           "Creating an arena with a null result pointer succeeded");
+	TEST_EQUAL(heap_quota_remaining(MALLOC_CAPABILITY),
+	           quotaBefore,
+	           "Failed arena creation leaked quota");
+	TEST_SUCCESS(arena_create(&t, MALLOC_CAPABILITY, ArenaCapacity, &arena));
+	TEST(arena_remaining(arena) >= ArenaCapacity,
+	     "Arena has {} bytes, expected at least {}",
+	     arena_remaining(arena),
+	     ArenaCapacity);
+
+	test_arena_allocate(arena);
+	test_arena_allocator(arena);
+
+	TEST_SUCCESS(arena_destroy(MALLOC_CAPABILITY, arena));
+	TEST_EQUAL(heap_quota_remaining(MALLOC_CAPABILITY),
+	           quotaBefore,
+	           "Destroying an arena did not return its quota");
+	return 0;
+}
@@ -3,6 +3,7 @@
 
 #define TEST_NAME "Multiwaiter"
 #include "tests.hh"
+#include <atomic>
 #include <cheri.hh>
 #include <errno.h>
 #include <futex.h>
@@ -14,6 +15,245 @@
 using namespace CHERI;
 using namespace thread_pool;
 
+namespace
+{
+	/**
+	 * Test with several threads each blocked on a full multiwaiter.  Wakes on
+	 * unrelated futexes must not wake any of them and a wake on one of their
+	 * futexes must wake only the thread waiting on it, reporting only that
+	 * event.
+	 */
+	void test_many_waiters()
+	{
+		// The maximum number of events in a multiwaiter.
+		static constexpr size_t EventsPerWaiter = 8;
+		// One waiter for each thread-pool thread.
+		static constexpr size_t Waiters = 2;
+		static uint32_t         futexes[Waiters][EventsPerWaiter];
+		static uint32_t         unrelated[16];
+		static std::atomic<int> finished;
+		static uint32_t         firedEvents[Waiters];
+		MultiWaiter             mws[Waiters];
+
+		debug_log("Testing {} threads blocked on {} futexes each",
+		          Waiters,
+		          EventsPerWaiter);
+		for (size_t w = 0; w < Waiters; w++)
+		{
+			Timeout t{0};
+			int     ret = multiwaiter_create(
+			  &t, MALLOC_CAPABILITY, &mws[w], EventsPerWaiter);
+			TEST(ret == 0, "Allocating multiwaiter {} failed: {}", w, ret);
+			async([=, mw = mws[w]]() {
+				EventWaiterSource events[EventsPerWaiter];
+				for (size_t i = 0; i < EventsPerWaiter; i++)
+				{
+					events[i] = {&futexes[w][i], 0};
+				}
+				Timeout t{1000};
+				int     ret = multiwaiter_wait(&t, mw, events, EventsPerWaiter);
+				TEST(ret == 0, "Waiter {} returned {}", w, ret);
+				uint32_t mask = 0;
+				for (size_t i = 0; i < EventsPerWaiter; i++)
+				{
+					mask |= (events[i].value != 0) << i;
+				}
+				firedEvents[w] = mask;
+				finished++;
+			});
+		}
+		// Let both waiters block.
+		sleep(1);
+		TEST_EQUAL(finished.load(), 0, "Waiter returned before any wake");
+
+		for (auto &word : unrelated)
+		{
+			word = 1;
+			TEST_EQUAL(
+			  futex_wake(&word, 1), 0, "Unrelated futex wake woke a waiter");
+		}
+		sleep(1);
+		TEST_EQUAL(finished.load(), 0, "Unrelated futex wake woke a waiter");
+
+		futexes[1][5] = 1;
+		TEST_EQUAL(
+		  futex_wake(&futexes[1][5], std::numeric_limits<uint32_t>::max()),
+		  1,
+		  "Futex wake should have woken exactly one waiter");
+		sleep(1);
+		TEST_EQUAL(finished.load(), 1, "Futex wake should have woken a waiter");
+		TEST_EQUAL(firedEvents[1], 1U << 5, "Wrong events reported for waiter");
+		TEST_EQUAL(firedEvents[0], 0U, "Waiter woke for another's futex");
+
+		futexes[0][7] = 1;
+		TEST_EQUAL(futex_wake(&futexes[0][7], 1),
+		           1,
+		           "Futex wake should have woken exactly one waiter");
+		sleep(1);
+		TEST_EQUAL(finished.load(), 2, "Futex wake should have woken a waiter");
+		TEST_EQUAL(firedEvents[0], 1U << 7, "Wrong events reported for waiter");
+
+		for (auto mw : mws)
+		{
+			TEST_EQUAL(multiwaiter_delete(MALLOC_CAPABILITY, mw),
+			           0,
+			           "Failed to clean up multiwaiter");
+		}
+	}
+
+	/**
+	 * Test that a limited wake that cannot wake every waiter still delivers
+	 * its event to a waiter that another event has already woken but that has
+	 * not yet run.  One waiter blocks on two futexes.  The other blocks on
+	 * the second futex twice, so a single wake of the second futex has more
+	 * candidates than it may wake.
+	 */
+	void test_already_woken_waiter()
+	{
+		static uint32_t         futexes[2];
+		static std::atomic<int> finished;
+		static uint32_t         firedEvents[2];
+		MultiWaiter             mws[2];
+
+		debug_log("Testing a limited wake with an already-woken waiter");
+		for (size_t w = 0; w < 2; w++)
+		{
+			Timeout t{0};
+			int     ret = multiwaiter_create(&t, MALLOC_CAPABILITY, &mws[w], 2);
+			TEST(ret == 0, "Allocating multiwaiter {} failed: {}", w, ret);
+			async([=, mw = mws[w]]() {
+				EventWaiterSource events[2] = {{&futexes[w], 0},
+				                               {&futexes[1], 0}};
+				Timeout           t{1000};
+				int               ret = multiwaiter_wait(&t, mw, events, 2);
+				TEST(ret == 0, "Waiter {} returned {}", w, ret);
+				firedEvents[w] = (events[0].value != 0) |
+				                 ((events[1].value != 0) << 1);
+				finished++;
+			});
+		}
+		// Let both waiters block.
+		sleep(1);
+		TEST_EQUAL(finished.load(), 0, "Waiter returned before any wake");
+
+		// The waiters are lower priority than this thread, so the first one
+		// does not run between these two wakes.
+		futexes[0] = 1;
+		TEST_EQUAL(futex_wake(&futexes[0], 1),
+		           1,
+		           "Futex wake should have woken the first waiter");
+		futexes[1] = 1;
+		TEST_EQUAL(futex_wake(&futexes[1], 1),
+		           1,
+		           "Futex wake should have woken only the second waiter");
+		sleep(1);
+		TEST_EQUAL(finished.load(), 2, "Futex wakes should have woken both");
+		TEST_EQUAL(firedEvents[0],
+		           3U,
+		           "Already-woken waiter missed the second event");
+		TEST_EQUAL(firedEvents[1], 3U, "Wrong events reported for waiter");
+
+		for (auto mw : mws)
+		{
+			TEST_EQUAL(multiwaiter_delete(MALLOC_CAPABILITY, mw),
+			           0,
+			           "Failed to clean up multiwaiter");
+		}
+	}
+
+	/**
+	 * Test persistent event sources attached with `multiwaiter_attach`.
+	 */
+	void test_attached_events()
+	{
+		static uint32_t   futexes[3];
+		MultiWaiter       mw;
+		EventWaiterSource events[3];
+		Timeout           t{0};
+		int ret = multiwaiter_create(&t, MALLOC_CAPABILITY, &mw, 3);
+		TEST(ret == 0, "Allocating multiwaiter failed: {}", ret);
+
+		debug_log("Testing waiting with no attached events");
+		TEST_EQUAL(multiwaiter_wait_attached(&t, mw),
+		           -EINVAL,
+		           "Waiting with no attached events should fail");
+
+		for (size_t i = 0; i < 3; i++)
+		{
+			events[i] = {&futexes[i], 0};
+		}
+		TEST_EQUAL(
+		  multiwaiter_attach(mw, events, 3), 0, "Attaching events failed");
+		// The scheduler must not depend on our copy after attaching.
+		for (auto &event : events)
+		{
+			event = {nullptr, 0};
+		}
+
+		debug_log("Testing attached events, none ready");
+		t = 2;
+		TEST_EQUAL(multiwaiter_wait_attached(&t, mw),
+		           -ETIMEDOUT,
+		           "Attached wait should have timed out");
+
+		debug_log("Testing transient wait with attached events");
+		t = 2;
+		TEST_EQUAL(multiwaiter_wait(&t, mw, events, 1),
+		           -EBUSY,
+		           "Transient wait on multiwaiter with attached events");
+
+		debug_log("Testing attached events, one set from another thread");
+		async([]() {
+			sleep(1);
+			futexes[1] = 1;
+			TEST(futex_wake(&futexes[1], 1) >= 0, "futex_wake failed");
+		});
+		t = 50;
+		TEST_EQUAL(multiwaiter_wait_attached(&t, mw),
+		           1 << 1,
+		           "Attached wait reported the wrong events");
+
+		debug_log("Testing attached events do not fire again without a change");
+		t = 2;
+		TEST_EQUAL(multiwaiter_wait_attached(&t, mw),
+		           -ETIMEDOUT,
+		           "Reported event fired again without a change");
+
+		debug_log("Testing attached events, two already changed");
+		futexes[0] = 5;
+		futexes[2] = 7;
+		t          = 0;
+		TEST_EQUAL(multiwaiter_wait_attached(&t, mw),
+		           (1 << 0) | (1 << 2),
+		           "Attached wait reported the wrong events");
+
+		debug_log("Testing attaching a futex word on the stack");
+		uint32_t stackFutex = 0;
+		events[0]           = {&stackFutex, 0};
+		TEST_EQUAL(multiwaiter_attach(mw, events, 1),
+		           -EINVAL,
+		           "Attaching a stack futex word should fail");
+		TEST_EQUAL(multiwaiter_wait_attached(&t, mw),
+		           -EINVAL,
+		           "Failed attach should leave no attached events");
+
+		debug_log("Testing detaching events");
+		events[0] = {&futexes[0], 5};
+		TEST_EQUAL(
+		  multiwaiter_attach(mw, events, 1), 0, "Attaching events failed");
+		TEST_EQUAL(
+		  multiwaiter_attach(mw, nullptr, 0), 0, "Detaching events failed");
+		t = 0;
+		TEST_EQUAL(multiwaiter_wait(&t, mw, events, 1),
+		           -ETIMEDOUT,
+		           "Transient wait after detaching failed");
+
+		TEST_EQUAL(multiwaiter_delete(MALLOC_CAPABILITY, mw),
+		           0,
+		           "Failed to clean up multiwaiter");
+	}
+} // namespace
+
 int test_multiwaiter()
 {
 	static uint32_t futex  = 0;
@@ -136,5 +376,9 @@ int test_multiwaiter()
 	TEST_EQUAL(
 	  queue_destroy(MALLOC_CAPABILITY, queue), 0, "Failed to clean up queue");
 
+	test_many_waiters();
+	test_already_woken_waiter();
+	test_attached_events();
+
 	return 0;
 }
@@ -208,6 +208,10 @@ test("multiwaiter", { name = "Multiwatier" })
 test("allocator", { name = "Allocator" })
     add_deps("cxxrt")
 
+-- Test the arena library.
+test("arena", { name = "Arena" })
+    add_deps("cxxrt", "arena")
+
 includes(path.join(sdkdir, "lib"))
 
 rule("cheriot.tests")